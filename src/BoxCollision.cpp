@@ -0,0 +1,160 @@
+#include "BoxCollision.h"
+
+#include <cmath>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+void BoxSet::set(int i, float cx, float cy, float angle, float length, float width) {
+	x[i] = cx;
+	y[i] = cy;
+	axis_x[i] = cos(angle);
+	axis_y[i] = sin(angle);
+	half_length[i] = length / 2;
+	half_width[i] = width / 2;
+}
+
+// For the axes u (length) and v (width) of both boxes, with T from the centre of
+// a to the centre of b, the boxes are apart along an axis L when
+//   |T.L| > ra + rb,  ra = hla |ua.L| + hwa |va.L|,  rb = hlb |ub.L| + hwb |vb.L|
+// In 2D only two dot products between the axes are needed: ua.ub = va.vb = c and
+// ua.vb = -va.ub = s, so ra and rb along every axis use |c| and |s|.
+
+#ifdef __SSE__
+
+static inline __m128 absPs(__m128 v) {
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+// keep the values of a where mask is set, and those of b elsewhere
+static inline __m128 selectPs(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// overlap along an axis (ax, ay), and the normal pointing from a to b; keeps it if it is the least one
+static inline void testAxis(__m128 tx, __m128 ty, __m128 ax, __m128 ay, __m128 radius,
+	__m128 & best, __m128 & best_x, __m128 & best_y)
+{
+	__m128 d = _mm_add_ps(_mm_mul_ps(tx, ax), _mm_mul_ps(ty, ay));
+	__m128 overlap = _mm_sub_ps(radius, absPs(d));
+	__m128 negative = _mm_cmplt_ps(d, _mm_setzero_ps());
+	__m128 sign = _mm_and_ps(negative, _mm_set1_ps(-0.0f));
+	__m128 less = _mm_cmplt_ps(overlap, best);
+	best = selectPs(less, overlap, best);
+	best_x = selectPs(less, _mm_xor_ps(ax, sign), best_x);
+	best_y = selectPs(less, _mm_xor_ps(ay, sign), best_y);
+}
+
+void collideBoxes(const BoxSet & boxes, const SpatialGrid::Pair * pairs, int count,
+	std::vector<BoxContact> & contacts)
+{
+	// gathered fields of 4 pairs; the last group repeats its first pair as padding
+	float ax[4] __attribute__((aligned(16))), ay[4] __attribute__((aligned(16)));
+	float aux[4] __attribute__((aligned(16))), auy[4] __attribute__((aligned(16)));
+	float ahl[4] __attribute__((aligned(16))), ahw[4] __attribute__((aligned(16)));
+	float bx[4] __attribute__((aligned(16))), by[4] __attribute__((aligned(16)));
+	float bux[4] __attribute__((aligned(16))), buy[4] __attribute__((aligned(16)));
+	float bhl[4] __attribute__((aligned(16))), bhw[4] __attribute__((aligned(16)));
+	float depth[4] __attribute__((aligned(16)));
+	float normal_x[4] __attribute__((aligned(16))), normal_y[4] __attribute__((aligned(16)));
+
+	for (int p = 0; p < count; p += 4) {
+		int n = (count - p < 4 ? count - p : 4);
+		for (int k = 0; k < 4; ++k) {
+			const SpatialGrid::Pair & pair = pairs[p + (k < n ? k : 0)];
+			ax[k] = boxes.x[pair.a];
+			ay[k] = boxes.y[pair.a];
+			aux[k] = boxes.axis_x[pair.a];
+			auy[k] = boxes.axis_y[pair.a];
+			ahl[k] = boxes.half_length[pair.a];
+			ahw[k] = boxes.half_width[pair.a];
+			bx[k] = boxes.x[pair.b];
+			by[k] = boxes.y[pair.b];
+			bux[k] = boxes.axis_x[pair.b];
+			buy[k] = boxes.axis_y[pair.b];
+			bhl[k] = boxes.half_length[pair.b];
+			bhw[k] = boxes.half_width[pair.b];
+		}
+
+		__m128 tx = _mm_sub_ps(_mm_load_ps(bx), _mm_load_ps(ax));
+		__m128 ty = _mm_sub_ps(_mm_load_ps(by), _mm_load_ps(ay));
+		__m128 ua_x = _mm_load_ps(aux), ua_y = _mm_load_ps(auy);
+		__m128 ub_x = _mm_load_ps(bux), ub_y = _mm_load_ps(buy);
+		__m128 hla = _mm_load_ps(ahl), hwa = _mm_load_ps(ahw);
+		__m128 hlb = _mm_load_ps(bhl), hwb = _mm_load_ps(bhw);
+
+		__m128 c = absPs(_mm_add_ps(_mm_mul_ps(ua_x, ub_x), _mm_mul_ps(ua_y, ub_y)));
+		__m128 s = absPs(_mm_sub_ps(_mm_mul_ps(ua_y, ub_x), _mm_mul_ps(ua_x, ub_y)));
+		__m128 zero = _mm_setzero_ps();
+
+		__m128 best = _mm_set1_ps(1e30f);
+		__m128 best_x = zero, best_y = zero;
+		// the length and width axes of a, then those of b; the width axis is (-uy, ux)
+		testAxis(tx, ty, ua_x, ua_y,
+			_mm_add_ps(hla, _mm_add_ps(_mm_mul_ps(hlb, c), _mm_mul_ps(hwb, s))), best, best_x, best_y);
+		testAxis(tx, ty, _mm_sub_ps(zero, ua_y), ua_x,
+			_mm_add_ps(hwa, _mm_add_ps(_mm_mul_ps(hlb, s), _mm_mul_ps(hwb, c))), best, best_x, best_y);
+		testAxis(tx, ty, ub_x, ub_y,
+			_mm_add_ps(hlb, _mm_add_ps(_mm_mul_ps(hla, c), _mm_mul_ps(hwa, s))), best, best_x, best_y);
+		testAxis(tx, ty, _mm_sub_ps(zero, ub_y), ub_x,
+			_mm_add_ps(hwb, _mm_add_ps(_mm_mul_ps(hla, s), _mm_mul_ps(hwa, c))), best, best_x, best_y);
+
+		int hits = _mm_movemask_ps(_mm_cmpgt_ps(best, zero)) & ((1 << n) - 1);
+		if (0 == hits) {
+			continue;
+		}
+		_mm_store_ps(depth, best);
+		_mm_store_ps(normal_x, best_x);
+		_mm_store_ps(normal_y, best_y);
+		for (int k = 0; k < n; ++k) {
+			if (hits & (1 << k)) {
+				BoxContact contact = { pairs[p + k].a, pairs[p + k].b, normal_x[k], normal_y[k], depth[k] };
+				contacts.push_back(contact);
+			}
+		}
+	}
+}
+
+#else // no SSE: the same test, one pair at a time
+
+static inline void testAxis(float tx, float ty, float ax, float ay, float radius,
+	float & best, float & best_x, float & best_y)
+{
+	float d = tx * ax + ty * ay;
+	float overlap = radius - fabs(d);
+	if (overlap < best) {
+		best = overlap;
+		best_x = (d < 0 ? -ax : ax);
+		best_y = (d < 0 ? -ay : ay);
+	}
+}
+
+void collideBoxes(const BoxSet & boxes, const SpatialGrid::Pair * pairs, int count,
+	std::vector<BoxContact> & contacts)
+{
+	for (int p = 0; p < count; ++p) {
+		int a = pairs[p].a;
+		int b = pairs[p].b;
+		float tx = boxes.x[b] - boxes.x[a];
+		float ty = boxes.y[b] - boxes.y[a];
+		float ua_x = boxes.axis_x[a], ua_y = boxes.axis_y[a];
+		float ub_x = boxes.axis_x[b], ub_y = boxes.axis_y[b];
+		float hla = boxes.half_length[a], hwa = boxes.half_width[a];
+		float hlb = boxes.half_length[b], hwb = boxes.half_width[b];
+		float c = fabs(ua_x * ub_x + ua_y * ub_y);
+		float s = fabs(ua_y * ub_x - ua_x * ub_y);
+
+		float best = 1e30f, best_x = 0, best_y = 0;
+		testAxis(tx, ty, ua_x, ua_y, hla + hlb * c + hwb * s, best, best_x, best_y);
+		testAxis(tx, ty, -ua_y, ua_x, hwa + hlb * s + hwb * c, best, best_x, best_y);
+		testAxis(tx, ty, ub_x, ub_y, hlb + hla * c + hwa * s, best, best_x, best_y);
+		testAxis(tx, ty, -ub_y, ub_x, hwb + hla * s + hwa * c, best, best_x, best_y);
+		if (best > 0) {
+			BoxContact contact = { a, b, best_x, best_y, best };
+			contacts.push_back(contact);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef BOXCOLLISION_H_DCAFD5C9_52F8_11E4_CA02_10FEED04CD1C
+#define BOXCOLLISION_H_DCAFD5C9_52F8_11E4_CA02_10FEED04CD1C
+
+#include "SpatialGrid.h"
+
+#include <vector>
+
+// Oriented boxes as a structure of arrays, so that several pairs of them can be
+// loaded into SIMD registers at once
+struct BoxSet {
+	std::vector<float> x;           // centre
+	std::vector<float> y;
+	std::vector<float> axis_x;      // unit vector along the length
+	std::vector<float> axis_y;
+	std::vector<float> half_length;
+	std::vector<float> half_width;
+
+	void resize(int count) {
+		x.resize(count);
+		y.resize(count);
+		axis_x.resize(count);
+		axis_y.resize(count);
+		half_length.resize(count);
+		half_width.resize(count);
+	}
+	void set(int i, float cx, float cy, float angle, float length, float width);
+};
+
+struct BoxContact {
+	int a;
+	int b;
+	float normal_x; // unit vector from a towards b
+	float normal_y;
+	float depth;    // distance to move them along the normal until they just touch
+};
+
+// Separating axis test of every pair (4 at a time with SSE): the ones that
+// overlap are appended to contacts, with the axis of least penetration.
+void collideBoxes(const BoxSet & boxes, const SpatialGrid::Pair * pairs, int count,
+	std::vector<BoxContact> & contacts);
+
+#endif // BOXCOLLISION_H_DCAFD5C9_52F8_11E4_CA02_10FEED04CD1C
@@ -0,0 +1,85 @@
+#include "Camera.h"
+
+Camera::Camera() :
+	mMode(MODE_FOLLOW),
+	mfCenterX(0),
+	mfCenterY(0),
+	mfZoom(1.0),
+	miViewportWidth(1),
+	miViewportHeight(1),
+	miWorldWidth(1),
+	miWorldHeight(1)
+{
+	updateVisibleRect();
+}
+
+void Camera::setViewport(int w, int h) {
+	miViewportWidth  = (w > 0 ? w : 1);
+	miViewportHeight = (h > 0 ? h : 1);
+	updateVisibleRect();
+}
+
+void Camera::setWorldSize(int w, int h) {
+	miWorldWidth  = (w > 0 ? w : 1);
+	miWorldHeight = (h > 0 ? h : 1);
+	updateVisibleRect();
+}
+
+void Camera::reset() {
+	mMode = MODE_FOLLOW;
+	mfZoom = 1.0;
+	mfCenterX = miWorldWidth / 2.0;
+	mfCenterY = miWorldHeight / 2.0;
+	updateVisibleRect();
+}
+
+void Camera::follow(float x, float y) {
+	if (MODE_FOLLOW == mMode) {
+		mfCenterX = x;
+		mfCenterY = y;
+		updateVisibleRect();
+	}
+}
+
+void Camera::pan(float screen_dx, float screen_dy) {
+	mMode = MODE_FREE;
+	mfCenterX = mVisible.x + mVisible.w / 2 - screen_dx / mfZoom;
+	mfCenterY = mVisible.y + mVisible.h / 2 - screen_dy / mfZoom;
+	updateVisibleRect();
+}
+
+void Camera::zoomBy(float factor, float screen_x, float screen_y) {
+	float world_x = screenToWorldX(screen_x);
+	float world_y = screenToWorldY(screen_y);
+
+	mfZoom *= factor;
+	if (mfZoom < MIN_ZOOM) mfZoom = MIN_ZOOM;
+	if (mfZoom > MAX_ZOOM) mfZoom = MAX_ZOOM;
+
+	if (MODE_FREE == mMode) { // keep the world point under the given screen point
+		mfCenterX = world_x - screen_x / mfZoom + miViewportWidth  / mfZoom / 2;
+		mfCenterY = world_y - screen_y / mfZoom + miViewportHeight / mfZoom / 2;
+	}
+	updateVisibleRect();
+}
+
+void Camera::updateVisibleRect() {
+	mVisible.w = miViewportWidth  / mfZoom;
+	mVisible.h = miViewportHeight / mfZoom;
+
+	// don't show what is outside of the world; if it is smaller than the screen, keep it at the top left
+	if (mVisible.w >= miWorldWidth) {
+		mVisible.x = 0;
+	} else {
+		mVisible.x = mfCenterX - mVisible.w / 2;
+		if (mVisible.x < 0) mVisible.x = 0;
+		if (mVisible.x > miWorldWidth - mVisible.w) mVisible.x = miWorldWidth - mVisible.w;
+	}
+	if (mVisible.h >= miWorldHeight) {
+		mVisible.y = 0;
+	} else {
+		mVisible.y = mfCenterY - mVisible.h / 2;
+		if (mVisible.y < 0) mVisible.y = 0;
+		if (mVisible.y > miWorldHeight - mVisible.h) mVisible.y = miWorldHeight - mVisible.h;
+	}
+}
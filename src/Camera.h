@@ -0,0 +1,75 @@
+#ifndef CAMERA_H_CD616E75_C870_11E4_0E21_10FEED04CD1C
+#define CAMERA_H_CD616E75_C870_11E4_0E21_10FEED04CD1C
+
+// Part of the world that is shown on the screen. The camera either follows a
+// target (usually the player's car) or is panned freely, and can be zoomed.
+class Camera {
+public:
+	enum Mode {
+		MODE_FOLLOW,
+		MODE_FREE
+	};
+
+	struct Rect {
+		float x;
+		float y;
+		float w;
+		float h;
+	};
+
+	static const float MIN_ZOOM = 0.125;
+	static const float MAX_ZOOM = 4.0;
+
+	Camera();
+
+	void setViewport(int w, int h);
+	void setWorldSize(int w, int h);
+
+	Mode getMode() const {
+		return mMode;
+	}
+	void setMode(Mode mode) {
+		mMode = mode;
+	}
+	float getZoom() const {
+		return mfZoom;
+	}
+
+	void follow(float x, float y); // only has effect in follow mode
+	void pan(float screen_dx, float screen_dy); // switches to free mode
+	void zoomBy(float factor, float screen_x, float screen_y); // keeps that screen point still in free mode, the car centered in follow mode
+	void reset();
+
+	// part of the world that is visible, in world coordinates
+	const Rect & getVisibleRect() const {
+		return mVisible;
+	}
+
+	float worldToScreenX(float x) const {
+		return (x - mVisible.x) * mfZoom;
+	}
+	float worldToScreenY(float y) const {
+		return (y - mVisible.y) * mfZoom;
+	}
+	float screenToWorldX(float x) const {
+		return mVisible.x + x / mfZoom;
+	}
+	float screenToWorldY(float y) const {
+		return mVisible.y + y / mfZoom;
+	}
+
+private:
+	Mode mMode;
+	float mfCenterX;
+	float mfCenterY;
+	float mfZoom;
+	int miViewportWidth;
+	int miViewportHeight;
+	int miWorldWidth;
+	int miWorldHeight;
+	Rect mVisible;
+
+	void updateVisibleRect();
+};
+
+#endif // CAMERA_H_CD616E75_C870_11E4_0E21_10FEED04CD1C
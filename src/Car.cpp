@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2014  Miriam Ruiz <miriam@debian.org>
+ * 
+ * Based on zeRace 0.7 ('a funny retro racing game')
+ * http://royale.zerezo.com/zerace/
+ * 
+ * Copyright (C) 2004  Antoine Jacquet <royale@zerezo.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "Car.h"
+
+void Car::updateTimer(unsigned int milliseconds) {
+	inc_time_ms     = milliseconds;
+	global_time_ms += milliseconds;
+	float elapsed_time_s = inc_time_ms / 1000.0;
+	now.spd_x = (now.pos_x - before.pos_x) / elapsed_time_s;
+	now.spd_y = (now.pos_y - before.pos_y) / elapsed_time_s;
+	now.spd_z = (now.pos_z - before.pos_z) / elapsed_time_s;
+	now.acc_x = (now.spd_x - before.spd_x) / elapsed_time_s;
+	now.acc_y = (now.spd_y - before.spd_y) / elapsed_time_s;
+	now.acc_z = (now.spd_z - before.spd_z) / elapsed_time_s;
+}
+
+void Car::drawRawLight(SDL_Renderer * renderer, int x, int y, int r) {
+	SDL_RenderDrawPoint(renderer, x, y);
+	if (r>1) {
+		SDL_RenderDrawPoint(renderer, x-1, y   );
+		SDL_RenderDrawPoint(renderer, x+1, y   );
+		SDL_RenderDrawPoint(renderer, x,   y-1 );
+		SDL_RenderDrawPoint(renderer, x,   y+1 );
+	}
+	if (r>2) {
+		SDL_RenderDrawPoint(renderer, x-2, y   );
+		SDL_RenderDrawPoint(renderer, x+2, y   );
+		SDL_RenderDrawPoint(renderer, x,   y-2 );
+		SDL_RenderDrawPoint(renderer, x,   y+2 );
+		SDL_RenderDrawPoint(renderer, x-1, y-1 );
+		SDL_RenderDrawPoint(renderer, x-1, y+1 );
+		SDL_RenderDrawPoint(renderer, x+1, y-1 );
+		SDL_RenderDrawPoint(renderer, x+1, y+1 );
+	}
+}
+
+void Car::drawBrakeLights(SDL_Renderer * renderer, float offset_x, float offset_y) {
+	SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Red
+	drawRawLight(renderer, now.pos_x - offset_x + cos(now.ang_yaw) * length/3 - sin(now.ang_yaw)*4, now.pos_y - offset_y + sin(now.ang_yaw) * width/3 + cos(now.ang_yaw)*4, 3);
+	drawRawLight(renderer, now.pos_x - offset_x + cos(now.ang_yaw) * length/3 + sin(now.ang_yaw)*4, now.pos_y - offset_y + sin(now.ang_yaw) * width/3 - cos(now.ang_yaw)*4, 3);
+}
+
+void Car::drawReversingLights(SDL_Renderer * renderer, float offset_x, float offset_y) {
+	SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); // White
+	drawRawLight(renderer, now.pos_x - offset_x + cos(now.ang_yaw) * length/3 - sin(now.ang_yaw)*4, now.pos_y - offset_y + sin(now.ang_yaw) * width/3 + cos(now.ang_yaw)*4, 3);
+	drawRawLight(renderer, now.pos_x - offset_x + cos(now.ang_yaw) * length/3 + sin(now.ang_yaw)*4, now.pos_y - offset_y + sin(now.ang_yaw) * width/3 - cos(now.ang_yaw)*4, 3);
+}
+
+void Car::drawWarningLights(SDL_Renderer * renderer, float offset_x, float offset_y) {
+	SDL_SetRenderDrawColor(renderer, 255, 200, 0, 255); // Orange
+	drawRawLight(renderer, now.pos_x - offset_x - cos(now.ang_yaw) * length/3 - sin(now.ang_yaw)*5, now.pos_y - offset_y - sin(now.ang_yaw) * width/3 + cos(now.ang_yaw)*5, 2);
+	drawRawLight(renderer, now.pos_x - offset_x - cos(now.ang_yaw) * length/3 + sin(now.ang_yaw)*5, now.pos_y - offset_y - sin(now.ang_yaw) * width/3 - cos(now.ang_yaw)*5, 2);
+	drawRawLight(renderer, now.pos_x - offset_x + cos(now.ang_yaw) * length/3 - sin(now.ang_yaw)*5, now.pos_y - offset_y + sin(now.ang_yaw) * width/3 + cos(now.ang_yaw)*5, 2);
+	drawRawLight(renderer, now.pos_x - offset_x + cos(now.ang_yaw) * length/3 + sin(now.ang_yaw)*5, now.pos_y - offset_y + sin(now.ang_yaw) * width/3 - cos(now.ang_yaw)*5, 2);
+}
+
+void Car::drawPositionLights(SDL_Renderer * renderer, float offset_x, float offset_y) {
+	if (position_lights) {
+		SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Red
+		drawRawLight(renderer, now.pos_x - offset_x + cos(now.ang_yaw) * length/3 - sin(now.ang_yaw)*3, now.pos_y - offset_y + sin(now.ang_yaw) * width/3 + cos(now.ang_yaw)*4, 2);
+		drawRawLight(renderer, now.pos_x - offset_x + cos(now.ang_yaw) * length/3 + sin(now.ang_yaw)*3, now.pos_y - offset_y + sin(now.ang_yaw) * width/3 - cos(now.ang_yaw)*4, 2);
+		SDL_SetRenderDrawColor(renderer, 255, 255, 100, 255); // Yellow
+		drawRawLight(renderer, now.pos_x - offset_x - cos(now.ang_yaw) * length/3 - sin(now.ang_yaw)*4, now.pos_y - offset_y - sin(now.ang_yaw) * width/3 + cos(now.ang_yaw)*4, 3);
+		drawRawLight(renderer, now.pos_x - offset_x - cos(now.ang_yaw) * length/3 + sin(now.ang_yaw)*4, now.pos_y - offset_y - sin(now.ang_yaw) * width/3 - cos(now.ang_yaw)*4, 3);
+	}
+}
+
+void Car::updateCheckpoints(int chkpnt) {
+	// if we are on the next checkpoint, validate it
+	if (chkpnt == last_checkpoint + 1) {
+		if (lapflag==3) { // If we validate a missed checkpoint
+			lapflag=4;
+		}
+		++last_checkpoint;
+	}
+
+	// if we missed a checkpoint
+	if ((chkpnt > last_checkpoint + 1) && (last_checkpoint != 0)) {
+		lapflag = 3;
+	}
+
+	// if we validate all and start over, we complete a turn
+	if (chkpnt == 0 && last_checkpoint == checkpoints - 1) { // reset turn variables
+		last_checkpoint = 0;
+		++lap;
+		lapflag = 1;
+	}
+
+	// if we are at the start but not each checkpoint validate, it's an incomplete lap
+	if (chkpnt == 0 && chkpnt !=0 && last_checkpoint != checkpoints - 1 && last_checkpoint > 0) {
+		last_checkpoint = 0;
+		lapflag = 2;
+	}
+
+	current_checkpoint = chkpnt;
+}
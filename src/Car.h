@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2014  Miriam Ruiz <miriam@debian.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CAR_H_F8009D14_059E_11E4_4B8D_10FEED04CD1C
+#define CAR_H_F8009D14_059E_11E4_4B8D_10FEED04CD1C
+
+#include <SDL2/SDL.h>
+
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.141592654
+#endif
+
+class Car {
+public:
+	int lap;
+	int lapflag;
+	int crashflag;
+	int slideflag; // 1 if the tires slide, 2 if they slide while braking
+	int color;
+
+	Car() {
+	}
+
+	void resetTimer() {
+		global_time_ms = 0;
+		inc_time_ms    = 0;
+	}
+	void setSize(int l, int w) {
+		length        = l;
+		width         = w;
+	}
+	void setBodySize(float l, float w) { // the footprint of the car itself, smaller than its sprite
+		body_length   = l;
+		body_width    = w;
+	}
+	void setPosition(float x, float y, float azimut) {
+		now.pos_x     = x;
+		now.pos_y     = y;
+		now.ang_yaw   = azimut;
+	}
+	void setZ(float z, float pitch, float roll) {
+		now.pos_z     = z;
+		now.ang_pitch = pitch;
+		now.ang_roll  = roll;
+	}
+	void computeNewPosition(unsigned int milliseconds, float inertia_decay = 0.995) {
+		inertia_coef *= inertia_decay;
+		now.pos_x -= cos(now.ang_yaw) * inertia_coef;
+		now.pos_y -= sin(now.ang_yaw) * inertia_coef;
+	}
+	void incYaw(float ch) {
+		now.ang_yaw += ch;
+		fixAngles();
+	}
+	void turnLeft(float ch) {
+		if (inertia_coef < 0) {
+			now.ang_yaw += ch;
+		} else {
+			now.ang_yaw -= ch;
+		}
+		fixAngles();
+	}
+	void turnRight(float ch) {
+		if (inertia_coef < 0) {
+			now.ang_yaw -= ch;
+		} else {
+			now.ang_yaw += ch;
+		}
+		fixAngles();
+	}
+	void setInertiaCoef(float s) {
+		inertia_coef = s;
+	}
+	void incInertiaCoef(float is) {
+		inertia_coef += is ;
+	}
+	void decInertiaCoef(float ds) {
+		inertia_coef -= ds ;
+	}
+	void decInertiaCoefByFactor(float fs) {
+		inertia_coef -= inertia_coef * fs;
+	}
+	void backupPosition() {
+		before = now;
+	}
+	void restorePosition() {
+		now = before;
+	}
+	void push(float dx, float dy) {
+		now.pos_x += dx;
+		now.pos_y += dy;
+	}
+	float getPosX() const {
+		return now.pos_x;
+	}
+	float getPosY() const {
+		return now.pos_y;
+	}
+	float getPosZ() const {
+		return now.pos_z;
+	}
+	float getLastPosX() const {
+		return before.pos_x;
+	}
+	float getLastPosY() const {
+		return before.pos_y;
+	}
+	float getSpeedX() const {
+		return now.spd_x;
+	}
+	float getSpeedY() const {
+		return now.spd_y;
+	}
+	float getSpeedZ() const {
+		return now.spd_z;
+	}
+	float getAccelX() const {
+		return now.acc_x;
+	}
+	float getAccelY() const {
+		return now.acc_y;
+	}
+	float getAccelZ() const {
+		return now.acc_z;
+	}
+	float getWidth() const {
+		return width;
+	}
+	float getLength() const {
+		return length;
+	}
+	float getBodyLength() const {
+		return body_length;
+	}
+	float getBodyWidth() const {
+		return body_width;
+	}
+	float getYaw() const {
+		return now.ang_yaw;
+	}
+	float getPitch() const {
+		return now.ang_pitch;
+	}
+	float getRoll() const {
+		return now.ang_roll;
+	}
+	int getCurrentCheckpoint() const {
+		return current_checkpoint;
+	}
+	int getLastCheckpoint() const {
+		return last_checkpoint;
+	}
+	void cleanCheckpoints() {
+		current_checkpoint = 0;
+		last_checkpoint = 0;
+		progress = 0;
+		lap = 0;
+	}
+	void setCheckpoints(int n) {
+		checkpoints = n;
+	}
+	void leaveCheckpoint(int cp) { // went back through its gate
+		current_checkpoint = (0 == cp ? checkpoints - 1 : cp - 1);
+	}
+	void updateProgress(float p) { // unknown (negative) values keep the last one
+		if (p >= 0) {
+			progress = p;
+		}
+	}
+	float getProgress() const {
+		return progress;
+	}
+	float getInertiaCoef() const {
+		return inertia_coef;
+	}
+	unsigned int getTimer() const {
+		return global_time_ms;
+	}
+	void togglePositionLights() {
+		position_lights = !position_lights;
+	}
+
+	void updateCheckpoints(int cp);
+	void updateTimer(unsigned int milliseconds);
+	void drawBrakeLights(SDL_Renderer * renderer, float offset_x = 0, float offset_y = 0);
+	void drawReversingLights(SDL_Renderer * renderer, float offset_x = 0, float offset_y = 0);
+	void drawWarningLights(SDL_Renderer * renderer, float offset_x = 0, float offset_y = 0);
+	void drawPositionLights(SDL_Renderer * renderer, float offset_x = 0, float offset_y = 0);
+
+private:
+	void fixAngles() { // limit angle between 0 and 2*pi
+		if ( now.ang_yaw < 0. ) {
+			now.ang_yaw += 2. * M_PI;
+		}
+		if ( now.ang_yaw > 2. * M_PI ) {
+			now.ang_yaw -= 2. * M_PI;
+		}
+	}
+
+	static void drawRawLight(SDL_Renderer * renderer, int x, int y, int r);
+
+	int length;
+	int width;
+	float body_length;
+	float body_width;
+
+	struct State {
+		float pos_x;
+		float pos_y;
+		float pos_z;
+		float spd_x;
+		float spd_y;
+		float spd_z;
+		float acc_x;
+		float acc_y;
+		float acc_z;
+
+		float ang_yaw; // rotation around vertical axis
+		float ang_pitch; // rotation around axis orthogonal to movement
+		float ang_roll; // rotation around axis in direction of movement
+
+		State() :
+			pos_x(0),
+			pos_y(0),
+			pos_z(0),
+			spd_x(0),
+			spd_y(0),
+			spd_z(0),
+			acc_x(0),
+			acc_y(0),
+			acc_z(0),
+			ang_yaw(0),
+			ang_pitch(0),
+			ang_roll(0)
+		{
+		}
+	};
+
+	State now;
+	State before;
+
+	int current_checkpoint;
+	int last_checkpoint;
+	int checkpoints;
+	float progress; // distance along the current lap, in pixels
+
+	float inertia_coef;
+	bool position_lights;
+	unsigned int global_time_ms;
+	unsigned int inc_time_ms;
+};
+
+// what the driver of a car does, with the same meaning as the joystick axes:
+// up_down < 0 accelerates and > 0 brakes, left_right < 0 turns left and > 0 right
+struct CarInput {
+	float up_down;
+	float left_right;
+};
+
+#endif // CAR_H_F8009D14_059E_11E4_4B8D_10FEED04CD1C
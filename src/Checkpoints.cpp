@@ -0,0 +1,158 @@
+#include "Checkpoints.h"
+
+#include <cmath>
+#include <cstring>
+
+int Checkpoint::crossGate(float x0, float y0, float x1, float y1) const {
+	float gate_dx = gate_x1 - gate_x0;
+	float gate_dy = gate_y1 - gate_y0;
+	float side0 = gate_dx * (y0 - gate_y0) - gate_dy * (x0 - gate_x0);
+	float side1 = gate_dx * (y1 - gate_y0) - gate_dy * (x1 - gate_x0);
+	if ((side0 > 0) == (side1 > 0)) { // both ends on the same side of the gate's line
+		return 0;
+	}
+	float move_dx = x1 - x0;
+	float move_dy = y1 - y0;
+	float end0 = move_dx * (gate_y0 - y0) - move_dy * (gate_x0 - x0);
+	float end1 = move_dx * (gate_y1 - y0) - move_dy * (gate_x1 - x0);
+	if ((end0 > 0) == (end1 > 0)) { // both ends of the gate on the same side of the movement
+		return 0;
+	}
+	return (side1 > 0 ? 1 : -1);
+}
+
+// pixels of a checkpoint that touch the previous one
+struct GatePixels {
+	std::vector<float> x;
+	std::vector<float> y;
+	double dir_x; // from the previous checkpoint to this one
+	double dir_y;
+
+	GatePixels() : dir_x(0), dir_y(0) {
+	}
+};
+
+static const int NEIGHBOUR_DX[4] = { 1, -1, 0, 0 };
+static const int NEIGHBOUR_DY[4] = { 0, 0, 1, -1 };
+
+// the gate is the principal axis of the border pixels, as long as the border
+static void fitGate(const GatePixels & border, Checkpoint & checkpoint) {
+	size_t n = border.x.size();
+	if (0 == n) { // no previous checkpoint next to it: a gate that can't be crossed
+		checkpoint.gate_x0 = checkpoint.gate_x1 = checkpoint.centre_x;
+		checkpoint.gate_y0 = checkpoint.gate_y1 = checkpoint.centre_y;
+		return;
+	}
+
+	double mean_x = 0, mean_y = 0;
+	for (size_t i = 0; i < n; ++i) {
+		mean_x += border.x[i];
+		mean_y += border.y[i];
+	}
+	mean_x /= n;
+	mean_y /= n;
+
+	double sxx = 0, sxy = 0, syy = 0;
+	for (size_t i = 0; i < n; ++i) {
+		double dx = border.x[i] - mean_x;
+		double dy = border.y[i] - mean_y;
+		sxx += dx * dx;
+		sxy += dx * dy;
+		syy += dy * dy;
+	}
+	double angle = 0.5 * atan2(2 * sxy, sxx - syy);
+	double axis_x = cos(angle);
+	double axis_y = sin(angle);
+	if (axis_x * border.dir_y - axis_y * border.dir_x < 0) { // keep this checkpoint on the left
+		axis_x = -axis_x;
+		axis_y = -axis_y;
+	}
+
+	double min_t = 0, max_t = 0;
+	for (size_t i = 0; i < n; ++i) {
+		double t = (border.x[i] - mean_x) * axis_x + (border.y[i] - mean_y) * axis_y;
+		if (t < min_t) min_t = t;
+		if (t > max_t) max_t = t;
+	}
+	checkpoint.gate_x0 = mean_x + axis_x * min_t;
+	checkpoint.gate_y0 = mean_y + axis_y * min_t;
+	checkpoint.gate_x1 = mean_x + axis_x * max_t;
+	checkpoint.gate_y1 = mean_y + axis_y * max_t;
+}
+
+int scanCheckpoints(const uint8_t * checkpoint, const uint8_t * road, int width, int height,
+	std::vector<Checkpoint> & checkpoints)
+{
+	size_t count = (size_t)width * height;
+	int last = -1;
+	for (size_t i = 0; i < count; ++i) {
+		if (road[i] && checkpoint[i] > last) {
+			last = checkpoint[i];
+		}
+	}
+	checkpoints.resize(last + 1);
+	if (last < 0) {
+		return 0;
+	}
+
+	std::vector<double> sum_x(last + 1, 0);
+	std::vector<double> sum_y(last + 1, 0);
+	std::vector<GatePixels> borders(last + 1);
+	for (int k = 0; k <= last; ++k) {
+		Checkpoint & c = checkpoints[k];
+		memset(&c, 0, sizeof(c));
+		c.min_x = width;
+		c.min_y = height;
+		c.max_x = -1;
+		c.max_y = -1;
+	}
+
+	// the centre of pixel (x, y) is at (x + 0.5, y + 0.5) in track coordinates
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			size_t i = (size_t)y * width + x;
+			if (!road[i]) {
+				continue;
+			}
+			int k = checkpoint[i];
+			Checkpoint & c = checkpoints[k];
+			++c.pixels;
+			if (x < c.min_x) c.min_x = x;
+			if (y < c.min_y) c.min_y = y;
+			if (x > c.max_x) c.max_x = x;
+			if (y > c.max_y) c.max_y = y;
+			sum_x[k] += x + 0.5;
+			sum_y[k] += y + 0.5;
+
+			int previous = (0 == k ? last : k - 1);
+			for (int n = 0; n < 4; ++n) {
+				int nx = x + NEIGHBOUR_DX[n];
+				int ny = y + NEIGHBOUR_DY[n];
+				if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+					continue;
+				}
+				size_t j = (size_t)ny * width + nx;
+				if (road[j] && previous == checkpoint[j] && previous != k) {
+					GatePixels & border = borders[k];
+					border.x.push_back(x + 0.5);
+					border.y.push_back(y + 0.5);
+					border.dir_x -= NEIGHBOUR_DX[n];
+					border.dir_y -= NEIGHBOUR_DY[n];
+					break;
+				}
+			}
+		}
+	}
+
+	for (int k = 0; k <= last; ++k) {
+		Checkpoint & c = checkpoints[k];
+		if (0 == c.pixels) {
+			c.min_x = c.min_y = c.max_x = c.max_y = 0;
+			continue;
+		}
+		c.centre_x = sum_x[k] / c.pixels;
+		c.centre_y = sum_y[k] / c.pixels;
+		fitGate(borders[k], c);
+	}
+	return last + 1;
+}
@@ -0,0 +1,36 @@
+#ifndef CHECKPOINTS_H_462AE3CF_958F_11E4_2D02_10FEED04CD1C
+#define CHECKPOINTS_H_462AE3CF_958F_11E4_2D02_10FEED04CD1C
+
+#include <stdint.h>
+#include <vector>
+
+// What is known of every checkpoint of a track. It is also the layout used in
+// the tile files, so it only has fixed size fields.
+struct Checkpoint {
+	uint32_t pixels; // drivable pixels in it, 0 if the track doesn't have it
+	int32_t min_x;   // bounding box
+	int32_t min_y;
+	int32_t max_x;
+	int32_t max_y;
+	float centre_x;
+	float centre_y;
+
+	// border with the previous checkpoint, oriented so that this checkpoint is on
+	// its left (positive cross product) and the previous one on its right
+	float gate_x0;
+	float gate_y0;
+	float gate_x1;
+	float gate_y1;
+
+	// > 0 if the segment from (x0, y0) to (x1, y1) goes through the gate into the
+	// checkpoint, < 0 if it goes back through it, 0 if it doesn't cross it
+	int crossGate(float x0, float y0, float x1, float y1) const;
+};
+
+// Scan the checkpoint of every pixel (the red of the function map / 8) and fill
+// one Checkpoint for each of them, up to the highest one found on the road
+// (road quality > 0). Returns the number of checkpoints.
+int scanCheckpoints(const uint8_t * checkpoint, const uint8_t * road, int width, int height,
+	std::vector<Checkpoint> & checkpoints);
+
+#endif // CHECKPOINTS_H_462AE3CF_958F_11E4_2D02_10FEED04CD1C
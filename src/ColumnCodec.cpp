@@ -0,0 +1,195 @@
+#include "ColumnCodec.h"
+
+#include <cstring>
+
+static const int LZ_MIN_MATCH = 4;
+static const int LZ_HASH_BITS = 12;
+static const size_t LZ_MAX_OFFSET = 65535;
+
+static inline uint32_t zigzag(uint32_t delta) {
+	return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+}
+
+static inline uint32_t unzigzag(uint32_t value) {
+	return (value >> 1) ^ (0u - (value & 1));
+}
+
+uint32_t encodeColumn(const uint32_t * values, int count, int stride, std::vector<uint8_t> & out,
+	size_t & plain_bytes)
+{
+	size_t raw_bytes = count * sizeof(uint32_t);
+	std::vector<uint8_t> plain;
+	plain.reserve(raw_bytes / 2);
+	for (int i = 0; i < count; ++i) {
+		uint32_t value = zigzag(values[i] - (i >= stride ? values[i - stride] : 0));
+		while (value >= 0x80) {
+			plain.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		plain.push_back((uint8_t)value);
+	}
+	plain_bytes = plain.size();
+
+	out.clear();
+	if (!plain.empty()) {
+		lzCompress(&plain[0], plain.size(), out);
+	}
+	if (out.size() < plain.size() && out.size() < raw_bytes) {
+		return COLUMN_DELTA | COLUMN_LZ;
+	}
+	if (plain.size() < raw_bytes) {
+		out.swap(plain);
+		return COLUMN_DELTA;
+	}
+	const uint8_t * bytes = reinterpret_cast<const uint8_t *>(values);
+	out.assign(bytes, bytes + raw_bytes);
+	plain_bytes = raw_bytes;
+	return COLUMN_RAW;
+}
+
+bool decodeColumn(const uint8_t * data, size_t size, size_t plain_bytes, uint32_t encoding,
+	uint32_t * values, int count, int stride)
+{
+	if (COLUMN_RAW == encoding) {
+		if (size != count * sizeof(uint32_t)) {
+			return false;
+		}
+		memcpy(values, data, size);
+		return true;
+	}
+
+	std::vector<uint8_t> plain;
+	if (encoding & COLUMN_LZ) {
+		plain.resize(plain_bytes);
+		if (plain_bytes > 0 && !lzDecompress(data, size, &plain[0], plain_bytes)) {
+			return false;
+		}
+		data = (plain_bytes > 0 ? &plain[0] : NULL);
+		size = plain_bytes;
+	}
+	if (!(encoding & COLUMN_DELTA)) {
+		return false;
+	}
+
+	size_t p = 0;
+	for (int i = 0; i < count; ++i) {
+		uint32_t value = 0;
+		int shift = 0;
+		while (true) {
+			if (p >= size || shift > 28) {
+				return false;
+			}
+			uint8_t byte = data[p++];
+			value |= (uint32_t)(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				break;
+			}
+			shift += 7;
+		}
+		values[i] = unzigzag(value) + (i >= stride ? values[i - stride] : 0);
+	}
+	return p == size;
+}
+
+static void lzLength(size_t length, std::vector<uint8_t> & out) {
+	while (length >= 255) {
+		out.push_back(255);
+		length -= 255;
+	}
+	out.push_back((uint8_t)length);
+}
+
+static void lzSequence(const uint8_t * literals, size_t literal_length, size_t offset, size_t match_length,
+	std::vector<uint8_t> & out)
+{
+	size_t match_code = (match_length > 0 ? match_length - LZ_MIN_MATCH : 0);
+	out.push_back((uint8_t)(((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15)));
+	if (literal_length >= 15) {
+		lzLength(literal_length - 15, out);
+	}
+	out.insert(out.end(), literals, literals + literal_length);
+	if (match_length > 0) {
+		out.push_back((uint8_t)(offset & 0xff));
+		out.push_back((uint8_t)(offset >> 8));
+		if (match_code >= 15) {
+			lzLength(match_code - 15, out);
+		}
+	}
+}
+
+// greedy, with the last position of every hash of 4 bytes
+void lzCompress(const uint8_t * in, size_t size, std::vector<uint8_t> & out) {
+	std::vector<int> table(1 << LZ_HASH_BITS, -1);
+	size_t anchor = 0;
+	size_t p = 0;
+	while (p + LZ_MIN_MATCH <= size) {
+		uint32_t word;
+		memcpy(&word, in + p, sizeof(word));
+		uint32_t hash = (word * 2654435761u) >> (32 - LZ_HASH_BITS);
+		int candidate = table[hash];
+		table[hash] = p;
+		if (candidate < 0 || p - candidate > LZ_MAX_OFFSET || memcmp(in + candidate, in + p, LZ_MIN_MATCH) != 0) {
+			++p;
+			continue;
+		}
+		size_t length = LZ_MIN_MATCH;
+		while (p + length < size && in[candidate + length] == in[p + length]) {
+			++length;
+		}
+		lzSequence(in + anchor, p - anchor, p - candidate, length, out);
+		p += length;
+		anchor = p;
+	}
+	lzSequence(in + anchor, size - anchor, 0, 0, out); // the last literals, without a match
+}
+
+static bool lzReadLength(const uint8_t * in, size_t size, size_t & p, size_t & length) {
+	uint8_t byte;
+	do {
+		if (p >= size) {
+			return false;
+		}
+		byte = in[p++];
+		length += byte;
+	} while (255 == byte);
+	return true;
+}
+
+bool lzDecompress(const uint8_t * in, size_t size, uint8_t * out, size_t out_size) {
+	size_t p = 0;
+	size_t o = 0;
+	while (p < size) {
+		uint8_t token = in[p++];
+		size_t literal_length = token >> 4;
+		if (15 == literal_length && !lzReadLength(in, size, p, literal_length)) {
+			return false;
+		}
+		if (literal_length > size - p || literal_length > out_size - o) {
+			return false;
+		}
+		memcpy(out + o, in + p, literal_length);
+		p += literal_length;
+		o += literal_length;
+		if (p == size) { // the last sequence has no match
+			break;
+		}
+
+		if (p + 2 > size) {
+			return false;
+		}
+		size_t offset = in[p] | (in[p + 1] << 8);
+		p += 2;
+		size_t match_length = token & 15;
+		if (15 == match_length && !lzReadLength(in, size, p, match_length)) {
+			return false;
+		}
+		match_length += LZ_MIN_MATCH;
+		if (0 == offset || offset > o || match_length > out_size - o) {
+			return false;
+		}
+		for (size_t i = 0; i < match_length; ++i, ++o) { // the match can overlap what it writes
+			out[o] = out[o - offset];
+		}
+	}
+	return o == out_size;
+}
@@ -0,0 +1,32 @@
+#ifndef COLUMNCODEC_H_FC04C987_AFBD_11E4_4205_10FEED04CD1C
+#define COLUMNCODEC_H_FC04C987_AFBD_11E4_4205_10FEED04CD1C
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Compression of the columns of 32 bits values of the telemetry logs.
+//
+// COLUMN_DELTA stores every value as its difference with the value stride places
+// before it (the same car in the previous tick), zigzagged so that small negative
+// differences are small too, in LEB128 varints; the bits of floats are subtracted
+// as integers, so nothing is lost. COLUMN_LZ then compresses those bytes in the
+// block format of LZ4: sequences of literals followed by a match of at least 4 bytes
+// up to 64 KB back.
+enum ColumnEncoding {
+	COLUMN_RAW   = 0,
+	COLUMN_DELTA = 1,
+	COLUMN_LZ    = 2
+};
+
+// the smallest of the encodings of count values, stored in out; plain_bytes is the
+// size before COLUMN_LZ, for decodeColumn()
+uint32_t encodeColumn(const uint32_t * values, int count, int stride, std::vector<uint8_t> & out,
+	size_t & plain_bytes);
+bool decodeColumn(const uint8_t * data, size_t size, size_t plain_bytes, uint32_t encoding,
+	uint32_t * values, int count, int stride);
+
+void lzCompress(const uint8_t * in, size_t size, std::vector<uint8_t> & out); // appended to out
+bool lzDecompress(const uint8_t * in, size_t size, uint8_t * out, size_t out_size);
+
+#endif // COLUMNCODEC_H_FC04C987_AFBD_11E4_4205_10FEED04CD1C
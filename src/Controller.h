@@ -0,0 +1,23 @@
+#ifndef CONTROLLER_H_B78109BF_9899_11E4_CDC7_10FEED04CD1C
+#define CONTROLLER_H_B78109BF_9899_11E4_CDC7_10FEED04CD1C
+
+#include "Simulation.h"
+#include "Threads.h"
+
+// Drives many cars of a simulation at once: it looks at all of them and sets all
+// of their inputs in a single call per tick, so whatever it costs per call is
+// paid once for the whole field instead of once per car.
+class Controller {
+public:
+	virtual ~Controller() {
+	}
+
+	// forget what was known of the cars, after they are placed again or the track changes
+	virtual void reset(const Simulation & simulation) = 0;
+
+	// set the inputs of the given cars (count of them) from their state; the pool,
+	// if any, can be used to split them between threads
+	virtual void drive(Simulation & simulation, const int * cars, int count, ThreadPool * pool = NULL) = 0;
+};
+
+#endif // CONTROLLER_H_B78109BF_9899_11E4_CDC7_10FEED04CD1C
@@ -0,0 +1,144 @@
+#include "DistanceTransform.h"
+
+#include <cmath>
+#include <vector>
+
+static const double INF = 1e20;
+
+// squared distance transform of a sampled function of one variable: d[q] = min (q - p)^2 + f[p]
+// v and z are scratch buffers of n and n + 1 elements
+static void transform1D(const double * f, int n, double * d, int * v, double * z) {
+	int k = 0;
+	v[0] = 0;
+	z[0] = -INF;
+	z[1] = INF;
+	for (int q = 1; q < n; ++q) { // lower envelope of the parabolas rooted at every sample
+		double s;
+		while (true) { // z[0] is -INF, so it stops at the first parabola at the latest
+			int p = v[k];
+			s = ((f[q] + (double)q * q) - (f[p] + (double)p * p)) / (2.0 * (q - p));
+			if (s > z[k]) {
+				break;
+			}
+			--k;
+		}
+		++k;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = INF;
+	}
+
+	k = 0;
+	for (int q = 0; q < n; ++q) {
+		while (z[k + 1] < q) {
+			++k;
+		}
+		double dq = q - v[k];
+		d[q] = dq * dq + f[v[k]];
+	}
+}
+
+// Scratch buffers of one line, so that every range of lines allocates them once
+struct LineBuffers {
+	std::vector<double> f_outside;
+	std::vector<double> f_inside;
+	std::vector<double> d_outside;
+	std::vector<double> d_inside;
+	std::vector<int> v;
+	std::vector<double> z;
+
+	LineBuffers(int n) :
+		f_outside(n), f_inside(n), d_outside(n), d_inside(n), v(n), z(n + 1)
+	{
+	}
+};
+
+// squared distances along the columns, to the nearest pixel in and out of the mask
+class ColumnPass : public ParallelTask {
+public:
+	ColumnPass(const uint8_t * mask, int width, int height, float * outside, float * inside) :
+		mxMask(mask), miWidth(width), miHeight(height), mxOutside(outside), mxInside(inside)
+	{
+	}
+
+	virtual void run(int begin, int end) {
+		LineBuffers line(miHeight);
+		for (int x = begin; x < end; ++x) {
+			for (int y = 0; y < miHeight; ++y) {
+				bool in = (0 != mxMask[y * miWidth + x]);
+				line.f_outside[y] = (in ? 0 : INF);
+				line.f_inside[y]  = (in ? INF : 0);
+			}
+			transform1D(&line.f_outside[0], miHeight, &line.d_outside[0], &line.v[0], &line.z[0]);
+			transform1D(&line.f_inside[0],  miHeight, &line.d_inside[0],  &line.v[0], &line.z[0]);
+			for (int y = 0; y < miHeight; ++y) {
+				mxOutside[y * miWidth + x] = line.d_outside[y];
+				mxInside[y * miWidth + x]  = line.d_inside[y];
+			}
+		}
+	}
+
+private:
+	const uint8_t * mxMask;
+	int miWidth;
+	int miHeight;
+	float * mxOutside;
+	float * mxInside;
+};
+
+// complete the squared distances along the rows and turn them into the signed distance
+class RowPass : public ParallelTask {
+public:
+	RowPass(const uint8_t * mask, int width, const float * outside, const float * inside, float * distance) :
+		mxMask(mask), miWidth(width), mxOutside(outside), mxInside(inside), mxDistance(distance)
+	{
+	}
+
+	virtual void run(int begin, int end) {
+		LineBuffers line(miWidth);
+		for (int y = begin; y < end; ++y) {
+			const float * outside = mxOutside + y * miWidth;
+			const float * inside  = mxInside  + y * miWidth;
+			for (int x = 0; x < miWidth; ++x) {
+				line.f_outside[x] = outside[x];
+				line.f_inside[x]  = inside[x];
+			}
+			transform1D(&line.f_outside[0], miWidth, &line.d_outside[0], &line.v[0], &line.z[0]);
+			transform1D(&line.f_inside[0],  miWidth, &line.d_inside[0],  &line.v[0], &line.z[0]);
+
+			// the distances are between pixel centres, and the border is half a pixel
+			// away from the centre of the last pixel on each side of it
+			const uint8_t * mask = mxMask + y * miWidth;
+			float * distance = mxDistance + y * miWidth;
+			for (int x = 0; x < miWidth; ++x) {
+				if (0 != mask[x]) {
+					distance[x] = -(sqrt(line.d_inside[x]) - 0.5);
+				} else {
+					distance[x] = sqrt(line.d_outside[x]) - 0.5;
+				}
+			}
+		}
+	}
+
+private:
+	const uint8_t * mxMask;
+	int miWidth;
+	const float * mxOutside;
+	const float * mxInside;
+	float * mxDistance;
+};
+
+void signedDistanceTransform(const uint8_t * mask, int width, int height, float * distance, ThreadPool & pool) {
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+	size_t count = (size_t)width * height;
+	std::vector<float> outside(count);
+	std::vector<float> inside(count);
+
+	ColumnPass columns(mask, width, height, &outside[0], &inside[0]);
+	pool.parallelFor(width, columns, 16);
+
+	RowPass rows(mask, width, &outside[0], &inside[0], distance);
+	pool.parallelFor(height, rows, 16);
+}
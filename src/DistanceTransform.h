@@ -0,0 +1,18 @@
+#ifndef DISTANCETRANSFORM_H_ECC2477D_4418_11E4_61DC_10FEED04CD1C
+#define DISTANCETRANSFORM_H_ECC2477D_4418_11E4_61DC_10FEED04CD1C
+
+#include "Threads.h"
+
+#include <stdint.h>
+
+// Exact Euclidean distance transform in linear time (Felzenszwalb & Huttenlocher),
+// done as a pass over the columns and then a pass over the rows, each one split
+// between the threads of the pool.
+//
+// Writes in distance[y * width + x] the signed distance in pixels from every pixel
+// to the border of the mask (the pixels where mask != 0): negative inside of the
+// mask and positive outside of it, so that the border is where it changes sign.
+void signedDistanceTransform(const uint8_t * mask, int width, int height, float * distance,
+	ThreadPool & pool = ThreadPool::getDefault());
+
+#endif // DISTANCETRANSFORM_H_ECC2477D_4418_11E4_61DC_10FEED04CD1C
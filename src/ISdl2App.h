@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 struct SDL_Window;
+class TelemetryChannel;
 
 struct ISdl2App {
 	virtual ~ISdl2App() { }
@@ -14,6 +15,7 @@ struct ISdl2App {
 	virtual void processEvents() = 0;
 
 	virtual bool getInfo(void * dest, unsigned int type, intptr_t param) = 0;
+	virtual const TelemetryChannel & getTelemetry() const = 0;
 };
 
 #endif
@@ -1,10 +1,12 @@
 #include "InfoHandler.h"
-#include "InfoTypes.h"
+#include "Telemetry.h"
 #include "Common.h"
+#include "Profiler.h"
 
 #include <cstdio>
 #include <cstdarg>
 #include <cmath>
+#include <cstring>
 
 #ifndef M_PI
 #define M_PI 3.141592654
@@ -13,60 +15,112 @@
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
 
-InfoHandler::InfoHandler(ISdl2App * app, GtkWidget * window, GtkBuilder * builder) : mxApp(app), mxWindow(window) {
-	mpWidgetXPosition          = GTK_WIDGET(gtk_builder_get_object(builder, "position_x"));
-	mpWidgetYPosition          = GTK_WIDGET(gtk_builder_get_object(builder, "position_y"));
-	mpWidgetZPosition          = GTK_WIDGET(gtk_builder_get_object(builder, "position_z"));
-	mpWidgetXSpeed             = GTK_WIDGET(gtk_builder_get_object(builder, "speed_x"));
-	mpWidgetYSpeed             = GTK_WIDGET(gtk_builder_get_object(builder, "speed_y"));
-	mpWidgetZSpeed             = GTK_WIDGET(gtk_builder_get_object(builder, "speed_z"));
-	mpWidgetYawAngle           = GTK_WIDGET(gtk_builder_get_object(builder, "angle_yaw"));
-	mpWidgetPitchAngle         = GTK_WIDGET(gtk_builder_get_object(builder, "angle_pitch"));
-	mpWidgetRollAngle          = GTK_WIDGET(gtk_builder_get_object(builder, "angle_roll"));
-	mpWidgetLastCheckpoint     = GTK_WIDGET(gtk_builder_get_object(builder, "checkpoint_last"));
-	mpWidgetCurrentCheckpoint  = GTK_WIDGET(gtk_builder_get_object(builder, "checkpoint_current"));
+const char * const InfoHandler::LABEL_IDS[NB_LABELS] = {
+	"position_x",
+	"position_y",
+	"position_z",
+	"speed_x",
+	"speed_y",
+	"speed_z",
+	"angle_yaw",
+	"angle_pitch",
+	"angle_roll",
+	"checkpoint_last",
+	"checkpoint_current",
+	"race_standing",
+	"race_gap"
+};
+
+InfoHandler::InfoHandler(ISdl2App * app, GtkWidget * window, GtkBuilder * builder) :
+	mxApp(app),
+	mxWindow(window),
+	mpFrame(new TelemetryFrame),
+	miLastSequence(0),
+	miUpdateRate(DEFAULT_UPDATE_RATE),
+	miLastUpdate(0),
+	miIdleSource(0)
+{
+	for (int l = 0; l < NB_LABELS; ++l) {
+		mpaLabels[l] = GTK_WIDGET(gtk_builder_get_object(builder, LABEL_IDS[l]));
+		maTexts[l][0] = '\0';
+	}
 	printf("InfoHandler Created\n");
 }
 
 InfoHandler::~InfoHandler() {
+	if (0 != miIdleSource) {
+		g_source_remove(miIdleSource);
+	}
+	delete mpFrame;
 	printf("InfoHandler Destroyed\n");
 }
 
+void InfoHandler::setUpdateRate(int hz) {
+	miUpdateRate = (hz > 0 ? hz : DEFAULT_UPDATE_RATE);
+}
+
 void InfoHandler::showInfo() {
-	float pos[3];
-	float spd[3];
-	float ang[3];
-	int   chk[2];
-	char  buff[16];
-
-	if (mxApp->getInfo(pos, INFO_POSITION_3F, 0)) {
-		snprintf(buff, sizeof(buff), "X: %.3f cm", 1.0 * pos[0]);
-		gtk_label_set_text(GTK_LABEL(mpWidgetXPosition), buff);
-		snprintf(buff, sizeof(buff), "Y: %.3f cm", 1.0 * pos[1]);
-		gtk_label_set_text(GTK_LABEL(mpWidgetYPosition), buff);
-		snprintf(buff, sizeof(buff), "Z: %.3f cm", 1.0 * pos[2]);
-		gtk_label_set_text(GTK_LABEL(mpWidgetZPosition), buff);
+	PROFILE_SCOPE("InfoHandler::showInfo");
+	if (0 != miIdleSource) {
+		return;
 	}
-	if (mxApp->getInfo(spd, INFO_SPEED_3F, 0)) {
-		snprintf(buff, sizeof(buff), "X: %.2f", spd[0]);
-		gtk_label_set_text(GTK_LABEL(mpWidgetXSpeed), buff);
-		snprintf(buff, sizeof(buff), "Y: %.2f", spd[1]);
-		gtk_label_set_text(GTK_LABEL(mpWidgetYSpeed), buff);
-		snprintf(buff, sizeof(buff), "Z: %.2f", spd[2]);
-		gtk_label_set_text(GTK_LABEL(mpWidgetZSpeed), buff);
+	gint64 now = g_get_monotonic_time();
+	if (now - miLastUpdate < 1000000 / miUpdateRate) {
+		return;
 	}
-	if (mxApp->getInfo(ang, INFO_ANGLES_3F, 0)) {
-		snprintf(buff, sizeof(buff), "Yaw: %.2f", ang[0] * 360.0 / (2 * M_PI) );
-		gtk_label_set_text(GTK_LABEL(mpWidgetYawAngle), buff);
-		snprintf(buff, sizeof(buff), "Pitch: %.2f", ang[1] * 360.0 / (2 * M_PI) );
-		gtk_label_set_text(GTK_LABEL(mpWidgetPitchAngle), buff);
-		snprintf(buff, sizeof(buff), "Roll: %.2f", ang[2] * 360.0 / (2 * M_PI) );
-		gtk_label_set_text(GTK_LABEL(mpWidgetRollAngle), buff);
+	miLastUpdate = now;
+	miIdleSource = g_idle_add(InfoHandler::updateIdle, this);
+}
+
+gboolean InfoHandler::updateIdle(gpointer user_data) {
+	InfoHandler * handler = (InfoHandler *)user_data;
+	handler->miIdleSource = 0;
+	handler->update();
+	return FALSE;
+}
+
+void InfoHandler::setLabel(Label label, const char * format, ...) {
+	char text[LABEL_LENGTH];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+	if (strcmp(text, maTexts[label]) != 0) {
+		strcpy(maTexts[label], text);
+		gtk_label_set_text(GTK_LABEL(mpaLabels[label]), text);
 	}
-	if (mxApp->getInfo(chk, INFO_CHECKPOINT_2I, 0)) {
-		snprintf(buff, sizeof(buff), "Curr: %d", chk[0] );
-		gtk_label_set_text(GTK_LABEL(mpWidgetCurrentCheckpoint), buff);
-		snprintf(buff, sizeof(buff), "Last: %d", chk[1] );
-		gtk_label_set_text(GTK_LABEL(mpWidgetLastCheckpoint), buff);
+}
+
+void InfoHandler::update() {
+	PROFILE_SCOPE("InfoHandler::update");
+	// one copy of the whole race, only when there is a new one
+	const TelemetryChannel & telemetry = mxApp->getTelemetry();
+	uint32_t sequence = telemetry.getSequence();
+	if (sequence == miLastSequence || !telemetry.read(*mpFrame)) {
+		return;
 	}
+	miLastSequence = sequence;
+	const TelemetryFrame & frame = *mpFrame;
+	if (frame.player < 0 || frame.player >= frame.car_count) {
+		return;
+	}
+	const CarTelemetry & car = frame.cars[frame.player];
+
+	setLabel(LABEL_POSITION_X, "X: %.3f cm", 1.0 * car.position[0]);
+	setLabel(LABEL_POSITION_Y, "Y: %.3f cm", 1.0 * car.position[1]);
+	setLabel(LABEL_POSITION_Z, "Z: %.3f cm", 1.0 * car.position[2]);
+
+	setLabel(LABEL_SPEED_X, "X: %.2f", car.speed[0]);
+	setLabel(LABEL_SPEED_Y, "Y: %.2f", car.speed[1]);
+	setLabel(LABEL_SPEED_Z, "Z: %.2f", car.speed[2]);
+
+	setLabel(LABEL_ANGLE_YAW,   "Yaw: %.2f",   car.angles[0] * 360.0 / (2 * M_PI) );
+	setLabel(LABEL_ANGLE_PITCH, "Pitch: %.2f", car.angles[1] * 360.0 / (2 * M_PI) );
+	setLabel(LABEL_ANGLE_ROLL,  "Roll: %.2f",  car.angles[2] * 360.0 / (2 * M_PI) );
+
+	setLabel(LABEL_CHECKPOINT_CURRENT, "Curr: %d", car.current_checkpoint );
+	setLabel(LABEL_CHECKPOINT_LAST,    "Last: %d", car.last_checkpoint );
+
+	setLabel(LABEL_STANDING, "Pos: %d/%d", car.standing + 1, frame.car_count );
+	setLabel(LABEL_GAP, "Gap: %.2f s", car.gap );
 }
@@ -3,35 +3,71 @@
 
 #include "ISdl2App.h"
 
+#include <stdint.h>
+
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
 
+struct TelemetryFrame;
+
+// The panel of the player's car, next to the game. It is updated at most
+// getUpdateRate() times per second, in an idle callback, and only the labels whose
+// text changed are set, since every one of them makes GTK lay the window out again.
 class InfoHandler {
 public:
+	static const int DEFAULT_UPDATE_RATE = 10; // Hz
+
 	InfoHandler(ISdl2App * app, GtkWidget * window, GtkBuilder * builder);
 	~InfoHandler();
 
-	void showInfo();
+	void showInfo(); // every frame; only schedules the update when it is due
+
+	void setUpdateRate(int hz);
+	int getUpdateRate() const {
+		return miUpdateRate;
+	}
 
 private:
+	enum Label {
+		LABEL_POSITION_X,
+		LABEL_POSITION_Y,
+		LABEL_POSITION_Z,
+		LABEL_SPEED_X,
+		LABEL_SPEED_Y,
+		LABEL_SPEED_Z,
+		LABEL_ANGLE_YAW,
+		LABEL_ANGLE_PITCH,
+		LABEL_ANGLE_ROLL,
+		LABEL_CHECKPOINT_LAST,
+		LABEL_CHECKPOINT_CURRENT,
+		LABEL_STANDING,
+		LABEL_GAP,
+		NB_LABELS
+	};
+
+	static const int LABEL_LENGTH = 16;
+	static const char * const LABEL_IDS[NB_LABELS];
+
 	ISdl2App   * mxApp;
 	GtkWidget  * mxWindow;
 
-	GtkWidget  * mpWidgetXPosition;
-	GtkWidget  * mpWidgetYPosition;
-	GtkWidget  * mpWidgetZPosition;
+	TelemetryFrame * mpFrame; // the last one shown
+	uint32_t     miLastSequence;
+
+	int          miUpdateRate;
+	gint64       miLastUpdate;  // monotonic time, in microseconds
+	guint        miIdleSource;  // 0 if no update is pending
 
-	GtkWidget  * mpWidgetXSpeed;
-	GtkWidget  * mpWidgetYSpeed;
-	GtkWidget  * mpWidgetZSpeed;
+	GtkWidget  * mpaLabels[NB_LABELS];
+	char         maTexts[NB_LABELS][LABEL_LENGTH]; // what they show
 
-	GtkWidget  * mpWidgetYawAngle;
-	GtkWidget  * mpWidgetPitchAngle;
-	GtkWidget  * mpWidgetRollAngle;
+	static gboolean updateIdle(gpointer user_data);
+	void update();
+	void setLabel(Label label, const char * format, ...) __attribute__((format(printf, 3, 4)));
 
-	GtkWidget  * mpWidgetLastCheckpoint;
-	GtkWidget  * mpWidgetCurrentCheckpoint;
+	InfoHandler(const InfoHandler &);
+	InfoHandler & operator=(const InfoHandler &);
 };
 
-#endif // SHOWINFO_H_FFA18220_6DEF_11E4_9C9B_10FEED04CD1C
+#endif // INFOHANDLER_H_FFA18220_6DEF_11E4_9C9B_10FEED04CD1C
 
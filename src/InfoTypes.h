@@ -6,7 +6,10 @@ enum InfoType {
 	INFO_POSITION_3F,
 	INFO_SPEED_3F,
 	INFO_ANGLES_3F,
-	INFO_CHECKPOINT_2I
+	INFO_CHECKPOINT_2I,
+	INFO_STANDING_2I, // position of the player, number of cars
+	INFO_PROGRESS_3F, // distance along the lap, length of the lap, seconds behind the leader
+	INFO_LIDAR_32F    // distance to the walls along 32 rays around the car, clockwise from right behind it
 };
 
 #endif // INFOTYPES_H_3E004DFE_6DF4_11E4_B69E_10FEED04CD1C
@@ -0,0 +1,72 @@
+#include "LatencyHistogram.h"
+
+#include <cstring>
+
+LatencyHistogram::LatencyHistogram() {
+	reset();
+}
+
+void LatencyHistogram::reset() {
+	memset(maCounts, 0, sizeof(maCounts));
+	miCount = 0;
+	miMax = 0;
+}
+
+// below SUB_BUCKETS, one bucket per value; above, the SUB_BUCKET_BITS bits at the
+// top of the value, of which the first is 1, after the number of bits shifted out
+int LatencyHistogram::getBucket(uint32_t us) {
+	if (us < (uint32_t)SUB_BUCKETS) {
+		return us;
+	}
+	int shift = (31 - __builtin_clz(us)) - (SUB_BUCKET_BITS - 1);
+	return shift * HALF_BUCKETS + (us >> shift);
+}
+
+uint32_t LatencyHistogram::getBucketHighest(int bucket) {
+	if (bucket < SUB_BUCKETS) {
+		return bucket;
+	}
+	int shift = bucket / HALF_BUCKETS - 1;
+	uint64_t top = (uint64_t)(bucket - shift * HALF_BUCKETS) + 1;
+	return (uint32_t)((top << shift) - 1);
+}
+
+void LatencyHistogram::record(uint32_t us) {
+	++maCounts[getBucket(us)];
+	++miCount;
+	if (us > miMax) {
+		miMax = us;
+	}
+}
+
+void LatencyHistogram::add(const LatencyHistogram & other) {
+	for (int i = 0; i < BUCKET_COUNT; ++i) {
+		maCounts[i] += other.maCounts[i];
+	}
+	miCount += other.miCount;
+	if (other.miMax > miMax) {
+		miMax = other.miMax;
+	}
+}
+
+uint32_t LatencyHistogram::getPercentile(double percentile) const {
+	if (0 == miCount) {
+		return 0;
+	}
+	// the rank of the value, from 1
+	uint64_t rank = (uint64_t)(percentile / 100.0 * miCount + 0.5);
+	if (rank < 1) {
+		rank = 1;
+	} else if (rank > miCount) {
+		rank = miCount;
+	}
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKET_COUNT; ++i) {
+		seen += maCounts[i];
+		if (seen >= rank) {
+			uint32_t highest = getBucketHighest(i);
+			return (highest < miMax ? highest : miMax);
+		}
+	}
+	return miMax;
+}
@@ -0,0 +1,43 @@
+#ifndef LATENCYHISTOGRAM_H_B81D5E27_6F3A_11E4_8C41_10FEED04CD1C
+#define LATENCYHISTOGRAM_H_B81D5E27_6F3A_11E4_8C41_10FEED04CD1C
+
+#include <stdint.h>
+
+// Durations in microseconds, counted in buckets like those of HdrHistogram: every
+// power of 2 is split in HALF_BUCKETS buckets of the same width, so that a value is
+// known within 1/HALF_BUCKETS (about 3%) from 1 us to more than an hour, in a fixed
+// array. Recording is an index and an increment, and a percentile a walk over it.
+class LatencyHistogram {
+public:
+	static const int SUB_BUCKET_BITS = 6;
+	static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const int HALF_BUCKETS = SUB_BUCKETS / 2;
+	static const int BUCKET_COUNT = (32 - SUB_BUCKET_BITS + 1) * HALF_BUCKETS + HALF_BUCKETS;
+
+	LatencyHistogram();
+
+	void reset();
+	void record(uint32_t us);
+	void add(const LatencyHistogram & other);
+
+	// the highest value of the bucket of the given percentile (0 to 100), but not
+	// more than the biggest one recorded; 0 if there is none
+	uint32_t getPercentile(double percentile) const;
+
+	uint32_t getCount() const {
+		return miCount;
+	}
+	uint32_t getMax() const {
+		return miMax;
+	}
+
+	static int getBucket(uint32_t us);
+	static uint32_t getBucketHighest(int bucket);
+
+private:
+	uint32_t maCounts[BUCKET_COUNT];
+	uint32_t miCount;
+	uint32_t miMax;
+};
+
+#endif // LATENCYHISTOGRAM_H_B81D5E27_6F3A_11E4_8C41_10FEED04CD1C
@@ -0,0 +1,197 @@
+#include "Lidar.h"
+#include "DistanceTransform.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const float MIN_STEP = 0.5;
+// the distances go from the centre of a pixel to the border of the nearest wall, give
+// or take what the corners of the wall pixels stick out; for any point of the pixel and
+// any point of the walls, one pixel less is on the safe side, as in TileMap::traceSegment()
+static const float MARGIN = 1;
+
+Lidar::Lidar(int rays, float range, float field_of_view) :
+	miWidth(0),
+	miHeight(0)
+{
+	setRays(rays, range, field_of_view);
+}
+
+void Lidar::setRays(int rays, float range, float field_of_view) {
+	miRays = (rays > 0 ? rays : 1);
+	mfRange = range;
+	int padded = (miRays + 3) & ~3;
+	mRayCos.assign(padded, 1);
+	mRaySin.assign(padded, 0);
+	for (int i = 0; i < miRays; ++i) {
+		float angle;
+		if (field_of_view >= FULL_TURN) {
+			angle = -FULL_TURN / 2 + FULL_TURN * i / miRays;
+		} else if (miRays > 1) {
+			angle = -field_of_view / 2 + field_of_view * i / (miRays - 1);
+		} else {
+			angle = 0;
+		}
+		mRayCos[i] = cos(angle);
+		mRaySin[i] = sin(angle);
+	}
+}
+
+void Lidar::setMap(TileMap & map) {
+	miWidth = map.getWidth();
+	miHeight = map.getHeight();
+	size_t count = (size_t)miWidth * miHeight;
+	mClearance.resize(count);
+	if (0 == count) {
+		return;
+	}
+	std::vector<uint8_t> walls(count);
+	for (int y = 0; y < miHeight; ++y) {
+		for (int x = 0; x < miWidth; ++x) {
+			walls[(size_t)y * miWidth + x] = (0 == map.functionAt(x, y)[1]);
+		}
+	}
+	std::vector<float> distance(count);
+	signedDistanceTransform(&walls[0], miWidth, miHeight, &distance[0]);
+
+	for (int y = 0; y < miHeight; ++y) {
+		int border_y = std::min(y, miHeight - 1 - y);
+		for (int x = 0; x < miWidth; ++x) {
+			size_t i = (size_t)y * miWidth + x;
+			if (walls[i]) {
+				mClearance[i] = 0;
+				continue;
+			}
+			// outside of the map is a wall too
+			float border = std::min(std::min(x, miWidth - 1 - x), border_y) + 0.5;
+			float clearance = floor(std::min(distance[i], border) - MARGIN);
+			mClearance[i] = 1 + (clearance < 0 ? 0 : (clearance > 254 ? 254 : clearance));
+		}
+	}
+}
+
+void Lidar::clearMap() {
+	miWidth = 0;
+	miHeight = 0;
+	mClearance.clear();
+}
+
+class Lidar::Scanner : public ParallelTask {
+public:
+	Scanner(const Lidar & lidar, const float * x, const float * y, const float * yaw, float * distances) :
+		mxLidar(lidar), mxX(x), mxY(y), mxYaw(yaw), mxDistances(distances)
+	{
+	}
+
+	virtual void run(int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			mxLidar.scanCar(mxX[i], mxY[i], mxYaw[i], mxDistances + (size_t)i * mxLidar.miRays);
+		}
+	}
+
+private:
+	const Lidar & mxLidar;
+	const float * mxX;
+	const float * mxY;
+	const float * mxYaw;
+	float * mxDistances;
+};
+
+void Lidar::scan(const float * x, const float * y, const float * yaw, int count,
+	float * distances, ThreadPool * pool) const
+{
+	Scanner scanner(*this, x, y, yaw, distances);
+	if (NULL != pool) {
+		pool->parallelFor(count, scanner, 16);
+	} else {
+		scanner.run(0, count);
+	}
+}
+
+#ifdef __SSE2__
+
+void Lidar::scanCar(float x, float y, float yaw, float * distances) const {
+	int32_t px[4] __attribute__((aligned(16)));
+	int32_t py[4] __attribute__((aligned(16)));
+	int32_t clearance[4] __attribute__((aligned(16)));
+	float hit[4] __attribute__((aligned(16)));
+
+	// the car heads to -(cos, sin) of its yaw, and so does a ray of relative angle 0
+	__m128 heading_cos = _mm_set1_ps(-cos(yaw));
+	__m128 heading_sin = _mm_set1_ps(-sin(yaw));
+	__m128 origin_x = _mm_set1_ps(x);
+	__m128 origin_y = _mm_set1_ps(y);
+	__m128 range = _mm_set1_ps(mfRange);
+	__m128 one = _mm_set1_ps(1);
+	__m128 min_step = _mm_set1_ps(MIN_STEP);
+	__m128 zero = _mm_setzero_ps();
+	__m128 width = _mm_set1_ps(miWidth);
+	__m128 height = _mm_set1_ps(miHeight);
+
+	for (int r = 0; r < miRays; r += 4) {
+		__m128 ray_cos = _mm_loadu_ps(&mRayCos[r]);
+		__m128 ray_sin = _mm_loadu_ps(&mRaySin[r]);
+		__m128 dx = _mm_sub_ps(_mm_mul_ps(heading_cos, ray_cos), _mm_mul_ps(heading_sin, ray_sin));
+		__m128 dy = _mm_add_ps(_mm_mul_ps(heading_sin, ray_cos), _mm_mul_ps(heading_cos, ray_sin));
+
+		__m128 t = zero;
+		__m128 active = _mm_cmpeq_ps(zero, zero); // rays still being traced
+		__m128 result = range;
+		int lanes = (miRays - r < 4 ? (1 << (miRays - r)) - 1 : 15);
+		while (_mm_movemask_ps(active) & lanes) {
+			__m128 sample_x = _mm_add_ps(origin_x, _mm_mul_ps(dx, t));
+			__m128 sample_y = _mm_add_ps(origin_y, _mm_mul_ps(dy, t));
+			__m128 inside = _mm_and_ps( // outside of the map is a wall
+				_mm_and_ps(_mm_cmpge_ps(sample_x, zero), _mm_cmplt_ps(sample_x, width)),
+				_mm_and_ps(_mm_cmpge_ps(sample_y, zero), _mm_cmplt_ps(sample_y, height)));
+			int in = _mm_movemask_ps(inside);
+			_mm_store_si128((__m128i *)px, _mm_cvttps_epi32(sample_x));
+			_mm_store_si128((__m128i *)py, _mm_cvttps_epi32(sample_y));
+			for (int k = 0; k < 4; ++k) { // the only part that isn't vectorized: fetching from the field
+				clearance[k] = ((in & (1 << k)) ? mClearance[(size_t)py[k] * miWidth + px[k]] : 0);
+			}
+			__m128 c = _mm_cvtepi32_ps(_mm_load_si128((const __m128i *)clearance));
+
+			__m128 wall = _mm_and_ps(active, _mm_cmpeq_ps(c, zero));
+			result = _mm_or_ps(_mm_and_ps(wall, t), _mm_andnot_ps(wall, result));
+			active = _mm_andnot_ps(wall, active);
+			active = _mm_and_ps(active, _mm_cmplt_ps(t, range)); // clear up to the range
+			__m128 step = _mm_max_ps(_mm_sub_ps(c, one), min_step);
+			t = _mm_min_ps(_mm_add_ps(t, _mm_and_ps(active, step)), range);
+		}
+		_mm_store_ps(hit, result);
+		for (int k = 0; k < 4 && r + k < miRays; ++k) {
+			distances[r + k] = hit[k];
+		}
+	}
+}
+
+#else // no SSE2: one ray at a time
+
+void Lidar::scanCar(float x, float y, float yaw, float * distances) const {
+	float heading_cos = -cos(yaw);
+	float heading_sin = -sin(yaw);
+	for (int r = 0; r < miRays; ++r) {
+		float dx = heading_cos * mRayCos[r] - heading_sin * mRaySin[r];
+		float dy = heading_sin * mRayCos[r] + heading_cos * mRaySin[r];
+		float t = 0;
+		distances[r] = mfRange;
+		while (true) {
+			int c = clearanceAt(x + dx * t, y + dy * t);
+			if (0 == c) {
+				distances[r] = t;
+				break;
+			}
+			if (t >= mfRange) {
+				break;
+			}
+			t = std::min(t + std::max((float)(c - 1), MIN_STEP), mfRange);
+		}
+	}
+}
+
+#endif
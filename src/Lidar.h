@@ -0,0 +1,71 @@
+#ifndef LIDAR_H_25B5DD80_99D6_11E4_AC20_10FEED04CD1C
+#define LIDAR_H_25B5DD80_99D6_11E4_AC20_10FEED04CD1C
+
+#include "TileMap.h"
+#include "Threads.h"
+
+#include <vector>
+
+// A fan of rays around every car that measure the distance to the walls, by
+// sphere tracing a distance field of the track (see TileMap::traceSegment()).
+// The rays of a car are traced 4 at a time with SSE, and the cars are split
+// between the threads of a pool.
+//
+// It keeps its own copy of the field, one byte per pixel, with the clearance
+// around the whole pixel in pixels instead of quarters of pixel around its centre,
+// so that long rays take longer steps and the lookups touch less memory.
+class Lidar {
+public:
+	static const int DEFAULT_RAYS = 32;
+	static const float DEFAULT_RANGE = 256;
+	static const float FULL_TURN = 6.283185307;
+
+	// the rays are spread evenly over field_of_view radians, centred on the heading
+	// of the car; over a whole turn the first one points right behind it
+	Lidar(int rays = DEFAULT_RAYS, float range = DEFAULT_RANGE, float field_of_view = FULL_TURN);
+
+	void setRays(int rays, float range, float field_of_view = FULL_TURN);
+	int getRays() const {
+		return miRays;
+	}
+	float getRange() const {
+		return mfRange;
+	}
+
+	// build the field from the walls of the map (green = 0 in the function layer);
+	// it reads every pixel, so it is meant for resident maps
+	void setMap(TileMap & map);
+	void clearMap();
+	bool hasMap() const {
+		return !mClearance.empty();
+	}
+
+	// distance in pixels to the first wall along every ray, or the range if there is
+	// none, in distances[car * rays + ray]; the rays turn the same way as the yaw
+	void scan(const float * x, const float * y, const float * yaw, int count,
+		float * distances, ThreadPool * pool = NULL) const;
+
+private:
+	int miRays;
+	float mfRange;
+	std::vector<float> mRayCos; // angle of every ray relative to the heading, padded to a multiple of 4
+	std::vector<float> mRaySin;
+
+	int miWidth;
+	int miHeight;
+	std::vector<uint8_t> mClearance; // 0 for the walls, 1 + whole pixels of clearance elsewhere
+
+	uint8_t clearanceAt(float x, float y) const {
+		if (x < 0 || y < 0 || x >= miWidth || y >= miHeight) { // outside of the map is a wall
+			return 0;
+		}
+		return mClearance[(size_t)y * miWidth + (int)x];
+	}
+
+	class Scanner;
+	friend class Scanner;
+
+	void scanCar(float x, float y, float yaw, float * distances) const;
+};
+
+#endif // LIDAR_H_25B5DD80_99D6_11E4_AC20_10FEED04CD1C
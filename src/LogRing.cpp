@@ -0,0 +1,84 @@
+#include "LogRing.h"
+
+#include <cstring>
+#include <time.h>
+
+LogRing::LogRing() :
+	miHead(0),
+	miTail(0),
+	miDropped(0),
+	miWindow(0),
+	miWindowCount(0),
+	miNotified(0),
+	mxNotify(NULL),
+	mxNotifyData(NULL)
+{
+	for (int i = 0; i < CAPACITY; ++i) {
+		maSlots[i].sequence = i;
+	}
+}
+
+LogRing & LogRing::getDefault() {
+	static LogRing ring;
+	return ring;
+}
+
+void LogRing::setNotify(NotifyFunction notify, void * data) {
+	mxNotifyData = data;
+	__atomic_store_n(&mxNotify, notify, __ATOMIC_RELEASE);
+}
+
+bool LogRing::push(LogType type, const char * text) {
+	// the window is reset by whoever sees the new second first; the count of a
+	// message that raced with it is lost, which only lets it through
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	uint32_t second = ts.tv_sec;
+	if (__atomic_load_n(&miWindow, __ATOMIC_RELAXED) != second) {
+		__atomic_store_n(&miWindow, second, __ATOMIC_RELAXED);
+		__atomic_store_n(&miWindowCount, 0, __ATOMIC_RELAXED);
+	}
+	if (__atomic_add_fetch(&miWindowCount, 1, __ATOMIC_RELAXED) > (uint32_t)MAX_RECORDS_PER_SECOND) {
+		__atomic_add_fetch(&miDropped, 1, __ATOMIC_RELAXED);
+		return false;
+	}
+
+	uint32_t position = __atomic_load_n(&miHead, __ATOMIC_RELAXED);
+	Slot * slot;
+	while (true) {
+		slot = &maSlots[position & (CAPACITY - 1)];
+		int32_t ahead = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - position;
+		if (0 == ahead) {
+			if (__atomic_compare_exchange_n(&miHead, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (ahead < 0) { // not read yet: full
+			__atomic_add_fetch(&miDropped, 1, __ATOMIC_RELAXED);
+			return false;
+		} else {
+			position = __atomic_load_n(&miHead, __ATOMIC_RELAXED);
+		}
+	}
+	slot->type = type;
+	strncpy(slot->text, text, TEXT_LENGTH - 1);
+	slot->text[TEXT_LENGTH - 1] = '\0';
+	__atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+
+	NotifyFunction notify = __atomic_load_n(&mxNotify, __ATOMIC_ACQUIRE);
+	if (NULL != notify && 0 == __atomic_exchange_n(&miNotified, 1, __ATOMIC_ACQ_REL)) {
+		notify(mxNotifyData);
+	}
+	return true;
+}
+
+bool LogRing::pop(LogType & type, char * text) {
+	Slot & slot = maSlots[miTail & (CAPACITY - 1)];
+	if ((int32_t)(__atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE) - (miTail + 1)) < 0) {
+		return false;
+	}
+	type = slot.type;
+	memcpy(text, slot.text, TEXT_LENGTH);
+	__atomic_store_n(&slot.sequence, miTail + CAPACITY, __ATOMIC_RELEASE);
+	++miTail;
+	return true;
+}
@@ -0,0 +1,61 @@
+#ifndef LOGRING_H_3065FE6D_448F_11E4_F5C3_10FEED04CD1C
+#define LOGRING_H_3065FE6D_448F_11E4_F5C3_10FEED04CD1C
+
+#include "Common.h"
+
+#include <stdint.h>
+
+// The log messages of every thread, on their way to the log window. Writing one
+// never blocks: a thread takes a slot of the ring with a compare and swap, and the
+// message is dropped if the ring is full or if there were already too many of them
+// in the last second, which is counted. There is only one reader, that drains the
+// ring in batches; the first message after it drained it calls the notify function,
+// so that it can schedule the next batch.
+class LogRing {
+public:
+	static const int CAPACITY = 1024;  // power of 2
+	static const int TEXT_LENGTH = 256;
+	static const int MAX_RECORDS_PER_SECOND = 250;
+
+	typedef void (*NotifyFunction)(void * data);
+
+	LogRing();
+
+	static LogRing & getDefault();
+
+	void setNotify(NotifyFunction notify, void * data);
+
+	bool push(LogType type, const char * text); // false if it was dropped
+
+	// reader only: the oldest message, false if there is none. Call rearm() before
+	// draining, so that a message written meanwhile notifies again.
+	bool pop(LogType & type, char * text);
+	void rearm() {
+		__atomic_store_n(&miNotified, 0, __ATOMIC_RELEASE);
+	}
+	unsigned int takeDropped() { // since the last call
+		return __atomic_exchange_n(&miDropped, 0, __ATOMIC_ACQ_REL);
+	}
+
+private:
+	struct Slot {
+		uint32_t sequence; // position + 1 when the message is there, position + CAPACITY when it was read
+		LogType type;
+		char text[TEXT_LENGTH];
+	};
+
+	Slot maSlots[CAPACITY];
+	uint32_t miHead;        // next position to write
+	uint32_t miTail;        // next position to read
+	uint32_t miDropped;
+	uint32_t miWindow;      // second of the rate limit
+	uint32_t miWindowCount; // messages in it
+	int miNotified;
+	NotifyFunction mxNotify;
+	void * mxNotifyData;
+
+	LogRing(const LogRing &);
+	LogRing & operator=(const LogRing &);
+};
+
+#endif // LOGRING_H_3065FE6D_448F_11E4_F5C3_10FEED04CD1C
@@ -2,11 +2,14 @@
 #include "ISdl2App.h"
 #include "InfoHandler.h"
 #include "Common.h"
+#include "LogRing.h"
+#include "Profiler.h"
 
 #include <gamepad/Gamepad.h>
 
 #include <cstdio>
 #include <cstdarg>
+#include <cstring>
 
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
@@ -15,6 +18,7 @@
 #include "SDL2/SDL_events.h"
 
 #define FPS 60
+#define INFO_HZ 10 // updates of the info panel per second
 
 #define UI_FILE "data/app.ui"
 
@@ -23,6 +27,8 @@
 #define ID_LOG_WIDGET   "log"
 
 #define LOG_MAXLENGTH     256
+#define LOG_MAX_LINES     500 // kept in the log window
+#define LOG_BATCH         64  // messages added to it at a time
 
 G_BEGIN_DECLS
 
@@ -99,8 +105,12 @@ struct MainAppPrivateData {
 };
 
 gboolean MainApp::draw(gpointer user_data) {
+	PROFILE_SCOPE("MainApp::draw");
 	MainAppPrivateData *priv = MAIN_APP_GET_PRIVATE(G_APPLICATION (user_data));
-	Gamepad_processEvents();
+	{
+		PROFILE_SCOPE("Gamepad_processEvents");
+		Gamepad_processEvents();
+	}
 	priv->sdl_app->processEvents();
 	priv->sdl_app->update();
 	priv->sdl_app->draw();
@@ -108,37 +118,96 @@ gboolean MainApp::draw(gpointer user_data) {
 	return TRUE;
 }
 
-static void appendTextToWidget(LogType type, GtkWidget * widget, gchar * text, bool new_line = true) {
-	GtkTextBuffer *buffer;
-	GtkTextMark *mark;
-	GtkTextIter iter;
-
-	/* Returns the GtkTextBuffer being displayed by this text view. */
-	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(widget));
-
-	/* Returns the mark that represents the cursor (insertion point). */
-	mark = gtk_text_buffer_get_insert(buffer);
+GtkWidget * global_log_widget = NULL;
 
-	/* Initializes iter with the current position of mark. */
-	gtk_text_buffer_get_iter_at_mark(buffer, &iter, mark);
+// https://developer.gnome.org/gtk3/stable/GtkTextView.html
 
-	/* Inserts buffer at position iter. */
-	gtk_text_buffer_insert(buffer, &iter, text, -1);
+// Note: see http://zetcode.com/tutorials/gtktutorial/gtktextview/
 
-	if (new_line) {
-		gtk_text_buffer_insert(buffer, &iter, "\n", -1);
+// the last line of the log, to count its repetitions instead of adding it again
+static GtkTextMark * log_last_line = NULL;
+static char log_last_text[LogRing::TEXT_LENGTH] = "";
+static LogType log_last_type = LOG_INFO;
+static unsigned int log_repeats = 0;
+
+static void appendLog(LogType type, const char * text) {
+	if (log_repeats > 0 && type == log_last_type && 0 == strcmp(text, log_last_text)) {
+		++log_repeats;
+		if (NULL != global_log_widget && NULL != log_last_line) { // written again, with the count
+			GtkTextBuffer * buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(global_log_widget));
+			GtkTextIter start;
+			GtkTextIter end;
+			gtk_text_buffer_get_iter_at_mark(buffer, &start, log_last_line);
+			gtk_text_buffer_get_end_iter(buffer, &end);
+			gtk_text_buffer_delete(buffer, &start, &end);
+			char line[LogRing::TEXT_LENGTH + 16];
+			snprintf(line, sizeof(line), "%s \xc3\x97%u\n", text, log_repeats);
+			gtk_text_buffer_get_end_iter(buffer, &end);
+			gtk_text_buffer_insert(buffer, &end, line, -1);
+		}
+		return;
 	}
 
-	/* Scrolls text_view the minimum distance such that mark is contained within the visible area of the widget. */
-	gtk_text_view_scroll_mark_onscreen(GTK_TEXT_VIEW(widget), mark);  
+	if (log_repeats > 1) {
+		printf("Last message repeated %u times\n", log_repeats);
+	}
+	puts(text);
+	strcpy(log_last_text, text);
+	log_last_type = type;
+	log_repeats = 1;
+
+	if (NULL != global_log_widget) {
+		GtkTextBuffer * buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(global_log_widget));
+		GtkTextIter end;
+		gtk_text_buffer_get_end_iter(buffer, &end);
+		if (NULL == log_last_line) {
+			log_last_line = gtk_text_buffer_create_mark(buffer, NULL, &end, TRUE);
+		} else {
+			gtk_text_buffer_move_mark(buffer, log_last_line, &end);
+		}
+		gtk_text_buffer_insert(buffer, &end, text, -1);
+		gtk_text_buffer_insert(buffer, &end, "\n", -1);
+	}
 }
 
-GtkWidget * global_log_widget = NULL;
+// the messages of the log ring, in batches, when GTK has nothing else to do
+static gboolean drainLog(gpointer user_data) {
+	LogRing & ring = LogRing::getDefault();
+	ring.rearm();
+
+	LogType type;
+	char text[LogRing::TEXT_LENGTH];
+	int count = 0;
+	while (count < LOG_BATCH && ring.pop(type, text)) {
+		appendLog(type, text);
+		++count;
+	}
+	unsigned int dropped = ring.takeDropped();
+	if (dropped > 0) {
+		snprintf(text, sizeof(text), "(%u log messages dropped)", dropped);
+		appendLog(LOG_WARNING, text);
+	}
 
-// https://developer.gnome.org/gtk3/stable/GtkTextView.html
+	if (NULL != global_log_widget && NULL != log_last_line && count > 0) {
+		GtkTextBuffer * buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(global_log_widget));
+		int lines = gtk_text_buffer_get_line_count(buffer) - 1; // after the last new line
+		if (lines > LOG_MAX_LINES) {
+			GtkTextIter start;
+			GtkTextIter end;
+			gtk_text_buffer_get_start_iter(buffer, &start);
+			gtk_text_buffer_get_iter_at_line(buffer, &end, lines - LOG_MAX_LINES);
+			gtk_text_buffer_delete(buffer, &start, &end);
+		}
+		gtk_text_view_scroll_mark_onscreen(GTK_TEXT_VIEW(global_log_widget), log_last_line);
+	}
+	return (LOG_BATCH == count ? TRUE : FALSE); // again if there are more
+}
 
-// Note: see http://zetcode.com/tutorials/gtktutorial/gtktextview/
+static void notifyLog(void * data) {
+	g_idle_add(drainLog, data); // from any thread
+}
 
+// only queued, so that logging never waits for GTK
 void printLog(LogType type, const char* fmt, ...) {
 	char buff[LOG_MAXLENGTH];
 	va_list args;
@@ -147,8 +216,7 @@ void printLog(LogType type, const char* fmt, ...) {
 	va_end(args);
 	buff[sizeof(buff) - 1] = '\0';
 
-	puts(buff);
-	appendTextToWidget(type, global_log_widget, buff);
+	LogRing::getDefault().push(type, buff);
 }
 
 // https://git.gnome.org/browse/gtk+/plain/gdk/gdkkeysyms.h
@@ -421,8 +489,25 @@ gboolean Sdl2Area::eventScroll(GtkWidget *widget, GdkEventScroll *scroll, gpoint
 	event.type = SDL_MOUSEWHEEL;
 	event.which = 0;
 	event.windowID = 0;
-	event.x = scroll->x;
-	event.y = scroll->y;
+	switch (scroll->direction) { // SDL wants the amount scrolled, not the position of the pointer
+		case GDK_SCROLL_UP:
+			event.y = 1;
+			break;
+		case GDK_SCROLL_DOWN:
+			event.y = -1;
+			break;
+		case GDK_SCROLL_LEFT:
+			event.x = -1;
+			break;
+		case GDK_SCROLL_RIGHT:
+			event.x = 1;
+			break;
+		case GDK_SCROLL_SMOOTH:
+		default:
+			event.x = (scroll->delta_x > 0 ? 1 : (scroll->delta_x < 0 ? -1 : 0));
+			event.y = (scroll->delta_y > 0 ? -1 : (scroll->delta_y < 0 ? 1 : 0));
+			break;
+	}
 	event.timestamp = SDL_GetTicks();
 	SDL_PushEvent((SDL_Event*)&event);
 	return TRUE;
@@ -558,6 +643,9 @@ void MainApp::setup(GApplication * app) {
 	);
 
 	priv->idle_handler = g_timeout_add(1000/FPS, MainApp::draw, (gpointer)app);
+
+	LogRing::getDefault().setNotify(notifyLog, NULL);
+	g_idle_add(drainLog, NULL); // what was logged until now
 }
 
 void MainApp::cleanup(GtkApplication * app) {
@@ -571,6 +659,15 @@ void MainApp::cleanup(GtkApplication * app) {
 	priv->sdl_app->destroy();
 
 	Gamepad::shutdownGamepad();
+
+	// the rest of the log only goes to the console
+	LogRing::getDefault().setNotify(NULL, NULL);
+	global_log_widget = NULL;
+	while (drainLog(NULL)) {
+	}
+	if (log_repeats > 1) {
+		printf("Last message repeated %u times\n", log_repeats);
+	}
 }
 
 void MainApp::createFromFile(GApplication * app, GFile * file) {
@@ -642,6 +739,7 @@ void MainApp::createFromFile(GApplication * app, GFile * file) {
 	// http://www.linuxtopia.org/online_books/gui_toolkit_guides/gtk+_gnome_application_development/sec-gdkevent_1.html
 
 	priv->info_handler = new InfoHandler(priv->sdl_app, window, builder);
+	priv->info_handler->setUpdateRate(INFO_HZ);
 
 	gtk_widget_add_events(sdl_widget, GDK_ALL_EVENTS_MASK);
 	gtk_widget_set_can_focus(sdl_widget, true);
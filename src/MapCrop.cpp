@@ -0,0 +1,207 @@
+#include "MapCrop.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// from the bytes of a pixel to the values of the planes: value = byte * scale + offset
+static const float PLANE_SCALE[MapCrop::NB_PLANES] = {
+	1.0 / 8,
+	1.0 / 255,
+	1.0 / 255,
+	1.0 / TileMap::DISTANCE_STEPS
+};
+static const float PLANE_OFFSET[MapCrop::NB_PLANES] = {
+	0,
+	0,
+	0,
+	-(float)TileMap::DISTANCE_ZERO / TileMap::DISTANCE_STEPS
+};
+
+MapCrop::MapCrop(int size, float scale) :
+	miWidth(0),
+	miHeight(0),
+	miStride(0)
+{
+	setSize(size, scale);
+}
+
+void MapCrop::setSize(int size, float scale) {
+	miSize = (size > 0 ? (size + 3) & ~3 : 4);
+	mfScale = scale;
+}
+
+void MapCrop::setMap(TileMap & map) {
+	miWidth = map.getWidth();
+	miHeight = map.getHeight();
+	miStride = miWidth + 3;
+	mPixels.assign((size_t)miStride * (miHeight + 3) * TileMap::BYTES_PER_PIXEL, 0);
+	for (int y = 0; y < miHeight; ++y) {
+		uint8_t * row = &mPixels[((size_t)(y + 1) * miStride + 1) * TileMap::BYTES_PER_PIXEL];
+		for (int x = 0; x < miWidth; ++x) {
+			memcpy(row + x * TileMap::BYTES_PER_PIXEL, map.functionAt(x, y), TileMap::BYTES_PER_PIXEL);
+		}
+	}
+}
+
+void MapCrop::clearMap() {
+	miWidth = 0;
+	miHeight = 0;
+	miStride = 0;
+	mPixels.clear();
+}
+
+class MapCrop::Cropper : public ParallelTask {
+public:
+	Cropper(const MapCrop & map_crop, const float * x, const float * y, const float * yaw, float * crops) :
+		mxMapCrop(map_crop), mxX(x), mxY(y), mxYaw(yaw), mxCrops(crops)
+	{
+	}
+
+	virtual void run(int begin, int end) {
+		size_t values = mxMapCrop.getValues();
+		for (int i = begin; i < end; ++i) {
+			mxMapCrop.cropCar(mxX[i], mxY[i], mxYaw[i], mxCrops + i * values);
+		}
+	}
+
+private:
+	const MapCrop & mxMapCrop;
+	const float * mxX;
+	const float * mxY;
+	const float * mxYaw;
+	float * mxCrops;
+};
+
+void MapCrop::crop(const float * x, const float * y, const float * yaw, int count,
+	float * crops, ThreadPool * pool) const
+{
+	Cropper cropper(*this, x, y, yaw, crops);
+	if (NULL != pool) {
+		pool->parallelFor(count, cropper, 4);
+	} else {
+		cropper.run(0, count);
+	}
+}
+
+#ifdef __SSE2__
+
+// the 4 bytes of a pixel as 4 floats
+static inline __m128 loadPixel(const uint8_t * pixel) {
+	int32_t rgba;
+	memcpy(&rgba, pixel, sizeof(rgba));
+	__m128i zero = _mm_setzero_si128();
+	__m128i bytes = _mm_cvtsi32_si128(rgba);
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+}
+
+void MapCrop::cropCar(float x, float y, float yaw, float * crop) const {
+	int32_t column[4] __attribute__((aligned(16)));
+	int32_t row[4] __attribute__((aligned(16)));
+	float fraction_x[4] __attribute__((aligned(16)));
+	float fraction_y[4] __attribute__((aligned(16)));
+
+	// the car heads to -(cos, sin) of its yaw; its right is that turned a quarter clockwise
+	float forward_x = -cos(yaw);
+	float forward_y = -sin(yaw);
+	float right_x = -forward_y;
+	float right_y = forward_x;
+	float half = miSize / 2 - 0.5;
+	size_t plane_size = (size_t)miSize * miSize;
+	int pixel_stride = miStride * TileMap::BYTES_PER_PIXEL;
+
+	__m128 lane = _mm_set_ps(3, 2, 1, 0);
+	__m128 step_x = _mm_set1_ps(right_x * mfScale);
+	__m128 step_y = _mm_set1_ps(right_y * mfScale);
+	__m128 zero = _mm_setzero_ps();
+	__m128 max_x = _mm_set1_ps(miWidth + 1); // in the copy, the border after the last pixel
+	__m128 max_y = _mm_set1_ps(miHeight + 1);
+	__m128 plane_scale = _mm_loadu_ps(PLANE_SCALE);
+	__m128 plane_offset = _mm_loadu_ps(PLANE_OFFSET);
+
+	for (int r = 0; r < miSize; ++r) {
+		// centre of the first cell of the row, moved by half a pixel to sample between
+		// the centres of the pixels, and by one more for the border of the copy
+		float ahead = (half - r) * mfScale;
+		float side = -half * mfScale;
+		float start_x = x + forward_x * ahead + right_x * side + 0.5;
+		float start_y = y + forward_y * ahead + right_y * side + 0.5;
+		float * out = crop + r * miSize;
+
+		for (int c = 0; c < miSize; c += 4) {
+			__m128 cell = _mm_add_ps(_mm_set1_ps(c), lane);
+			__m128 sample_x = _mm_add_ps(_mm_set1_ps(start_x), _mm_mul_ps(cell, step_x));
+			__m128 sample_y = _mm_add_ps(_mm_set1_ps(start_y), _mm_mul_ps(cell, step_y));
+			// far outside of the map is like its border: a wall
+			sample_x = _mm_min_ps(_mm_max_ps(sample_x, zero), max_x);
+			sample_y = _mm_min_ps(_mm_max_ps(sample_y, zero), max_y);
+			__m128i pixel_x = _mm_cvttps_epi32(sample_x); // truncating is flooring, as they are >= 0
+			__m128i pixel_y = _mm_cvttps_epi32(sample_y);
+			_mm_store_si128((__m128i *)column, pixel_x);
+			_mm_store_si128((__m128i *)row, pixel_y);
+			_mm_store_ps(fraction_x, _mm_sub_ps(sample_x, _mm_cvtepi32_ps(pixel_x)));
+			_mm_store_ps(fraction_y, _mm_sub_ps(sample_y, _mm_cvtepi32_ps(pixel_y)));
+
+			__m128 value[4];
+			for (int k = 0; k < 4; ++k) { // all the planes of a cell at once
+				const uint8_t * top = &mPixels[((size_t)row[k] * miStride + column[k]) * TileMap::BYTES_PER_PIXEL];
+				const uint8_t * bottom = top + pixel_stride;
+				__m128 wx = _mm_set1_ps(fraction_x[k]);
+				__m128 wy = _mm_set1_ps(fraction_y[k]);
+				__m128 top_left = loadPixel(top);
+				__m128 bottom_left = loadPixel(bottom);
+				__m128 top_value = _mm_add_ps(top_left, _mm_mul_ps(_mm_sub_ps(loadPixel(top + TileMap::BYTES_PER_PIXEL), top_left), wx));
+				__m128 bottom_value = _mm_add_ps(bottom_left, _mm_mul_ps(_mm_sub_ps(loadPixel(bottom + TileMap::BYTES_PER_PIXEL), bottom_left), wx));
+				__m128 v = _mm_add_ps(top_value, _mm_mul_ps(_mm_sub_ps(bottom_value, top_value), wy));
+				value[k] = _mm_add_ps(_mm_mul_ps(v, plane_scale), plane_offset);
+			}
+			// from the planes of every cell to the cells of every plane
+			_MM_TRANSPOSE4_PS(value[0], value[1], value[2], value[3]);
+			for (int p = 0; p < NB_PLANES; ++p) {
+				_mm_storeu_ps(out + p * plane_size + c, value[p]);
+			}
+		}
+	}
+}
+
+#else // no SSE2: one plane of one cell at a time
+
+void MapCrop::cropCar(float x, float y, float yaw, float * crop) const {
+	float forward_x = -cos(yaw);
+	float forward_y = -sin(yaw);
+	float right_x = -forward_y;
+	float right_y = forward_x;
+	float half = miSize / 2 - 0.5;
+	size_t plane_size = (size_t)miSize * miSize;
+	int pixel_stride = miStride * TileMap::BYTES_PER_PIXEL;
+
+	for (int r = 0; r < miSize; ++r) {
+		float ahead = (half - r) * mfScale;
+		for (int c = 0; c < miSize; ++c) {
+			float side = (c - half) * mfScale;
+			float sample_x = x + forward_x * ahead + right_x * side + 0.5;
+			float sample_y = y + forward_y * ahead + right_y * side + 0.5;
+			sample_x = std::min(std::max(sample_x, 0.0f), (float)miWidth + 1);
+			sample_y = std::min(std::max(sample_y, 0.0f), (float)miHeight + 1);
+			int column = sample_x;
+			int row = sample_y;
+			float wx = sample_x - column;
+			float wy = sample_y - row;
+			const uint8_t * top = &mPixels[((size_t)row * miStride + column) * TileMap::BYTES_PER_PIXEL];
+			const uint8_t * bottom = top + pixel_stride;
+			for (int p = 0; p < NB_PLANES; ++p) {
+				int right = p + TileMap::BYTES_PER_PIXEL;
+				float top_value = top[p] + (top[right] - top[p]) * wx;
+				float bottom_value = bottom[p] + (bottom[right] - bottom[p]) * wx;
+				float v = top_value + (bottom_value - top_value) * wy;
+				crop[p * plane_size + r * miSize + c] = v * PLANE_SCALE[p] + PLANE_OFFSET[p];
+			}
+		}
+	}
+}
+
+#endif
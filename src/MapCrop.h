@@ -0,0 +1,75 @@
+#ifndef MAPCROP_H_3B395430_4EEF_11E4_5193_10FEED04CD1C
+#define MAPCROP_H_3B395430_4EEF_11E4_5193_10FEED04CD1C
+
+#include "TileMap.h"
+#include "Threads.h"
+
+#include <vector>
+
+// Square pictures of the function map around every car, turned so that the car
+// heads to the top of them, for the policies that drive from what they see.
+//
+// Each cell is a bilinear sample of the function layer, with the 4 channels of a
+// pixel interpolated at once in an SSE register; the cells are done 4 at a time
+// and the crops of the cars are split between the threads of a pool.
+//
+// It keeps its own copy of the function layer with a border of walls around it,
+// so that the samples never have to check whether they are outside of the map.
+class MapCrop {
+public:
+	enum Plane {
+		PLANE_CHECKPOINT, // number of the checkpoint (red / 8)
+		PLANE_GRIP,       // road quality, 0 for the walls to 1 (green / 255)
+		PLANE_HEIGHT,     // map height, 0 to 1 (blue / 255)
+		PLANE_DISTANCE,   // distance to the walls in pixels, negative inside of them (alpha)
+		NB_PLANES
+	};
+
+	static const int DEFAULT_SIZE = 64;
+	static const float DEFAULT_SCALE = 2;
+
+	// size x size cells, scale pixels of the map apart; the size is rounded up to a
+	// multiple of 4
+	MapCrop(int size = DEFAULT_SIZE, float scale = DEFAULT_SCALE);
+
+	void setSize(int size, float scale);
+	int getSize() const {
+		return miSize;
+	}
+	float getScale() const {
+		return mfScale;
+	}
+	size_t getValues() const { // floats in the crop of a car
+		return (size_t)NB_PLANES * miSize * miSize;
+	}
+
+	// copy the function layer of the map; it reads every pixel, so it is meant for
+	// resident maps
+	void setMap(TileMap & map);
+	void clearMap();
+	bool hasMap() const {
+		return !mPixels.empty();
+	}
+
+	// the crop of every car in crops[car * getValues()], as crops[car][plane][row][column]:
+	// row 0 is ahead of the car, column 0 on its left, and the car is in the middle
+	void crop(const float * x, const float * y, const float * yaw, int count,
+		float * crops, ThreadPool * pool = NULL) const;
+
+private:
+	int miSize;
+	float mfScale;
+
+	int miWidth;  // of the map, without the border
+	int miHeight;
+	int miStride; // pixels in a row of the copy
+	std::vector<uint8_t> mPixels; // RGBA, with a border of 0 (a wall) around the map: one pixel
+	                              // before it and two after it, for the samples on the last one
+
+	class Cropper;
+	friend class Cropper;
+
+	void cropCar(float x, float y, float yaw, float * crop) const;
+};
+
+#endif // MAPCROP_H_3B395430_4EEF_11E4_5193_10FEED04CD1C
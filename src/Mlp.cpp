@@ -0,0 +1,264 @@
+#include "Mlp.h"
+#include "Common.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MLP_HAS_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+const char Mlp::MAGIC[8] = { 'C', 'A', 'R', 'M', 'L', 'P', '0', '1' };
+
+Mlp::Mlp() :
+	miWidth(0),
+	miCapacity(0),
+	mbAvx2(false)
+{
+}
+
+bool Mlp::load(const char * filename) {
+	clear();
+
+	FILE * f = fopen(filename, "rb");
+	if (NULL == f) {
+		return false;
+	}
+
+	MlpFileHeader header;
+	if (
+		fread(&header, sizeof(header), 1, f) != 1 ||
+		memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+		0 == header.layers || header.layers > MAX_LAYERS
+	) {
+		printErrorLog("Invalid network file %s", filename);
+		fclose(f);
+		return false;
+	}
+
+	std::vector<float> weights;
+	mLayers.resize(header.layers);
+	for (uint32_t l = 0; l < header.layers; ++l) {
+		MlpLayerHeader layer_header;
+		if (
+			fread(&layer_header, sizeof(layer_header), 1, f) != 1 ||
+			0 == layer_header.inputs || layer_header.inputs > MAX_WIDTH ||
+			0 == layer_header.outputs || layer_header.outputs > MAX_WIDTH ||
+			layer_header.activation >= NB_ACTIVATIONS ||
+			(l > 0 && layer_header.inputs != (uint32_t)mLayers[l - 1].outputs)
+		) {
+			printErrorLog("Invalid layer %u in network file %s", l, filename);
+			fclose(f);
+			clear();
+			return false;
+		}
+
+		Layer & layer = mLayers[l];
+		layer.inputs = layer_header.inputs;
+		layer.outputs = layer_header.outputs;
+		layer.padded = (layer.outputs + LANES - 1) / LANES * LANES;
+		layer.activation = layer_header.activation;
+		layer.weights.assign((size_t)layer.inputs * layer.padded, 0);
+		layer.bias.assign(layer.padded, 0);
+		weights.resize((size_t)layer.outputs * layer.inputs);
+		if (
+			fread(&weights[0], sizeof(float), weights.size(), f) != weights.size() ||
+			fread(&layer.bias[0], sizeof(float), layer.outputs, f) != (size_t)layer.outputs
+		) {
+			printErrorLog("Truncated network file %s", filename);
+			fclose(f);
+			clear();
+			return false;
+		}
+		for (int o = 0; o < layer.outputs; ++o) {
+			for (int i = 0; i < layer.inputs; ++i) {
+				layer.weights[(size_t)i * layer.padded + o] = weights[(size_t)o * layer.inputs + i];
+			}
+		}
+		miWidth = std::max(miWidth, layer.padded);
+	}
+	fclose(f);
+
+#ifdef MLP_HAS_AVX2_KERNEL
+	mbAvx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	printInfoLog("Network %s: %d inputs, %d layers, %d outputs%s", filename,
+		getInputs(), (int)mLayers.size(), getOutputs(), (mbAvx2 ? " (AVX2)" : ""));
+	return true;
+}
+
+void Mlp::clear() {
+	mLayers.clear();
+	miWidth = 0;
+	miCapacity = 0;
+	mScratch.clear();
+	mbAvx2 = false;
+}
+
+void Mlp::reserve(int count) {
+	if (count > miCapacity) {
+		miCapacity = count;
+		mScratch.resize(2 * (size_t)miCapacity * miWidth);
+	}
+}
+
+// out[sample * out_stride + output] for the samples of in[sample * in_stride + input]
+static void denseScalar(const float * in, int in_stride, int count,
+	const float * weights, const float * bias, int inputs, int padded, int activation,
+	float * out, int out_stride)
+{
+	for (int s = 0; s < count; ++s) {
+		const float * x = in + (size_t)s * in_stride;
+		float * y = out + (size_t)s * out_stride;
+		for (int o = 0; o < padded; ++o) {
+			y[o] = bias[o];
+		}
+		for (int i = 0; i < inputs; ++i) {
+			const float * w = weights + (size_t)i * padded;
+			for (int o = 0; o < padded; ++o) {
+				y[o] += x[i] * w[o];
+			}
+		}
+		for (int o = 0; o < padded; ++o) {
+			if (Mlp::ACTIVATION_RELU == activation) {
+				y[o] = std::max(y[o], 0.0f);
+			} else if (Mlp::ACTIVATION_TANH == activation) {
+				y[o] = tanh(y[o]);
+			}
+		}
+	}
+}
+
+#ifdef MLP_HAS_AVX2_KERNEL
+
+// Pade approximant of tanh, within 2e-4 of it once x is clamped to where it is flat
+__attribute__((target("avx2,fma")))
+static inline __m256 tanh8(__m256 x) {
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-4.97)), _mm256_set1_ps(4.97));
+	__m256 x2 = _mm256_mul_ps(x, x);
+	__m256 p = _mm256_fmadd_ps(x2, _mm256_set1_ps(1), _mm256_set1_ps(378));
+	p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(17325));
+	p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(135135));
+	p = _mm256_mul_ps(p, x);
+	__m256 q = _mm256_fmadd_ps(x2, _mm256_set1_ps(28), _mm256_set1_ps(3150));
+	q = _mm256_fmadd_ps(q, x2, _mm256_set1_ps(62370));
+	q = _mm256_fmadd_ps(q, x2, _mm256_set1_ps(135135));
+	return _mm256_div_ps(p, q);
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 activate8(__m256 y, int activation) {
+	if (Mlp::ACTIVATION_RELU == activation) {
+		return _mm256_max_ps(y, _mm256_setzero_ps());
+	}
+	if (Mlp::ACTIVATION_TANH == activation) {
+		return tanh8(y);
+	}
+	return y;
+}
+
+// 8 outputs of 4 samples at a time, so that every load of the weights serves 4 FMAs
+__attribute__((target("avx2,fma")))
+static void denseAvx2(const float * in, int in_stride, int count,
+	const float * weights, const float * bias, int inputs, int padded, int activation,
+	float * out, int out_stride)
+{
+	for (int o = 0; o < padded; o += 8) {
+		__m256 b = _mm256_loadu_ps(bias + o);
+		int s = 0;
+		for (; s + 4 <= count; s += 4) {
+			const float * x0 = in + (size_t)s * in_stride;
+			const float * x1 = x0 + in_stride;
+			const float * x2 = x1 + in_stride;
+			const float * x3 = x2 + in_stride;
+			__m256 y0 = b, y1 = b, y2 = b, y3 = b;
+			for (int i = 0; i < inputs; ++i) {
+				__m256 w = _mm256_loadu_ps(weights + (size_t)i * padded + o);
+				y0 = _mm256_fmadd_ps(_mm256_broadcast_ss(x0 + i), w, y0);
+				y1 = _mm256_fmadd_ps(_mm256_broadcast_ss(x1 + i), w, y1);
+				y2 = _mm256_fmadd_ps(_mm256_broadcast_ss(x2 + i), w, y2);
+				y3 = _mm256_fmadd_ps(_mm256_broadcast_ss(x3 + i), w, y3);
+			}
+			float * y = out + (size_t)s * out_stride + o;
+			_mm256_storeu_ps(y, activate8(y0, activation));
+			_mm256_storeu_ps(y + out_stride, activate8(y1, activation));
+			_mm256_storeu_ps(y + 2 * out_stride, activate8(y2, activation));
+			_mm256_storeu_ps(y + 3 * out_stride, activate8(y3, activation));
+		}
+		for (; s < count; ++s) {
+			const float * x = in + (size_t)s * in_stride;
+			__m256 y = b;
+			for (int i = 0; i < inputs; ++i) {
+				y = _mm256_fmadd_ps(_mm256_broadcast_ss(x + i), _mm256_loadu_ps(weights + (size_t)i * padded + o), y);
+			}
+			_mm256_storeu_ps(out + (size_t)s * out_stride + o, activate8(y, activation));
+		}
+	}
+}
+
+#endif
+
+class Mlp::Runner : public ParallelTask {
+public:
+	Runner(Mlp & mlp, const float * inputs, float * outputs) :
+		mxMlp(mlp), mxInputs(inputs), mxOutputs(outputs)
+	{
+	}
+
+	virtual void run(int begin, int end) {
+		mxMlp.runRange(mxInputs, begin, end, mxOutputs);
+	}
+
+private:
+	Mlp & mxMlp;
+	const float * mxInputs;
+	float * mxOutputs;
+};
+
+void Mlp::run(const float * inputs, int count, float * outputs, ThreadPool * pool) {
+	if (mLayers.empty() || count <= 0) {
+		return;
+	}
+	reserve(count);
+	Runner runner(*this, inputs, outputs);
+	if (NULL != pool) {
+		pool->parallelFor(count, runner, 64);
+	} else {
+		runner.run(0, count);
+	}
+}
+
+void Mlp::runRange(const float * inputs, int begin, int end, float * outputs) {
+	int count = end - begin;
+	const float * in = inputs + (size_t)begin * getInputs();
+	int in_stride = getInputs();
+	float * scratch[2] = {
+		&mScratch[(size_t)begin * miWidth],
+		&mScratch[((size_t)miCapacity + begin) * miWidth]
+	};
+	for (size_t l = 0; l < mLayers.size(); ++l) {
+		const Layer & layer = mLayers[l];
+		float * out = scratch[l % 2];
+#ifdef MLP_HAS_AVX2_KERNEL
+		if (mbAvx2) {
+			denseAvx2(in, in_stride, count, &layer.weights[0], &layer.bias[0],
+				layer.inputs, layer.padded, layer.activation, out, miWidth);
+		} else
+#endif
+		{
+			denseScalar(in, in_stride, count, &layer.weights[0], &layer.bias[0],
+				layer.inputs, layer.padded, layer.activation, out, miWidth);
+		}
+		in = out;
+		in_stride = miWidth;
+	}
+
+	int outputs_per_sample = getOutputs();
+	for (int s = 0; s < count; ++s) {
+		memcpy(outputs + (size_t)(begin + s) * outputs_per_sample, in + (size_t)s * miWidth,
+			outputs_per_sample * sizeof(float));
+	}
+}
@@ -0,0 +1,93 @@
+#ifndef MLP_H_1D827CA8_ED00_11E4_58A5_10FEED04CD1C
+#define MLP_H_1D827CA8_ED00_11E4_58A5_10FEED04CD1C
+
+#include "Threads.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Inference of a small fully connected network (a multilayer perceptron) trained
+// offline, over a whole batch of inputs at once.
+//
+// The dense layers use AVX2 and FMA when the processor has them, checked when the
+// network is loaded, 8 outputs by 4 samples at a time; otherwise plain loops. The
+// weights are kept transposed and padded to 8 outputs, so that the outputs of an
+// input are contiguous. Once reserve() has been called for the largest batch,
+// run() doesn't allocate anything.
+//
+// File layout (little endian):
+//   MlpFileHeader ("CARMLP01")
+//   for every layer: MlpLayerHeader, float weight[outputs][inputs], float bias[outputs]
+class Mlp {
+public:
+	enum Activation {
+		ACTIVATION_LINEAR,
+		ACTIVATION_RELU,
+		ACTIVATION_TANH,
+		NB_ACTIVATIONS
+	};
+
+	static const int MAX_LAYERS = 16;
+	static const int MAX_WIDTH = 4096;
+
+	Mlp();
+
+	bool load(const char * filename);
+	void clear();
+	bool isLoaded() const {
+		return !mLayers.empty();
+	}
+	int getInputs() const {
+		return (mLayers.empty() ? 0 : mLayers.front().inputs);
+	}
+	int getOutputs() const {
+		return (mLayers.empty() ? 0 : mLayers.back().outputs);
+	}
+	bool usesAvx2() const {
+		return mbAvx2;
+	}
+
+	// room for batches of up to count samples
+	void reserve(int count);
+
+	// outputs[sample * getOutputs() + output] from inputs[sample * getInputs() + input];
+	// with a pool, the samples are split between its threads
+	void run(const float * inputs, int count, float * outputs, ThreadPool * pool = NULL);
+
+private:
+	static const char MAGIC[8];
+	static const int LANES = 8; // floats in an AVX register
+
+	struct MlpFileHeader {
+		char magic[8];
+		uint32_t layers;
+	};
+
+	struct MlpLayerHeader {
+		uint32_t inputs;
+		uint32_t outputs;
+		uint32_t activation;
+	};
+
+	struct Layer {
+		int inputs;
+		int outputs;
+		int padded; // outputs rounded up to LANES
+		int activation;
+		std::vector<float> weights; // weights[input * padded + output], 0 in the padding
+		std::vector<float> bias;    // padded too
+	};
+
+	std::vector<Layer> mLayers;
+	int miWidth;    // largest padded layer
+	int miCapacity; // samples that fit in the scratch
+	std::vector<float> mScratch; // two [sample][miWidth] buffers, for the outputs of every other layer
+	bool mbAvx2;
+
+	class Runner;
+	friend class Runner;
+
+	void runRange(const float * inputs, int begin, int end, float * outputs);
+};
+
+#endif // MLP_H_1D827CA8_ED00_11E4_58A5_10FEED04CD1C
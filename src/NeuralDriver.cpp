@@ -0,0 +1,53 @@
+#include "NeuralDriver.h"
+#include "Observation.h"
+#include "Common.h"
+
+#include <algorithm>
+
+NeuralDriver::NeuralDriver() {
+}
+
+bool NeuralDriver::load(const char * filename) {
+	if (!mMlp.load(filename)) {
+		return false;
+	}
+	if (CAR_ENV_OBSERVATION_SIZE != mMlp.getInputs() || CAR_ENV_ACTION_SIZE != mMlp.getOutputs()) {
+		printErrorLog("The network %s has %d inputs and %d outputs instead of %d and %d", filename,
+			mMlp.getInputs(), mMlp.getOutputs(), CAR_ENV_OBSERVATION_SIZE, CAR_ENV_ACTION_SIZE);
+		mMlp.clear();
+		return false;
+	}
+	return true;
+}
+
+void NeuralDriver::reset(const Simulation & simulation) {
+	int count = simulation.getNumberOfCars();
+	mObservations.resize((size_t)count * CAR_ENV_OBSERVATION_SIZE);
+	mActions.resize((size_t)count * CAR_ENV_ACTION_SIZE);
+	mMlp.reserve(count);
+}
+
+void NeuralDriver::drive(Simulation & simulation, const int * cars, int count, ThreadPool * pool) {
+	if (!mMlp.isLoaded() || count <= 0) {
+		return;
+	}
+	if (mObservations.size() < (size_t)count * CAR_ENV_OBSERVATION_SIZE) {
+		reset(simulation);
+	}
+
+	const float * lidar = simulation.scanLidar(pool);
+	int rays = simulation.getLidarRays();
+	for (int i = 0; i < count; ++i) {
+		observeCar(simulation, cars[i], (NULL == lidar ? NULL : lidar + (size_t)cars[i] * rays),
+			&mObservations[(size_t)i * CAR_ENV_OBSERVATION_SIZE]);
+	}
+
+	mMlp.run(&mObservations[0], count, &mActions[0], pool);
+
+	for (int i = 0; i < count; ++i) {
+		const float * action = &mActions[(size_t)i * CAR_ENV_ACTION_SIZE];
+		CarInput & input = simulation.getInput(cars[i]);
+		input.up_down = std::min(std::max(action[CAR_ENV_ACTION_UP_DOWN], -1.0f), 1.0f);
+		input.left_right = std::min(std::max(action[CAR_ENV_ACTION_LEFT_RIGHT], -1.0f), 1.0f);
+	}
+}
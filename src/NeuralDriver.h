@@ -0,0 +1,31 @@
+#ifndef NEURALDRIVER_H_7237067B_E906_11E4_B117_10FEED04CD1C
+#define NEURALDRIVER_H_7237067B_E906_11E4_B117_10FEED04CD1C
+
+#include "Controller.h"
+#include "Mlp.h"
+
+#include <vector>
+
+// Drives the cars with a policy trained in the environment of env/CarEnv.h: the
+// observations of all the cars go through the network as one batch, and its two
+// outputs are the axes of their joysticks.
+class NeuralDriver : public Controller {
+public:
+	NeuralDriver();
+
+	// a network with CAR_ENV_OBSERVATION_SIZE inputs and CAR_ENV_ACTION_SIZE outputs
+	bool load(const char * filename);
+	bool isLoaded() const {
+		return mMlp.isLoaded();
+	}
+
+	virtual void reset(const Simulation & simulation);
+	virtual void drive(Simulation & simulation, const int * cars, int count, ThreadPool * pool = NULL);
+
+private:
+	Mlp mMlp;
+	std::vector<float> mObservations; // of the cars being driven, one after the other
+	std::vector<float> mActions;
+};
+
+#endif // NEURALDRIVER_H_7237067B_E906_11E4_B117_10FEED04CD1C
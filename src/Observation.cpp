@@ -0,0 +1,21 @@
+#include "Observation.h"
+
+void observeCar(const Simulation & simulation, int car, const float * lidar, float * o) {
+	const Car & state = simulation.getCar(car);
+	o[CAR_ENV_OBS_POSITION_X] = state.getPosX() * Simulation::XY_UNIT_TO_M;
+	o[CAR_ENV_OBS_POSITION_Y] = state.getPosY() * Simulation::XY_UNIT_TO_M;
+	o[CAR_ENV_OBS_POSITION_Z] = state.getPosZ() * Simulation::Z_UNIT_TO_M;
+	o[CAR_ENV_OBS_SPEED_X] = state.getSpeedX() * Simulation::XY_UNIT_TO_M;
+	o[CAR_ENV_OBS_SPEED_Y] = state.getSpeedY() * Simulation::XY_UNIT_TO_M;
+	o[CAR_ENV_OBS_SPEED_Z] = state.getSpeedZ() * Simulation::Z_UNIT_TO_M;
+	o[CAR_ENV_OBS_YAW] = state.getYaw();
+	o[CAR_ENV_OBS_PITCH] = state.getPitch();
+	o[CAR_ENV_OBS_ROLL] = state.getRoll();
+	o[CAR_ENV_OBS_INERTIA] = state.getInertiaCoef() * Simulation::XY_UNIT_TO_M;
+	o[CAR_ENV_OBS_CHECKPOINT] = state.getLastCheckpoint();
+	o[CAR_ENV_OBS_LAP] = state.lap;
+	o[CAR_ENV_OBS_PROGRESS] = state.getProgress() * Simulation::XY_UNIT_TO_M;
+	for (int r = 0; r < CAR_ENV_LIDAR_RAYS; ++r) {
+		o[CAR_ENV_OBS_LIDAR + r] = (NULL == lidar ? -1 : lidar[r] * Simulation::XY_UNIT_TO_M);
+	}
+}
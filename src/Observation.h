@@ -0,0 +1,13 @@
+#ifndef OBSERVATION_H_AE00ED06_507D_11E4_2656_10FEED04CD1C
+#define OBSERVATION_H_AE00ED06_507D_11E4_2656_10FEED04CD1C
+
+#include "Simulation.h"
+#include "env/CarEnv.h"
+
+// What a policy sees of a car: CAR_ENV_OBSERVATION_SIZE values laid out as the
+// CAR_ENV_OBS_* of env/CarEnv.h, so that the policies trained in the environment
+// can drive in the game too. lidar has the getLidarRays() distances of the car
+// (see Simulation::scanLidar()), or is NULL if there are none.
+void observeCar(const Simulation & simulation, int car, const float * lidar, float * observation);
+
+#endif // OBSERVATION_H_AE00ED06_507D_11E4_2656_10FEED04CD1C
@@ -0,0 +1,165 @@
+#include "PerfOverlay.h"
+
+#include <SDL2/SDL2_gfxPrimitives.h>
+#include <cstdio>
+#include <cstring>
+
+static const int MARGIN = 4;       // pixels
+static const int LINE_HEIGHT = 10; // of the 8x8 font of SDL2_gfx
+static const int TEXT_WIDTH = PerfOverlay::GRAPH_FRAMES; // 50 columns, one pixel per frame in the graph
+
+static const float GOOD_FRAME_MS = 20.0f; // green below, yellow up to SLOW_FRAME_MS, red above
+static const float SLOW_FRAME_MS = 40.0f;
+
+static uint32_t toMicroseconds(int64_t ns) {
+	if (ns <= 0) {
+		return 0;
+	}
+	int64_t us = ns / 1000;
+	return (us > 0xFFFFFFFFLL ? 0xFFFFFFFFu : (uint32_t)us);
+}
+
+void PerfOverlay::Window::reset() {
+	frame.reset();
+	sim.reset();
+	render.reset();
+	frames = 0;
+	ticks = 0;
+	max_ticks = 0;
+	dropped_ticks = 0;
+	duration = 0;
+}
+
+PerfOverlay::PerfOverlay() :
+	mbVisible(false),
+	miCurrent(0),
+	miSimNs(0),
+	miTicks(0),
+	miDroppedTicks(0),
+	miTotalDroppedTicks(0),
+	miSinceRefresh(0),
+	miGraphHead(0)
+{
+	maWindows[0].reset();
+	maWindows[1].reset();
+	memset(mafGraph, 0, sizeof(mafGraph));
+	refresh();
+}
+
+void PerfOverlay::addUpdate(int64_t sim_ns, int ticks, int dropped_ticks) {
+	miSimNs += sim_ns;
+	miTicks += ticks;
+	miDroppedTicks += dropped_ticks;
+}
+
+void PerfOverlay::addFrame(int64_t frame_ns, int64_t render_ns) {
+	Window & window = maWindows[miCurrent];
+	window.frame.record(toMicroseconds(frame_ns));
+	window.sim.record(toMicroseconds(miSimNs));
+	window.render.record(toMicroseconds(render_ns));
+	++window.frames;
+	window.ticks += miTicks;
+	if ((uint32_t)miTicks > window.max_ticks) {
+		window.max_ticks = miTicks;
+	}
+	window.dropped_ticks += miDroppedTicks;
+	window.duration += frame_ns;
+	miTotalDroppedTicks += miDroppedTicks;
+	miSimNs = 0;
+	miTicks = 0;
+	miDroppedTicks = 0;
+
+	mafGraph[miGraphHead] = frame_ns / 1000000.0f;
+	miGraphHead = (miGraphHead + 1) % GRAPH_FRAMES;
+
+	if (window.duration >= (int64_t)WINDOW_MS / 2 * 1000000) {
+		miCurrent = 1 - miCurrent;
+		maWindows[miCurrent].reset();
+	}
+	miSinceRefresh += frame_ns;
+	if (miSinceRefresh >= (int64_t)REFRESH_MS * 1000000) {
+		refresh();
+		miSinceRefresh = 0;
+	}
+}
+
+void PerfOverlay::refresh() {
+	const Window & current = maWindows[miCurrent];
+	const Window & previous = maWindows[1 - miCurrent];
+
+	static const char * const names[] = { "frame", "sim", "render" };
+	const LatencyHistogram Window::* histograms[] = { &Window::frame, &Window::sim, &Window::render };
+	for (int i = 0; i < 3; ++i) {
+		mMerged = current.*histograms[i];
+		mMerged.add(previous.*histograms[i]);
+		snprintf(maLines[LINE_FRAME + i], sizeof(maLines[0]), "%-6s p50 %5.1f p95 %5.1f p99 %5.1f max %5.1f ms",
+			names[i], mMerged.getPercentile(50) / 1000.0, mMerged.getPercentile(95) / 1000.0,
+			mMerged.getPercentile(99) / 1000.0, mMerged.getMax() / 1000.0);
+	}
+
+	uint32_t frames = current.frames + previous.frames;
+	uint32_t max_ticks = (current.max_ticks > previous.max_ticks ? current.max_ticks : previous.max_ticks);
+	snprintf(maLines[LINE_TICKS], sizeof(maLines[0]), "ticks/frame %.2f (max %u)  dropped %u (total %llu)",
+		(frames > 0 ? (double)(current.ticks + previous.ticks) / frames : 0.0), max_ticks,
+		current.dropped_ticks + previous.dropped_ticks, (unsigned long long)miTotalDroppedTicks);
+}
+
+void PerfOverlay::draw(SDL_Renderer * renderer, int x, int y) {
+	if (!mbVisible) {
+		return;
+	}
+	SDL_BlendMode blend_mode;
+	Uint8 r, g, b, a;
+	SDL_GetRenderDrawBlendMode(renderer, &blend_mode);
+	SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+
+	SDL_Rect box;
+	box.x = x;
+	box.y = y;
+	box.w = TEXT_WIDTH + 2 * MARGIN;
+	box.h = LINE_COUNT * LINE_HEIGHT + GRAPH_HEIGHT + 3 * MARGIN;
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+	SDL_RenderFillRect(renderer, &box);
+
+	for (int i = 0; i < LINE_COUNT; ++i) {
+		stringRGBA(renderer, x + MARGIN, y + MARGIN + i * LINE_HEIGHT, maLines[i], 255, 255, 255, 255);
+	}
+
+	// the oldest frame on the left; the bars of a color are drawn together
+	int left = x + MARGIN;
+	int bottom = box.y + box.h - MARGIN;
+	SDL_Rect bars[GRAPH_FRAMES];
+	for (int color = 0; color < 3; ++color) {
+		int count = 0;
+		for (int i = 0; i < GRAPH_FRAMES; ++i) {
+			float ms = mafGraph[(miGraphHead + i) % GRAPH_FRAMES];
+			int bar_color = (ms <= GOOD_FRAME_MS ? 0 : ms <= SLOW_FRAME_MS ? 1 : 2);
+			if (ms <= 0.0f || bar_color != color) {
+				continue;
+			}
+			int height = (ms < GRAPH_MAX_MS ? (int)(ms * GRAPH_HEIGHT / GRAPH_MAX_MS) : GRAPH_HEIGHT);
+			height = (height > 0 ? height : 1);
+			SDL_Rect & bar = bars[count++];
+			bar.x = left + i;
+			bar.y = bottom - height;
+			bar.w = 1;
+			bar.h = height;
+		}
+		static const Uint8 colors[3][3] = { {64, 200, 64}, {230, 200, 40}, {230, 50, 50} };
+		SDL_SetRenderDrawColor(renderer, colors[color][0], colors[color][1], colors[color][2], 255);
+		if (count > 0) {
+			SDL_RenderFillRects(renderer, bars, count);
+		}
+	}
+
+	// the frames of 60 and 30 Hz
+	SDL_SetRenderDrawColor(renderer, 160, 160, 160, 160);
+	for (int hz = 60; hz >= 30; hz /= 2) {
+		int line_y = bottom - (int)(1000.0f / hz * GRAPH_HEIGHT / GRAPH_MAX_MS);
+		SDL_RenderDrawLine(renderer, left, line_y, left + GRAPH_FRAMES - 1, line_y);
+	}
+
+	SDL_SetRenderDrawBlendMode(renderer, blend_mode);
+	SDL_SetRenderDrawColor(renderer, r, g, b, a);
+}
@@ -0,0 +1,75 @@
+#ifndef PERFOVERLAY_H_E2C94A61_7B05_11E4_9D3A_10FEED04CD1C
+#define PERFOVERLAY_H_E2C94A61_7B05_11E4_9D3A_10FEED04CD1C
+
+#include "LatencyHistogram.h"
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+// Where the time of the frames goes, drawn over the game by the SDL renderer, so that
+// a stutter can be seen on any machine without a profiler: the times of the last
+// frames, the percentiles of the frame, simulation and rendering times, the ticks
+// simulated per frame and those dropped to catch up. The frames are always counted,
+// even when it is hidden, in two histograms of half a window each, so that the
+// percentiles are those of the last WINDOW_MS / 2 to WINDOW_MS.
+class PerfOverlay {
+public:
+	static const int GRAPH_FRAMES = 400; // one pixel each
+	static const int GRAPH_HEIGHT = 60;  // pixels
+	static const int GRAPH_MAX_MS = 50;  // at the top of the graph
+	static const int WINDOW_MS = 10000;
+	static const int REFRESH_MS = 250;   // of the text, to be readable
+
+	PerfOverlay();
+
+	// the simulation of the frame, maybe in several updates
+	void addUpdate(int64_t sim_ns, int ticks, int dropped_ticks);
+	// once per frame, after it was presented; frame_ns is the time since the previous one
+	void addFrame(int64_t frame_ns, int64_t render_ns);
+
+	void draw(SDL_Renderer * renderer, int x, int y);
+
+	void toggle() {
+		mbVisible = !mbVisible;
+	}
+	bool isVisible() const {
+		return mbVisible;
+	}
+
+private:
+	struct Window {
+		LatencyHistogram frame; // us
+		LatencyHistogram sim;
+		LatencyHistogram render;
+		uint32_t frames;
+		uint32_t ticks;
+		uint32_t max_ticks;     // in a frame
+		uint32_t dropped_ticks;
+		int64_t duration;       // ns
+
+		void reset();
+	};
+
+	enum { LINE_FRAME, LINE_SIM, LINE_RENDER, LINE_TICKS, LINE_COUNT };
+
+	void refresh();
+
+	bool mbVisible;
+
+	Window maWindows[2];
+	int miCurrent;             // the window being filled, the other is the previous one
+	LatencyHistogram mMerged;  // of the two, for the percentiles
+
+	int64_t miSimNs;           // of the frame in progress
+	int miTicks;
+	int miDroppedTicks;
+	uint64_t miTotalDroppedTicks;
+	int64_t miSinceRefresh;    // ns
+
+	float mafGraph[GRAPH_FRAMES]; // ms, a ring
+	int miGraphHead;              // next one written
+
+	char maLines[LINE_COUNT][64];
+};
+
+#endif // PERFOVERLAY_H_E2C94A61_7B05_11E4_9D3A_10FEED04CD1C
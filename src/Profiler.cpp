@@ -0,0 +1,121 @@
+#include "Profiler.h"
+#include "Threads.h"
+#include "Common.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+enum EventType {
+	EVENT_SCOPE,
+	EVENT_COUNTER
+};
+
+struct Event {
+	const char * name;
+	int64_t time;   // ns
+	double value;   // ns for a scope
+	int type;
+};
+
+// written by its thread only; the others read what is behind miHead
+struct ThreadEvents {
+	int tid;
+	uint32_t miHead; // events written so far
+	Event maEvents[Profiler::CAPACITY];
+};
+
+static Mutex sThreadsMutex;
+static std::vector<ThreadEvents *> sThreads; // never freed, to dump the threads that are gone too
+static __thread ThreadEvents * tsEvents = NULL;
+
+static ThreadEvents * getThreadEvents() {
+	if (NULL == tsEvents) {
+		tsEvents = new ThreadEvents;
+		tsEvents->tid = syscall(SYS_gettid);
+		tsEvents->miHead = 0;
+		Mutex::MutexHolder lock(&sThreadsMutex);
+		sThreads.push_back(tsEvents);
+	}
+	return tsEvents;
+}
+
+static void addEvent(const char * name, int64_t time, double value, int type) {
+	ThreadEvents * events = getThreadEvents();
+	uint32_t head = events->miHead;
+	Event & event = events->maEvents[head & (Profiler::CAPACITY - 1)];
+	event.name = name;
+	event.time = time;
+	event.value = value;
+	event.type = type;
+	__atomic_store_n(&events->miHead, head + 1, __ATOMIC_RELEASE);
+}
+
+void Profiler::scope(const char * name, int64_t begin, int64_t end) {
+	addEvent(name, begin, end - begin, EVENT_SCOPE);
+}
+
+void Profiler::counter(const char * name, double value) {
+	addEvent(name, now(), value, EVENT_COUNTER);
+}
+
+bool Profiler::dump(const char * filename) {
+	if (!isEnabled()) {
+		printWarningLog("The profiler is not compiled in, see ENABLE_PROFILER");
+		return false;
+	}
+	FILE * f = fopen(filename, "w");
+	if (NULL == f) {
+		printErrorLog("Can't create %s: %s", filename, strerror(errno));
+		return false;
+	}
+
+	std::vector<ThreadEvents *> threads;
+	{
+		Mutex::MutexHolder lock(&sThreadsMutex);
+		threads = sThreads;
+	}
+	int pid = getpid();
+	std::vector<Event> copy;
+	unsigned int count = 0;
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (size_t t = 0; t < threads.size(); ++t) {
+		// a copy of the ring while its thread goes on, without the events that it
+		// overwrote meanwhile
+		ThreadEvents * events = threads[t];
+		uint32_t head = __atomic_load_n(&events->miHead, __ATOMIC_ACQUIRE);
+		uint32_t first = (head > (uint32_t)CAPACITY ? head - CAPACITY : 0);
+		copy.resize(head - first);
+		for (uint32_t i = first; i < head; ++i) {
+			copy[i - first] = events->maEvents[i & (CAPACITY - 1)];
+		}
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		// the event after is maybe being written over the slot of after - CAPACITY
+		uint32_t after = __atomic_load_n(&events->miHead, __ATOMIC_RELAXED);
+		uint32_t valid = (after >= (uint32_t)CAPACITY ? after - CAPACITY + 1 : 0);
+
+		for (uint32_t i = (valid > first ? valid : first); i < head; ++i) {
+			const Event & event = copy[i - first];
+			fprintf(f, "%s", (count++ > 0 ? ",\n" : ""));
+			if (EVENT_SCOPE == event.type) {
+				fprintf(f, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					event.name, pid, events->tid, event.time / 1000.0, event.value / 1000.0);
+			} else {
+				fprintf(f, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%g}}",
+					event.name, pid, events->tid, event.time / 1000.0, event.value);
+			}
+		}
+	}
+	fprintf(f, "\n]}\n");
+	bool ok = !ferror(f);
+	ok = (0 == fclose(f)) && ok;
+	if (ok) {
+		printInfoLog("Profile of %u events written in %s", count, filename);
+	} else {
+		printErrorLog("Can't write %s", filename);
+	}
+	return ok;
+}
@@ -0,0 +1,62 @@
+#ifndef PROFILER_H_7C3E2B15_4A1D_11E4_A2C7_10FEED04CD1C
+#define PROFILER_H_7C3E2B15_4A1D_11E4_A2C7_10FEED04CD1C
+
+#include <stdint.h>
+#include <time.h>
+
+// Where the time of a frame goes. PROFILE_SCOPE("name") measures the rest of the
+// block it is in, and PROFILE_COUNTER("name", value) follows a value; both are kept
+// in a ring of the thread that ran them, without locks, and Profiler::dump() writes
+// the last ones in the trace_event JSON of Chrome (chrome://tracing, Perfetto).
+// They are only compiled in with ENABLE_PROFILER, see "make PROFILE=1"; otherwise
+// they are nothing at all.
+class Profiler {
+public:
+	static const int CAPACITY = 65536; // last events of each thread, power of 2
+
+	static int64_t now() { // nanoseconds
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	}
+
+	static void scope(const char * name, int64_t begin, int64_t end);
+	static void counter(const char * name, double value);
+
+	// false if it could not be written, or if the profiler is not compiled in
+	static bool dump(const char * filename);
+
+	static bool isEnabled() {
+#ifdef ENABLE_PROFILER
+		return true;
+#else
+		return false;
+#endif
+	}
+};
+
+class ProfileScope {
+public:
+	ProfileScope(const char * name) : mxName(name), miBegin(Profiler::now()) {
+	}
+
+	~ProfileScope() {
+		Profiler::scope(mxName, miBegin, Profiler::now());
+	}
+
+private:
+	const char * mxName; // a literal
+	int64_t miBegin;
+};
+
+#ifdef ENABLE_PROFILER
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_COUNTER(name, value) Profiler::counter(name, value)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_COUNTER(name, value)
+#endif
+
+#endif // PROFILER_H_7C3E2B15_4A1D_11E4_A2C7_10FEED04CD1C
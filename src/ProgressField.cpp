@@ -0,0 +1,98 @@
+#include "ProgressField.h"
+
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+static const int NEIGHBOURS = 8;
+static const int NEIGHBOUR_DX[NEIGHBOURS] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+static const int NEIGHBOUR_DY[NEIGHBOURS] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+static const float NEIGHBOUR_COST[NEIGHBOURS] = { 1, 1, 1, 1, M_SQRT2, M_SQRT2, M_SQRT2, M_SQRT2 };
+
+typedef std::pair<float, int> QueueItem; // distance, pixel
+typedef std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem> > Queue;
+
+float computeProgressField(const uint8_t * checkpoint, const uint8_t * road, int width, int height,
+	int checkpoints, float * progress)
+{
+	size_t count = (size_t)width * height;
+	for (size_t i = 0; i < count; ++i) {
+		progress[i] = -1;
+	}
+	if (checkpoints < 2) {
+		return 0;
+	}
+	int last = checkpoints - 1;
+
+	// the start line: pixels of checkpoint 0 right after the last checkpoint
+	Queue queue;
+	std::vector<bool> start(count, false);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			size_t i = (size_t)y * width + x;
+			if (!road[i] || 0 != checkpoint[i]) {
+				continue;
+			}
+			for (int n = 0; n < 4; ++n) {
+				int nx = x + NEIGHBOUR_DX[n];
+				int ny = y + NEIGHBOUR_DY[n];
+				if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+					continue;
+				}
+				size_t j = (size_t)ny * width + nx;
+				if (road[j] && last == checkpoint[j]) {
+					start[i] = true;
+					progress[i] = 0;
+					queue.push(QueueItem(0, i));
+					break;
+				}
+			}
+		}
+	}
+	if (queue.empty()) {
+		return 0;
+	}
+
+	float lap_length = 0;
+	while (!queue.empty()) {
+		QueueItem item = queue.top();
+		queue.pop();
+		float distance = item.first;
+		size_t i = item.second;
+		if (distance > progress[i]) { // already reached by a shorter path
+			continue;
+		}
+		int x = i % width;
+		int y = i / width;
+		for (int n = 0; n < NEIGHBOURS; ++n) {
+			int nx = x + NEIGHBOUR_DX[n];
+			int ny = y + NEIGHBOUR_DY[n];
+			if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+				continue;
+			}
+			size_t j = (size_t)ny * width + nx;
+			if (!road[j]) {
+				continue;
+			}
+			// slow ground (grass, sand...) counts as longer, so that the shortest paths follow the road
+			float next = distance + NEIGHBOUR_COST[n] * 255 / road[j];
+			if (start[j] && last == checkpoint[i]) { // back at the start line: a whole lap
+				if (0 == lap_length || next < lap_length) {
+					lap_length = next;
+				}
+				continue;
+			}
+			int step = checkpoint[j] - checkpoint[i];
+			if (step != 0 && step != 1) { // only forward, one checkpoint at a time
+				continue;
+			}
+			if (progress[j] < 0 || next < progress[j]) {
+				progress[j] = next;
+				queue.push(QueueItem(next, j));
+			}
+		}
+	}
+	return lap_length;
+}
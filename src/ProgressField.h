@@ -0,0 +1,20 @@
+#ifndef PROGRESSFIELD_H_886E6E1D_23BB_11E4_903F_10FEED04CD1C
+#define PROGRESSFIELD_H_886E6E1D_23BB_11E4_903F_10FEED04CD1C
+
+#include <stdint.h>
+
+// Distance along the racing direction from the start line to every drivable pixel.
+//
+// The start line is where the last checkpoint meets checkpoint 0. The distances
+// are shortest paths over the 8-connected drivable pixels (Dijkstra) that never
+// go back to a previous checkpoint, so going the wrong way can't shorten them.
+// Every step is weighted by the inverse of the road quality, so the paths keep
+// to the road instead of cutting through the grass.
+//
+// checkpoint and road (quality, 0 for walls) have one value per pixel; progress
+// gets the distance in pixels, or -1 where it can't be reached. Returns the length
+// of the shortest lap, or 0 if there is no start line.
+float computeProgressField(const uint8_t * checkpoint, const uint8_t * road, int width, int height,
+	int checkpoints, float * progress);
+
+#endif // PROGRESSFIELD_H_886E6E1D_23BB_11E4_903F_10FEED04CD1C
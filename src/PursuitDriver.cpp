@@ -0,0 +1,252 @@
+#include "PursuitDriver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+PursuitDriver::PursuitDriver() {
+}
+
+void PursuitDriver::reset(const Simulation & simulation) {
+	std::vector<float> x;
+	std::vector<float> y;
+	if (NULL != simulation.getMap()) {
+		findWaypoints(*simulation.getMap(), x, y);
+	}
+	setWaypoints(x, y);
+	mNearest.assign(simulation.getNumberOfCars(), -1);
+}
+
+void PursuitDriver::findWaypoints(TileMap & map, std::vector<float> & x, std::vector<float> & y) {
+	int checkpoints = map.getCheckpoints();
+	x.resize(checkpoints);
+	y.resize(checkpoints);
+	for (int k = 0; k < checkpoints; ++k) {
+		x[k] = map.getCheckpoint(k).centre_x;
+		y[k] = map.getCheckpoint(k).centre_y;
+	}
+
+	// the checkpoints take in the grass along the road too, so on resident maps the
+	// centre of every checkpoint is that of its pixels with the best grip
+	if (!map.isStreamed()) {
+		std::vector<int> best(checkpoints, 0);
+		std::vector<double> sum_x(checkpoints, 0);
+		std::vector<double> sum_y(checkpoints, 0);
+		std::vector<int> pixels(checkpoints, 0);
+		for (int py = 0; py < map.getHeight(); ++py) {
+			for (int px = 0; px < map.getWidth(); ++px) {
+				const uint8_t * c = map.functionAt(px, py);
+				int k = c[0] / 8;
+				if (0 == c[1] || k >= checkpoints || c[1] < best[k]) {
+					continue;
+				}
+				if (c[1] > best[k]) {
+					best[k] = c[1];
+					sum_x[k] = sum_y[k] = 0;
+					pixels[k] = 0;
+				}
+				sum_x[k] += px + 0.5;
+				sum_y[k] += py + 0.5;
+				++pixels[k];
+			}
+		}
+		for (int k = 0; k < checkpoints; ++k) {
+			if (pixels[k] > 0) {
+				x[k] = sum_x[k] / pixels[k];
+				y[k] = sum_y[k] / pixels[k];
+			}
+		}
+	}
+
+	// without the checkpoints that the track doesn't have
+	size_t kept = 0;
+	for (int k = 0; k < checkpoints; ++k) {
+		if (map.getCheckpoint(k).pixels > 0) {
+			x[kept] = x[k];
+			y[kept] = y[k];
+			++kept;
+		}
+	}
+	x.resize(kept);
+	y.resize(kept);
+}
+
+void PursuitDriver::setWaypoints(const std::vector<float> & x, const std::vector<float> & y) {
+	mLineX.clear();
+	mLineY.clear();
+	mNearest.assign(mNearest.size(), -1);
+	if (x.size() < 2) {
+		return;
+	}
+
+	// points every LINE_STEP pixels, so that the nearest one is near enough
+	for (size_t i = 0; i < x.size(); ++i) {
+		size_t next = (i + 1) % x.size();
+		float dx = x[next] - x[i];
+		float dy = y[next] - y[i];
+		int steps = std::max(1, (int)ceil(sqrt(dx * dx + dy * dy) / LINE_STEP));
+		for (int s = 0; s < steps; ++s) {
+			addLinePoint(x[i] + dx * s / steps, y[i] + dy * s / steps);
+		}
+	}
+
+	int count = mLineX.size();
+	std::vector<float> smooth_x(count);
+	std::vector<float> smooth_y(count);
+	for (int pass = 0; pass < SMOOTHING; ++pass) {
+		for (int i = 0; i < count; ++i) {
+			int previous = (i + count - 1) % count;
+			int next = (i + 1) % count;
+			smooth_x[i] = (mLineX[previous] + 2 * mLineX[i] + mLineX[next]) / 4;
+			smooth_y[i] = (mLineY[previous] + 2 * mLineY[i] + mLineY[next]) / 4;
+		}
+		mLineX.swap(smooth_x);
+		mLineY.swap(smooth_y);
+	}
+}
+
+bool PursuitDriver::loadWaypoints(const char * filename) {
+	FILE * f = fopen(filename, "r");
+	if (NULL == f) {
+		return false;
+	}
+	std::vector<float> x;
+	std::vector<float> y;
+	char line[MAX_LINE_LENGTH];
+	while (fgets(line, sizeof(line), f)) {
+		float wx, wy;
+		if ('#' != line[0] && 2 == sscanf(line, "%f %f", &wx, &wy)) {
+			x.push_back(wx);
+			y.push_back(wy);
+		}
+	}
+	fclose(f);
+	if (x.size() < 2) {
+		return false;
+	}
+	setWaypoints(x, y);
+	return true;
+}
+
+bool PursuitDriver::saveWaypoints(const char * filename, const std::vector<float> & x, const std::vector<float> & y) {
+	FILE * f = fopen(filename, "w");
+	if (NULL == f) {
+		return false;
+	}
+	fprintf(f, "# waypoints of the racing line, x y in pixels\n");
+	for (size_t i = 0; i < x.size(); ++i) {
+		fprintf(f, "%.2f %.2f\n", x[i], y[i]);
+	}
+	return (0 == fclose(f));
+}
+
+void PursuitDriver::addLinePoint(float x, float y) {
+	mLineX.push_back(x);
+	mLineY.push_back(y);
+}
+
+// drives a range of the cars, which only touch their own input and nearest point
+class PursuitDriver::Driver : public ParallelTask {
+public:
+	Driver(PursuitDriver & driver, Simulation & simulation, const int * cars) :
+		mxDriver(driver), mxSimulation(simulation), mxCars(cars)
+	{
+	}
+
+	virtual void run(int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			mxDriver.driveCar(mxSimulation, mxCars[i]);
+		}
+	}
+
+private:
+	PursuitDriver & mxDriver;
+	Simulation & mxSimulation;
+	const int * mxCars;
+};
+
+void PursuitDriver::drive(Simulation & simulation, const int * cars, int count, ThreadPool * pool) {
+	if (mNearest.size() != (size_t)simulation.getNumberOfCars()) {
+		mNearest.assign(simulation.getNumberOfCars(), -1);
+	}
+	Driver driver(*this, simulation, cars);
+	if (NULL != pool && count >= PARALLEL_CARS) {
+		pool->parallelFor(count, driver, 64);
+	} else {
+		driver.run(0, count);
+	}
+}
+
+void PursuitDriver::driveCar(Simulation & simulation, int car) {
+	CarInput & input = simulation.getInput(car);
+	int points = mLineX.size();
+	if (0 == points) {
+		input.up_down = 0;
+		input.left_right = 0;
+		return;
+	}
+
+	const Car & state = simulation.getCar(car);
+	float x = state.getPosX();
+	float y = state.getPosY();
+	float speed = state.getInertiaCoef();
+	int nearest = findNearest(x, y, mNearest[car]);
+	mNearest[car] = nearest;
+
+	// the first point of the line further than the lookahead distance
+	float lookahead = LOOKAHEAD + LOOKAHEAD_SPEED * std::max(speed, 0.0f);
+	int target = nearest;
+	for (int n = 0; n < points; ++n) {
+		float dx = mLineX[target] - x;
+		float dy = mLineY[target] - y;
+		if (dx * dx + dy * dy >= lookahead * lookahead) {
+			break;
+		}
+		target = (target + 1) % points;
+	}
+
+	// the car heads to -(cos, sin) of its yaw, and turning right increases the yaw
+	float heading_x = -cos(state.getYaw());
+	float heading_y = -sin(state.getYaw());
+	float dx = mLineX[target] - x;
+	float dy = mLineY[target] - y;
+	float angle = atan2(heading_x * dy - heading_y * dx, heading_x * dx + heading_y * dy);
+
+	input.left_right = std::min(std::max(angle * STEERING_GAIN, -1.0f), 1.0f);
+	if (fabs(angle) > CORNER_ANGLE && speed > CORNER_SPEED) {
+		input.up_down = CORNER_BRAKE;
+	} else {
+		input.up_down = -1;
+	}
+}
+
+int PursuitDriver::findNearest(float x, float y, int from) const {
+	int points = mLineX.size();
+	int best = -1;
+	float best_distance = 0;
+	if (from >= 0) { // it only goes forward, a little at a time
+		for (int n = -1; n <= SEARCH_AHEAD; ++n) {
+			int i = (from + n + points) % points;
+			float dx = mLineX[i] - x;
+			float dy = mLineY[i] - y;
+			float distance = dx * dx + dy * dy;
+			if (best < 0 || distance < best_distance) {
+				best = i;
+				best_distance = distance;
+			}
+		}
+		if (best_distance < LOST * LOST) {
+			return best;
+		}
+	}
+	for (int i = 0; i < points; ++i) {
+		float dx = mLineX[i] - x;
+		float dy = mLineY[i] - y;
+		float distance = dx * dx + dy * dy;
+		if (best < 0 || distance < best_distance) {
+			best = i;
+			best_distance = distance;
+		}
+	}
+	return best;
+}
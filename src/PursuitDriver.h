@@ -0,0 +1,68 @@
+#ifndef PURSUITDRIVER_H_2A3BEC58_1BB3_11E4_2144_10FEED04CD1C
+#define PURSUITDRIVER_H_2A3BEC58_1BB3_11E4_2144_10FEED04CD1C
+
+#include "Controller.h"
+
+#include <vector>
+
+// Pure pursuit along a line through the checkpoints of the track: every car steers
+// towards the point of the line a little ahead of it, further when it goes faster,
+// and brakes when that point is too far to a side for its speed.
+//
+// The line goes through waypoints, by default the centre of every checkpoint taken
+// over the pixels of the best ground in it, and it is smoothed a little. Better
+// waypoints can be found with the lineoptimizer tool.
+class PursuitDriver : public Controller {
+public:
+	static const float LOOKAHEAD = 40;       // pixels ahead on the line, when stopped
+	static const float LOOKAHEAD_SPEED = 10; // more pixels per pixel/tick of speed
+	static const float STEERING_GAIN = 3;    // full lock a third of a radian away from the line
+	static const float CORNER_ANGLE = 0.5;   // radians to the side of the target, to brake
+	static const float CORNER_SPEED = 3;     // pixels/tick, under which it never brakes
+	static const float CORNER_BRAKE = 0.5;   // not enough to make the tires slide
+	static const int PARALLEL_CARS = 256;    // from this many cars on, they are driven in the pool
+
+	PursuitDriver();
+
+	virtual void reset(const Simulation & simulation);
+	virtual void drive(Simulation & simulation, const int * cars, int count, ThreadPool * pool = NULL);
+
+	// the default waypoints of a track
+	static void findWaypoints(TileMap & map, std::vector<float> & x, std::vector<float> & y);
+	// follow a closed line through the given waypoints instead
+	void setWaypoints(const std::vector<float> & x, const std::vector<float> & y);
+
+	// text files with one waypoint per line, "x y" in pixels, and comments after '#'
+	bool loadWaypoints(const char * filename);
+	static bool saveWaypoints(const char * filename, const std::vector<float> & x, const std::vector<float> & y);
+
+	int getLinePoints() const {
+		return mLineX.size();
+	}
+	float getLineX(int i) const {
+		return mLineX[i];
+	}
+	float getLineY(int i) const {
+		return mLineY[i];
+	}
+
+private:
+	static const float LINE_STEP = 8;     // pixels between the points of the line
+	static const int SMOOTHING = 4;       // passes
+	static const int SEARCH_AHEAD = 16;   // points of the line where the nearest one is looked for
+	static const float LOST = 100;        // pixels from the line, to look for it everywhere
+	static const int MAX_LINE_LENGTH = 80; // of the waypoint files
+
+	std::vector<float> mLineX; // closed: the last point goes back to the first one
+	std::vector<float> mLineY;
+	std::vector<int> mNearest; // point of the line nearest to every car, -1 if unknown
+
+	class Driver;
+	friend class Driver;
+
+	void addLinePoint(float x, float y);
+	void driveCar(Simulation & simulation, int car);
+	int findNearest(float x, float y, int from) const;
+};
+
+#endif // PURSUITDRIVER_H_2A3BEC58_1BB3_11E4_2144_10FEED04CD1C
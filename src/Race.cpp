@@ -23,7 +23,9 @@
 
 #include "Race.h"
 #include "InfoTypes.h"
+#include "SdlUtils.h"
 #include "Common.h"
+#include "Profiler.h"
 
 #include <stdlib.h>
 #include <time.h>
@@ -34,99 +36,32 @@
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL2_rotozoom.h>
 #include <sys/stat.h>
+#include <algorithm>
 
-const Track Race::track[] = {
-	{ "car",      450, 655, 180,   "Car",                            "ICFP Programming Contest" },
-	{ "first",    435, 215, 180,   "First circuit for this game...", "Royale" },
-	{ "icy",      435, 215, 180,   "Same as First, but in winter!",  "Royale" },
-	{ "hairpins", 505, 665, 0,     "Hairpins",                       "ICFP Programming Contest" },
-
-	{ "simple",   585, 565, 0,     "Simple",                         "ICFP Programming Contest" },
-	{ "loop",     678, 686, 0,     "Loop",                           "Royale" },
-	{ "bio",      930, 500, 270,   "Bio",                            "Jujucece" },
-	{ "city",     106, 358, 90,    "City",                           "Jujucece" },
-
-	{ "desert",   680, 487, 80,    "Desert",                         "Jujucece" },
-	{ "http",     520, 70, 180,    "HTTP"                            "Jujucece" },
-	{ "kart",     370, 725, 0,     "Kart",                           "Jujucece" },
-	{ "wave",     630, 380, 180,   "Wave",                           "Jujucece" },
-
-	{ "wave2",     630, 380, 180,  "Wave 2",                         "Miriam" },
-	{ "formula",  350, 330, 220,   "Formula",                        "Ju" },
-	{ NULL,       0,   0,   0,     "",                               "" },
-	{ NULL,       0,   0,   0,     "",                               "" },
-};
-
-/*
- * Return the pixel value at (x, y)
- * NOTE: The surface must be locked before calling this!
- */
-static Uint32 sdlGetPixel(SDL_Surface *surface, int x, int y) {
-	int bpp = surface->format->BytesPerPixel;
-	// Here p is the address to the pixel we want to retrieve
-	Uint8 *p = (Uint8 *)surface->pixels + y * surface->pitch + x * bpp;
-
-	switch(bpp) {
-		case 1:
-			return *p;
-		case 2:
-			return *(Uint16 *)p;
-		case 3:
-			if(SDL_BYTEORDER == SDL_BIG_ENDIAN)
-				return p[0] << 16 | p[1] << 8 | p[2];
-			else
-				return p[0] | p[1] << 8 | p[2] << 16;
-		case 4:
-			return *(Uint32 *)p;
-		default:
-			return 0; // shouldn't happen, but avoids warnings
-    }
-}
-
-/*
- * Set the pixel at (x, y) to the given value
- * NOTE: The surface must be locked before calling this!
- */
-static void sdlPutPixel(SDL_Surface *surface, int x, int y, Uint32 pixel) {
-	int bpp = surface->format->BytesPerPixel;
-	// Here p is the address to the pixel we want to set
-	Uint8 *p = (Uint8 *)surface->pixels + y * surface->pitch + x * bpp;
-
-	switch(bpp) {
-		case 1:
-			*p = pixel;
-			break;
-		case 2:
-			*(Uint16 *)p = pixel;
-			break;
-		case 3:
-			if(SDL_BYTEORDER == SDL_BIG_ENDIAN) {
-				p[0] = (pixel >> 16) & 0xff;
-				p[1] = (pixel >> 8) & 0xff;
-				p[2] = pixel & 0xff;
-			} else {
-				p[0] = pixel & 0xff;
-				p[1] = (pixel >> 8) & 0xff;
-				p[2] = (pixel >> 16) & 0xff;
-			}
-			break;
-		case 4:
-			*(Uint32 *)p = pixel;
-			break;
-		default:
-			return; // shouldn't happen, but avoids warnings
-	}
-}
+#define TRACK_MANIFEST "tracks/tracks.cfg"
+#define DRIVER_POLICY "policies/driver.mlp"
+#define RECORDINGS_DIR "recordings"
+#define TELEMETRY_PORT 0 // to stream the telemetry over TCP too
 
 Race::Race() :
 	mxSdlRenderer(NULL),
-	mpSdlTextureCircuit(NULL),
-	mpSdlSurfaceCircuit(NULL),
-	mpSdlSurfaceFunction(NULL),
-	mSdlSurfaceFunctionIsDirty(true),
 	miTrackId(0),
+	mTrackCache(mTrackCatalog, TRACK_CACHE_BYTES, STREAMED_TRACK_BYTES),
+	mxTrackData(NULL),
+	mxTrackMap(NULL),
+	miTileTextureCount(0),
+	miFrame(0),
+	mxDriver(&mPursuitDriver),
+	mTelemetryServer(mTelemetry),
 	miCarId(0),
+	miNumberOfCars(1),
+	miPlayerCar(0),
 	show_tires(true),
+	miCarBodyLength(0),
+	miCarBodyWidth(0),
+	mbDragging(false),
+	miMouseX(0),
+	miMouseY(0),
 	mLeftRightJoyAxis(0),
 	mUpDownJoyAxis(0),
 	mUpKey(false),
@@ -134,26 +69,45 @@ Race::Race() :
 	mLeftKey(false),
 	mRightKey(false)
 {
+	memset(mpaSdlTextureCars, 0, sizeof(mpaSdlTextureCars));
 	generateCars();
 }
 
 Race::~Race() {
-	if (NULL != mpSdlTextureCircuit) {
-		SDL_DestroyTexture(mpSdlTextureCircuit);
-		mpSdlTextureCircuit = NULL;
+	tearDown();
+	mTelemetryServer.stop();
+	mSharedTelemetry.close();
+}
+
+void Race::setUp(SDL_Renderer * renderer) {
+	mxSdlRenderer = renderer;
+	if (0 == mTrackCatalog.size()) {
+		mTrackCatalog.load(TRACK_MANIFEST);
+	}
+	// the other cars follow the checkpoints, unless there is a trained policy to drive them
+	mxDriver = &mPursuitDriver;
+	if (mNeuralDriver.isLoaded() || mNeuralDriver.load(DRIVER_POLICY)) {
+		mxDriver = &mNeuralDriver;
 	}
-	if (NULL != mpSdlSurfaceCircuit) {
-		SDL_FreeSurface(mpSdlSurfaceCircuit);
-		mpSdlSurfaceCircuit = NULL;
+	if (!mSharedTelemetry.isOpen()) {
+		mSharedTelemetry.open();
 	}
-	if (NULL != mpSdlSurfaceFunction) {
-		SDL_FreeSurface(mpSdlSurfaceFunction);
-		mpSdlSurfaceFunction = NULL;
+	if (!mTelemetryServer.isRunning()) {
+		mTelemetryServer.start(TELEMETRY_SOCKET, TELEMETRY_PORT);
 	}
 }
 
-void Race::setUp(SDL_Renderer * renderer) {
-	mxSdlRenderer = renderer;
+// release everything that depends on the renderer, so it must be called before destroying it
+void Race::tearDown() {
+	mRecorder.stop();
+	releaseTileTextures();
+	releaseCarTextures();
+	if (NULL != mxTrackData) {
+		mTrackCache.release(mxTrackData);
+		mxTrackData = NULL;
+	}
+	mxTrackMap = NULL;
+	mTrackCache.clear();
 }
 
 // load the car sprite and rotate it for every angles
@@ -164,6 +118,12 @@ void Race::generateCars() {
 	for (i = 0; i < NB_CARS; i++) {
 		temp[11]='A'+i;
 		car = IMG_Load(temp); // load the car sprite
+		if (car->w > miCarBodyLength) {
+			miCarBodyLength = car->w;
+		}
+		if (car->h > miCarBodyWidth) {
+			miCarBodyWidth = car->h;
+		}
 		for (j=0;j<256;j++) { // and rotate it for all available angles
 			float x,y;
 			float tcos,tsin;
@@ -185,6 +145,17 @@ void Race::generateCars() {
 	}
 }
 
+void Race::releaseCarTextures() {
+	for (int i = 0; i < NB_CARS; i++) {
+		for (int j = 0; j < 256; j++) {
+			if (NULL != mpaSdlTextureCars[i][j]) {
+				SDL_DestroyTexture(mpaSdlTextureCars[i][j]);
+				mpaSdlTextureCars[i][j] = NULL;
+			}
+		}
+	}
+}
+
 void Race::darkenTrack(SDL_Surface *surface, float coef) {
 	SDL_Rect pos;
 	for (pos.x = 0; pos.x < surface->w; pos.x++) {
@@ -201,49 +172,93 @@ void Race::darkenTrack(SDL_Surface *surface, float coef) {
 	}
 }
 
-void Race::startTrack(int id) {
-	if (id >= 0 && id < MAX_TRACKS) {
-		miTrackId = id;
-	}
-	char circname[128];
-	sprintf(circname, "tracks/%s.png", track[miTrackId].filename);
-	mpSdlSurfaceCircuit = IMG_Load(circname);
-
-	char funcname[128];
-	sprintf(funcname, "tracks/%s_function.png", track[miTrackId].filename);
-	mpSdlSurfaceFunction = IMG_Load(funcname);
-
-	for (int x = 0; x < mpSdlSurfaceCircuit->w; ++x) {
-		Uint8 prev_b = 0;
-		for (int y = 0; y < mpSdlSurfaceCircuit->h; ++y) {
-			Uint32 c = sdlGetPixel(mpSdlSurfaceFunction, x, y);
-			Uint8 r, g, b;
-			SDL_GetRGB(c, mpSdlSurfaceFunction->format, &r, &g, &b);
-			if (0 != y) {
-				if ( (prev_b / 4) != (b / 4) ) {
-					sdlPutPixel(mpSdlSurfaceCircuit, x, y, SDL_MapRGB(mpSdlSurfaceCircuit->format, b, b, b));
+void Race::releaseTileTextures() {
+	for (size_t i = 0; i < mTileTextures.size(); ++i) {
+		if (NULL != mTileTextures[i].texture) {
+			SDL_DestroyTexture(mTileTextures[i].texture);
+		}
+	}
+	mTileTextures.clear();
+	miTileTextureCount = 0;
+	mTireMarks.clear();
+}
+
+SDL_Texture * Race::getTileTexture(int tx, int ty) {
+	TileTexture & tile = mTileTextures[tx + ty * mxTrackMap->getTilesX()];
+	tile.last_frame = miFrame;
+	if (NULL != tile.texture) {
+		return tile.texture;
+	}
+
+	int size = mxTrackMap->getTileSize();
+	tile.texture = SDL_CreateTexture(mxSdlRenderer, SDL_PIXELFORMAT_RGBA_BYTES, SDL_TEXTUREACCESS_TARGET, size, size);
+	if (NULL == tile.texture) { // the renderer can't draw on textures, so no tire marks
+		tile.texture = SDL_CreateTexture(mxSdlRenderer, SDL_PIXELFORMAT_RGBA_BYTES, SDL_TEXTUREACCESS_STATIC, size, size);
+	}
+	if (NULL != tile.texture) {
+		const uint8_t * pixels = mxTrackMap->getTilePixels(TileMap::LAYER_DISPLAY, tx, ty);
+		if (!tile.marks.empty()) { // made before, while it had no texture
+			mTilePixels.assign(pixels, pixels + size * size * TileMap::BYTES_PER_PIXEL);
+			for (size_t i = 0; i < tile.marks.size(); ++i) {
+				for (int bit = 0; tile.marks[i] != 0 && bit < 8; ++bit) {
+					if (tile.marks[i] & (1 << bit)) {
+						uint8_t * pixel = &mTilePixels[(i * 8 + bit) * TileMap::BYTES_PER_PIXEL];
+						pixel[0] = pixel[1] = pixel[2] = 0; // black
+						pixel[3] = 255;
+					}
 				}
 			}
-			prev_b = b;
+			pixels = &mTilePixels[0];
 		}
+		SDL_UpdateTexture(tile.texture, NULL, pixels, size * TileMap::BYTES_PER_PIXEL);
+		++miTileTextureCount;
 	}
+	return tile.texture;
+}
 
-	for (int y = 0; y < mpSdlSurfaceCircuit->h; ++y) {
-		Uint8 prev_b = 0;
-		for (int x = 0; x < mpSdlSurfaceCircuit->w; ++x) {
-			Uint32 c = sdlGetPixel(mpSdlSurfaceFunction, x, y);
-			Uint8 r, g, b;
-			SDL_GetRGB(c, mpSdlSurfaceFunction->format, &r, &g, &b);
-			if (0 != x) {
-				if ( (prev_b / 4) != (b / 4) ) {
-					sdlPutPixel(mpSdlSurfaceCircuit, x, y, SDL_MapRGB(mpSdlSurfaceCircuit->format, b, b, b));
-				}
+// destroy the textures that haven't been drawn for the longest time
+void Race::trimTileTextures() {
+	while (miTileTextureCount > MAX_TILE_TEXTURES) {
+		TileTexture * oldest = NULL;
+		for (size_t i = 0; i < mTileTextures.size(); ++i) {
+			TileTexture & tile = mTileTextures[i];
+			if (NULL != tile.texture && tile.last_frame != miFrame && (NULL == oldest || tile.last_frame < oldest->last_frame)) {
+				oldest = &tile;
 			}
-			prev_b = b;
 		}
+		if (NULL == oldest) { // everything is visible
+			return;
+		}
+		SDL_DestroyTexture(oldest->texture);
+		oldest->texture = NULL;
+		--miTileTextureCount;
 	}
+}
 
-	mpSdlTextureCircuit = SDL_CreateTextureFromSurface(mxSdlRenderer, mpSdlSurfaceCircuit);
+bool Race::startTrack(int id) {
+	if (id < 0 || id >= mTrackCatalog.size()) {
+		id = miTrackId;
+	}
+
+	TrackData * track_data = mTrackCache.acquire(id);
+	if (NULL == track_data) {
+		return false;
+	}
+	mRecorder.stop(); // a recording is of one track and a number of cars
+	if (NULL != mxTrackData) {
+		mTrackCache.release(mxTrackData);
+	}
+	mxTrackData = track_data;
+	mxTrackMap = &mxTrackData->map;
+	miTrackId = id;
+
+	releaseTileTextures();
+	TileTexture no_texture = { NULL, 0 };
+	mTileTextures.resize(mxTrackMap->getTilesX() * mxTrackMap->getTilesY(), no_texture);
+
+	mSimulation.setMap(mxTrackMap);
+
+	const Track & track = mTrackCatalog.get(miTrackId);
 
 	mLeftRightJoyAxis = 0;
 	mUpDownJoyAxis = 0;
@@ -253,306 +268,287 @@ void Race::startTrack(int id) {
 	mLeftKey = false;
 	mRightKey = false;
 
-	car.setSize( mpaSdlSurfaceCars[0][0]->w, mpaSdlSurfaceCars[0][0]->h);
-	car.setPosition( track[miTrackId].start_x, track[miTrackId].start_y, track[miTrackId].start_a * 2. * M_PI / 360. );
-	car.setInertiaCoef(0);
-	car.resetTimer();
-	car.backupPosition();
+	placeCars(track);
+	mTelemetry.publish(mSimulation, miTrackId, miPlayerCar);
+	mSharedTelemetry.write(mTelemetry.getPublished());
+	mTelemetryServer.notify();
 
-	car.cleanCheckpoints();
-	car.lapflag = 0;
-}
+	mCamera.setWorldSize(mxTrackMap->getWidth(), mxTrackMap->getHeight());
+	mCamera.reset();
+	mbDragging = false;
 
-void Car::updateTimer(unsigned int milliseconds) {
-	inc_time_ms     = milliseconds;
-	global_time_ms += milliseconds;
-	float elapsed_time_s = inc_time_ms / 1000.0;
-	now.spd_x = (now.pos_x - before.pos_x) / elapsed_time_s;
-	now.spd_y = (now.pos_y - before.pos_y) / elapsed_time_s;
-	now.spd_z = (now.pos_z - before.pos_z) / elapsed_time_s;
-	now.acc_x = (now.spd_x - before.spd_x) / elapsed_time_s;
-	now.acc_y = (now.spd_y - before.spd_y) / elapsed_time_s;
-	now.acc_z = (now.spd_z - before.spd_z) / elapsed_time_s;
+	return true;
 }
 
-void Car::drawRawLight(SDL_Renderer * renderer, int x, int y, int r) {
-	SDL_RenderDrawPoint(renderer, x, y);
-	if (r>1) {
-		SDL_RenderDrawPoint(renderer, x-1, y   );
-		SDL_RenderDrawPoint(renderer, x+1, y   );
-		SDL_RenderDrawPoint(renderer, x,   y-1 );
-		SDL_RenderDrawPoint(renderer, x,   y+1 );
-	}
-	if (r>2) {
-		SDL_RenderDrawPoint(renderer, x-2, y   );
-		SDL_RenderDrawPoint(renderer, x+2, y   );
-		SDL_RenderDrawPoint(renderer, x,   y-2 );
-		SDL_RenderDrawPoint(renderer, x,   y+2 );
-		SDL_RenderDrawPoint(renderer, x-1, y-1 );
-		SDL_RenderDrawPoint(renderer, x-1, y+1 );
-		SDL_RenderDrawPoint(renderer, x+1, y-1 );
-		SDL_RenderDrawPoint(renderer, x+1, y+1 );
-	}
+void Race::setNumberOfCars(int n) {
+	miNumberOfCars = (n > 0 ? n : 1);
 }
 
-void Car::drawBrakeLights(SDL_Renderer * renderer) {
-	SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Red
-	drawRawLight(renderer, now.pos_x + cos(now.ang_yaw) * length/3 - sin(now.ang_yaw)*4, now.pos_y + sin(now.ang_yaw) * width/3 + cos(now.ang_yaw)*4, 3);
-	drawRawLight(renderer, now.pos_x + cos(now.ang_yaw) * length/3 + sin(now.ang_yaw)*4, now.pos_y + sin(now.ang_yaw) * width/3 - cos(now.ang_yaw)*4, 3);
+// the player starts at the given position, and the rest of the cars behind it, two by row
+void Race::placeCars(const Track & track) {
+	mSimulation.setCarSize(mpaSdlSurfaceCars[0][0]->w, mpaSdlSurfaceCars[0][0]->h, miCarBodyLength, miCarBodyWidth);
+	mSimulation.placeCars(miNumberOfCars, track.start_x, track.start_y, track.start_a);
+	miPlayerCar = 0;
+	mDrivenCars.clear();
+	for (int i = 0; i < miNumberOfCars; ++i) {
+		mSimulation.getCar(i).color = (miCarId + i) % NB_CARS;
+		if (miPlayerCar != i) {
+			mDrivenCars.push_back(i);
+		}
+	}
+	mxDriver->reset(mSimulation);
+	if (&mPursuitDriver == mxDriver) { // a racing line from the lineoptimizer tool, if there is one
+		std::string line = "tracks/" + track.filename + ".line";
+		if (mPursuitDriver.loadWaypoints(line.c_str())) {
+			printInfoLog("Racing line %s", line.c_str());
+		}
+	}
 }
 
-void Car::drawReversingLights(SDL_Renderer * renderer) {
-	SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); // White
-	drawRawLight(renderer, now.pos_x + cos(now.ang_yaw) * length/3 - sin(now.ang_yaw)*4, now.pos_y + sin(now.ang_yaw) * width/3 + cos(now.ang_yaw)*4, 3);
-	drawRawLight(renderer, now.pos_x + cos(now.ang_yaw) * length/3 + sin(now.ang_yaw)*4, now.pos_y + sin(now.ang_yaw) * width/3 - cos(now.ang_yaw)*4, 3);
+void Race::addTireMark(float x, float y) {
+	if (x < 0 || y < 0 || x >= mxTrackMap->getWidth() || y >= mxTrackMap->getHeight()) {
+		return;
+	}
+	int size = mxTrackMap->getTileSize();
+	TireMark mark;
+	mark.tile = (int)x / size + ((int)y / size) * mxTrackMap->getTilesX();
+	mark.pixel = ((int)y % size) * size + (int)x % size;
+	mTireMarks.push_back(mark);
 }
 
-void Car::drawWarningLights(SDL_Renderer * renderer) {
-	SDL_SetRenderDrawColor(renderer, 255, 200, 0, 255); // Orange
-	drawRawLight(renderer, now.pos_x - cos(now.ang_yaw) * length/3 - sin(now.ang_yaw)*5, now.pos_y - sin(now.ang_yaw) * width/3 + cos(now.ang_yaw)*5, 2);
-	drawRawLight(renderer, now.pos_x - cos(now.ang_yaw) * length/3 + sin(now.ang_yaw)*5, now.pos_y - sin(now.ang_yaw) * width/3 - cos(now.ang_yaw)*5, 2);
-	drawRawLight(renderer, now.pos_x + cos(now.ang_yaw) * length/3 - sin(now.ang_yaw)*5, now.pos_y + sin(now.ang_yaw) * width/3 + cos(now.ang_yaw)*5, 2);
-	drawRawLight(renderer, now.pos_x + cos(now.ang_yaw) * length/3 + sin(now.ang_yaw)*5, now.pos_y + sin(now.ang_yaw) * width/3 - cos(now.ang_yaw)*5, 2);
+// where the tires of a sliding car leave marks; wider if it is braking
+void Race::addTireMarks(const Car & car) {
+	float x = car.getPosX();
+	float y = car.getPosY();
+	float w = car.getLength();
+	float h = car.getWidth();
+	float angle = car.getYaw();
+	float cos_a = cos(angle);
+	float sin_a = sin(angle);
+
+	addTireMark(x + cos_a * w/3 - sin_a*4, y + sin_a * h/3 + cos_a*4);
+	addTireMark(x + cos_a * w/3 + sin_a*4, y + sin_a * h/3 - cos_a*4);
+	if (2 == car.slideflag) {
+		addTireMark(x + cos_a * w/3 - sin_a*3, y + sin_a * h/3 + cos_a*3);
+		addTireMark(x + cos_a * w/3 + sin_a*3, y + sin_a * h/3 - cos_a*3);
+	}
 }
 
-void Car::drawPositionLights(SDL_Renderer * renderer) {
-	if (position_lights) {
-		SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Red
-		drawRawLight(renderer, now.pos_x + cos(now.ang_yaw) * length/3 - sin(now.ang_yaw)*3, now.pos_y + sin(now.ang_yaw) * width/3 + cos(now.ang_yaw)*4, 2);
-		drawRawLight(renderer, now.pos_x + cos(now.ang_yaw) * length/3 + sin(now.ang_yaw)*3, now.pos_y + sin(now.ang_yaw) * width/3 - cos(now.ang_yaw)*4, 2);
-		SDL_SetRenderDrawColor(renderer, 255, 255, 100, 255); // Yellow
-		drawRawLight(renderer, now.pos_x - cos(now.ang_yaw) * length/3 - sin(now.ang_yaw)*4, now.pos_y - sin(now.ang_yaw) * width/3 + cos(now.ang_yaw)*4, 3);
-		drawRawLight(renderer, now.pos_x - cos(now.ang_yaw) * length/3 + sin(now.ang_yaw)*4, now.pos_y - sin(now.ang_yaw) * width/3 - cos(now.ang_yaw)*4, 3);
+// The marks are kept in the tiles, to be there again when a tile gets a texture, and
+// the new ones are drawn on the textures that exist, every tile at once.
+void Race::drawTireMarks() {
+	if (mTireMarks.empty()) {
+		return;
+	}
+	int size = mxTrackMap->getTileSize();
+	std::sort(mTireMarks.begin(), mTireMarks.end());
+	bool target_set = false;
+	for (size_t begin = 0, end; begin < mTireMarks.size(); begin = end) {
+		TileTexture & tile = mTileTextures[mTireMarks[begin].tile];
+		if (tile.marks.empty()) {
+			tile.marks.assign((size * size + 7) / 8, 0);
+		}
+		mTireMarkPoints.clear();
+		for (end = begin; end < mTireMarks.size() && mTireMarks[end].tile == mTireMarks[begin].tile; ++end) {
+			int pixel = mTireMarks[end].pixel;
+			uint8_t bit = 1 << (pixel & 7);
+			if (0 == (tile.marks[pixel >> 3] & bit)) {
+				tile.marks[pixel >> 3] |= bit;
+				SDL_Point point;
+				point.x = pixel % size;
+				point.y = pixel / size;
+				mTireMarkPoints.push_back(point);
+			}
+		}
+		if (NULL != tile.texture && !mTireMarkPoints.empty() && 0 == SDL_SetRenderTarget(mxSdlRenderer, tile.texture)) {
+			target_set = true;
+			SDL_SetRenderDrawColor(mxSdlRenderer, 0, 0, 0, 255); // black
+			SDL_RenderDrawPoints(mxSdlRenderer, &mTireMarkPoints[0], mTireMarkPoints.size());
+		}
+	}
+	if (target_set) {
+		SDL_SetRenderTarget(mxSdlRenderer, NULL);
 	}
+	mTireMarks.clear();
 }
 
-bool Race::draw() {
-	if (mSdlSurfaceFunctionIsDirty) {
-		if (NULL != mpSdlTextureCircuit) {
-			SDL_DestroyTexture(mpSdlTextureCircuit);
-			mpSdlTextureCircuit = NULL;
+// draw the tiles of the track that are inside the view, which is given in track coordinates
+void Race::drawTrack(const SDL_Rect & view) {
+	int size = mxTrackMap->getTileSize();
+	int tx0 = (view.x > 0 ? view.x / size : 0);
+	int ty0 = (view.y > 0 ? view.y / size : 0);
+	int tx1 = (view.x + view.w - 1) / size;
+	int ty1 = (view.y + view.h - 1) / size;
+	if (tx1 >= mxTrackMap->getTilesX()) tx1 = mxTrackMap->getTilesX() - 1;
+	if (ty1 >= mxTrackMap->getTilesY()) ty1 = mxTrackMap->getTilesY() - 1;
+
+	for (int ty = ty0; ty <= ty1; ++ty) {
+		for (int tx = tx0; tx <= tx1; ++tx) {
+			SDL_Texture * texture = getTileTexture(tx, ty);
+			if (NULL == texture) {
+				continue;
+			}
+			SDL_Rect src_rect;
+			src_rect.x = 0;
+			src_rect.y = 0;
+			src_rect.w = (mxTrackMap->getWidth()  - tx * size < size ? mxTrackMap->getWidth()  - tx * size : size);
+			src_rect.h = (mxTrackMap->getHeight() - ty * size < size ? mxTrackMap->getHeight() - ty * size : size);
+			SDL_Rect dest_rect;
+			dest_rect.x = tx * size - view.x;
+			dest_rect.y = ty * size - view.y;
+			dest_rect.w = src_rect.w;
+			dest_rect.h = src_rect.h;
+			SDL_RenderCopy(mxSdlRenderer, texture, &src_rect, &dest_rect);
 		}
-		mpSdlTextureCircuit = SDL_CreateTextureFromSurface(mxSdlRenderer, mpSdlSurfaceCircuit);
-		mSdlSurfaceFunctionIsDirty = false;
 	}
+}
 
-	SDL_Rect circ_rect;
-	circ_rect.w = mpSdlSurfaceCircuit->w;
-	circ_rect.h = mpSdlSurfaceCircuit->h;
-	circ_rect.x = 0;
-	circ_rect.y = 0;
-
-	SDL_RenderClear(mxSdlRenderer);
-	SDL_RenderCopy(mxSdlRenderer, mpSdlTextureCircuit, NULL, &circ_rect);
-
-	SDL_Rect car_rect;
-	car_rect.x = car.getPosX() - car.getLength()/2;
-	car_rect.y = car.getPosY() - car.getWidth()/2;
-	car_rect.w = car.getLength();
-	car_rect.h = car.getWidth();
+// draw the cars that are inside the view, which is given in track coordinates
+void Race::drawCars(const Camera::Rect & view) {
+	int count = mSimulation.getNumberOfCars();
+	mCarGridX.resize(count);
+	mCarGridY.resize(count);
+	float radius = 0;
+	for (int i = 0; i < count; ++i) {
+		const Car & car = mSimulation.getCar(i);
+		mCarGridX[i] = car.getPosX();
+		mCarGridY[i] = car.getPosY();
+		float r = ( car.getWidth() < car.getLength() ? car.getLength() : car.getWidth() ) / 2.0;
+		if (r > radius) radius = r;
+	}
+	mCarGrid.build(&mCarGridX[0], &mCarGridY[0], count, 4 * radius);
+	mCarGrid.query(view.x - radius, view.y - radius, view.x + view.w + radius, view.y + view.h + radius, mVisibleCars);
+
+	for (size_t v = 0; v < mVisibleCars.size(); ++v) {
+		int i = mVisibleCars[v];
+		Car & car = mSimulation.getCar(i);
+		const CarInput & input = mSimulation.getInput(i);
+
+		SDL_Rect car_rect;
+		car_rect.x = car.getPosX() - car.getLength()/2 - view.x;
+		car_rect.y = car.getPosY() - car.getWidth()/2 - view.y;
+		car_rect.w = car.getLength();
+		car_rect.h = car.getWidth();
+
+		int color = (i == miPlayerCar ? miCarId : car.color);
+		unsigned char car_angle = (unsigned char)(256 * car.getYaw() / 2.0 / M_PI) % 256;
+		SDL_Texture * & car_texture = mpaSdlTextureCars[color][car_angle];
+		if (NULL == car_texture) {
+			car_texture = SDL_CreateTextureFromSurface(mxSdlRenderer, mpaSdlSurfaceCars[color][car_angle]);
+		}
+		SDL_RenderCopy(mxSdlRenderer, car_texture, NULL, &car_rect);
 
-	unsigned char car_angle = (unsigned char)(256 * car.getYaw() / 2.0 / M_PI) % 256;
-	SDL_Texture  * car_texture = SDL_CreateTextureFromSurface(mxSdlRenderer, mpaSdlSurfaceCars[miCarId][car_angle]);
-	SDL_RenderCopy(mxSdlRenderer, car_texture, NULL, &car_rect);
-	if (NULL != car_texture) {
-		SDL_DestroyTexture (car_texture);
-		car_texture = NULL;
-	}
+		if ( true ) {
+			car.drawPositionLights(mxSdlRenderer, view.x, view.y);
+		}
 
-	if ( true ) {
-		car.drawPositionLights(mxSdlRenderer);
-	}
+		if ( (input.up_down > Simulation::JOY_AXIS_BRAKE_THRESHOLD) && car.getInertiaCoef() > 0.1 ) {
+			car.drawBrakeLights(mxSdlRenderer, view.x, view.y);
+		}
 
-	if ( (mUpDownJoyAxis > JOY_AXIS_BRAKE_THRESHOLD) && car.getInertiaCoef() > 0.1 ) {
-		car.drawBrakeLights(mxSdlRenderer);
-	}
+		if ( car.getInertiaCoef() < -0.1 ) {
+			car.drawReversingLights(mxSdlRenderer, view.x, view.y);
+		}
 
-	if ( car.getInertiaCoef() < -0.1 ) {
-		car.drawReversingLights(mxSdlRenderer);
+		if ( car.getInertiaCoef() >= -0.1 && car.getInertiaCoef() <= 0.1 && (SDL_GetTicks() % 800) > 400 ) {
+			car.drawWarningLights(mxSdlRenderer, view.x, view.y);
+		}
 	}
+}
 
-	if ( car.getInertiaCoef() >= -0.1 && car.getInertiaCoef() <= 0.1 && (SDL_GetTicks() % 800) > 400 ) {
-		car.drawWarningLights(mxSdlRenderer);
-	}
+bool Race::draw() {
+	PROFILE_SCOPE("Race::draw");
+	if (NULL == mxTrackData) {
+		return false;
+	}
+	++miFrame;
+
+	int screen_w, screen_h;
+	if (0 != SDL_GetRendererOutputSize(mxSdlRenderer, &screen_w, &screen_h)) {
+		screen_w = mxTrackMap->getWidth();
+		screen_h = mxTrackMap->getHeight();
+	}
+	mCamera.setViewport(screen_w, screen_h);
+	const Car & player = mSimulation.getCar(miPlayerCar);
+	mCamera.follow(player.getPosX(), player.getPosY());
+
+	// the renderer does the zoom, so everything is drawn in track units relative to the view
+	Camera::Rect visible = mCamera.getVisibleRect();
+	visible.x = floor(visible.x);
+	visible.y = floor(visible.y);
+	SDL_Rect view;
+	view.x = visible.x;
+	view.y = visible.y;
+	view.w = ceil(visible.w) + 1;
+	view.h = ceil(visible.h) + 1;
+
+	drawTireMarks();
+
+	SDL_RenderSetScale(mxSdlRenderer, mCamera.getZoom(), mCamera.getZoom());
+	SDL_SetRenderDrawColor(mxSdlRenderer, 0, 0, 0, 0);
+	SDL_RenderClear(mxSdlRenderer);
+	drawTrack(view);
+	trimTileTextures();
+	drawCars(visible);
+	SDL_RenderSetScale(mxSdlRenderer, 1.0, 1.0);
 
-	SDL_RenderPresent(mxSdlRenderer);
 	SDL_SetRenderDrawColor(mxSdlRenderer, 0, 0, 0, 0);
 
 	return true;
 }
 
-void Car::updateCheckpoints(int chkpnt) {
-	// if we are on the next checkpoint, validate it
-	if (chkpnt == last_checkpoint + 1) {
-		if (lapflag==3) { // If we validate a missed checkpoint
-			lapflag=4;
-		}
-		++last_checkpoint;
-	}
 
-	// if we missed a checkpoint
-	if ((chkpnt > last_checkpoint + 1) && (last_checkpoint != 0)) {
-		lapflag = 3;
-	}
 
-	// if we validate all and start over, we complete a turn
-	if (chkpnt == 0 && last_checkpoint == 31) { // reset turn variables
-		last_checkpoint = 0;
-		++lap;
-		lapflag = 1;
+unsigned int Race::update(unsigned int milliseconds, int * ticks, int * dropped) {
+	PROFILE_SCOPE("Race::update");
+	if (NULL != ticks) {
+		*ticks = 0;
 	}
-
-	// if we are at the start but not each checkpoint validate, it's an incomplete lap
-	if (chkpnt == 0 && chkpnt !=0 && last_checkpoint != 31 && last_checkpoint > 0) {
-		last_checkpoint = 0;
-		lapflag = 2;
+	if (NULL != dropped) {
+		*dropped = 0;
+	}
+	if (NULL == mxTrackData) {
+		return 0;
+	}
+	if (milliseconds > MAX_CATCH_UP_MS) {
+		unsigned int skipped = (milliseconds - MAX_CATCH_UP_MS) / Simulation::TICK_MS;
+		milliseconds -= skipped * Simulation::TICK_MS;
+		if (NULL != dropped) {
+			*dropped = skipped;
+		}
 	}
 
-	current_checkpoint = chkpnt;
-}
-
-void Race::moveCar(unsigned int milliseconds) {
-	Uint32 c;
-
-	// reset flags
-	car.crashflag=0;
-
-	float center_x = car.getPosX();
-	float center_y = car.getPosY();
-	Uint8 center_r, center_g, center_b;
+	int count = mSimulation.getNumberOfCars();
+	mFoci.resize(count);
+	for (int i = 0; i < count; ++i) {
+		const Car & car = mSimulation.getCar(i);
+		TileMap::Focus & focus = mFoci[i];
+		focus.x  = car.getPosX();
+		focus.y  = car.getPosY();
+		focus.dx = -cos(car.getYaw()) * car.getInertiaCoef();
+		focus.dy = -sin(car.getYaw()) * car.getInertiaCoef();
+	}
+	mxTrackMap->update(&mFoci[0], mFoci.size());
 
-	// get the pixel color under the center of car in the function map
-	c = sdlGetPixel(mpSdlSurfaceFunction, center_x, center_y);
+	mSimulation.getInput(miPlayerCar).up_down    = mUpDownJoyAxis;
+	mSimulation.getInput(miPlayerCar).left_right = mLeftRightJoyAxis;
 
-	// red layer = checkpoints; green layer = road quality; blue = map height
-	SDL_GetRGB(c, mpSdlSurfaceFunction->format, &center_r, &center_g, &center_b);
-
-	float angle  = car.getYaw();
-	float length = car.getLength();
-	float width  = car.getWidth();
-
-	float left_back_x = center_x + cos(angle) * length/3 - sin(angle)*3;
-	float left_back_y = center_y + sin(angle) * width/3 + cos(angle)*4;
-	c = sdlGetPixel(mpSdlSurfaceFunction, left_back_x, left_back_y);
-	Uint8 left_back_r, left_back_g, left_back_b;
-	SDL_GetRGB(c, mpSdlSurfaceFunction->format, &left_back_r, &left_back_g, &left_back_b);
-
-	float right_back_x = center_x + cos(angle) * length/3 + sin(angle)*3;
-	float right_back_y = center_y + sin(angle) * width/3 - cos(angle)*4;
-	c = sdlGetPixel(mpSdlSurfaceFunction, right_back_x, right_back_y);
-	Uint8 right_back_r, right_back_g, right_back_b;
-	SDL_GetRGB(c, mpSdlSurfaceFunction->format, &right_back_r, &right_back_g, &right_back_b);
-
-	float left_front_x = center_x - cos(angle) * length/3 - sin(angle)*4;
-	float left_front_y = center_y - sin(angle) * width/3 + cos(angle)*4;
-	c = sdlGetPixel(mpSdlSurfaceFunction, left_front_x, left_front_y);
-	Uint8 left_front_r, left_front_g, left_front_b;
-	SDL_GetRGB(c, mpSdlSurfaceFunction->format, &left_front_r, &left_front_g, &left_front_b);
-
-	float right_front_x = center_x - cos(angle) * length/3 + sin(angle)*4;
-	float right_front_y = center_y - sin(angle) * width/3 - cos(angle)*4;
-	c = sdlGetPixel(mpSdlSurfaceFunction, right_front_x, right_front_y);
-	Uint8 right_front_r, right_front_g, right_front_b;
-	SDL_GetRGB(c, mpSdlSurfaceFunction->format, &right_front_r, &right_front_g, &right_front_b);
-
-	float pitch_m = ( ( left_front_b + right_front_b - left_back_b - right_back_b ) * Z_UNIT_TO_M ) / ( ( 2.0 * length ) * XY_UNIT_TO_M );
-	float roll_m  = ( ( left_front_b + left_back_b - right_front_b - right_back_b)  * Z_UNIT_TO_M ) / ( ( 2.0 * width) * XY_UNIT_TO_M );
-	float pitch   = atan( pitch_m );
-	float roll    = atan( roll_m );
-
-	car.setZ(center_b, pitch, roll);
-
-	car.incYaw( roll_m * car.getInertiaCoef() * 0.05 );
-	car.incInertiaCoef( -pitch_m * 0.01 );
-
-	if (mUpDownJoyAxis < -JOY_AXIS_MIN_THRESHOLD) {
-		car.incInertiaCoef( (-mUpDownJoyAxis) * 0.01 * 2. );
-	}
-	if (mUpDownJoyAxis > JOY_AXIS_MIN_THRESHOLD) {
-		car.decInertiaCoef( mUpDownJoyAxis * 0.01 );
-	}
-	if (mLeftRightJoyAxis < -JOY_AXIS_MIN_THRESHOLD) {
-		car.turnLeft( (-mLeftRightJoyAxis) * 0.02 );
-	}
-	if (mLeftRightJoyAxis > JOY_AXIS_MIN_THRESHOLD) {
-		car.turnRight( mLeftRightJoyAxis * 0.02 );
-	}
-
-	// update the inertia_coef depending on the road quality
-	float average_g = ( left_back_g + right_back_g + left_front_g + right_front_g ) / 4.0 ;
-	car.decInertiaCoefByFactor( (255 - average_g) / 1000. );
-
-	// if it is a wall we move back to the last position
-	if ( 0 == center_g || 0 == left_back_g || 0 == right_back_g || 0 == left_front_g || 0 == right_front_g ) {
-		car.restorePosition();
-		car.crashflag=1;
-	}
-
-	// save the old position and compute the new one
-	car.backupPosition();
-	car.computeNewPosition(milliseconds);
-
-	// collision with the border of the screen
-	float radius = ( car.getWidth() < car.getLength() ? car.getLength() : car.getWidth() ) / 2.0;
-	if (
-		car.getPosX() < radius ||
-		car.getPosX() > mpSdlSurfaceFunction->w - radius ||
-		car.getPosY() < radius ||
-		car.getPosY() > mpSdlSurfaceFunction->h - radius
-	) {
-		car.restorePosition();
-		car.setInertiaCoef(0);
-		car.crashflag = 1;
-	}
-
-	car.updateCheckpoints(center_r/8);
-
-	if (
-		( car.getInertiaCoef()>0.5 && (mUpDownJoyAxis > JOY_AXIS_BRAKE_THRESHOLD) ) ||
-		( car.getInertiaCoef()>2.0 && !(mUpDownJoyAxis < -JOY_AXIS_MIN_THRESHOLD) )
-	) { // if the car is fast or braking, it slides
-		if (show_tires) { // display tires slide
-
-			float x = car.getPosX();
-			float y = car.getPosY();
-			float w = car.getLength();
-			float h = car.getWidth();
-			float angle = car.getYaw();
-			float cos_a = cos(angle);
-			float sin_a = sin(angle);
-
-			sdlPutPixel( mpSdlSurfaceCircuit,
-				x + cos_a * w/3 - sin_a*4,
-				y + sin_a * h/3 + cos_a*4,
-				SDL_MapRGB(mpSdlSurfaceCircuit->format,0,0,0) // black
-			);
-			sdlPutPixel(mpSdlSurfaceCircuit,
-				x + cos_a * w/3 + sin_a*4,
-				y + sin_a * h/3 - cos_a*4,
-				SDL_MapRGB(mpSdlSurfaceCircuit->format,0,0,0) // black
-			);
-			if (mUpDownJoyAxis > JOY_AXIS_BRAKE_THRESHOLD) { // if we are braking the slide is larger
-				sdlPutPixel(mpSdlSurfaceCircuit,
-					x + cos_a * w/3 - sin_a*3,
-					y + sin_a * h/3 + cos_a*3,
-					SDL_MapRGB(mpSdlSurfaceCircuit->format,0,0,0) // black
-				);
-				sdlPutPixel(mpSdlSurfaceCircuit,
-					x + cos_a * w/3 + sin_a*3,
-					y + sin_a * h/3 - cos_a*3,
-					SDL_MapRGB(mpSdlSurfaceCircuit->format,0,0,0) // black
-				);
+	while ( milliseconds > Simulation::TICK_MS ) {
+		if (!mDrivenCars.empty()) {
+			mxDriver->drive(mSimulation, &mDrivenCars[0], mDrivenCars.size(), &ThreadPool::getDefault());
+		}
+		mSimulation.tick(&ThreadPool::getDefault());
+		for (int i = 0; i < count; ++i) {
+			Car & car = mSimulation.getCar(i);
+			if (show_tires && car.slideflag) {
+				addTireMarks(car);
+			}
+			if (miPlayerCar != i && (1 == car.lapflag || 2 == car.lapflag)) {
+				car.lapflag = 0;
 			}
-			mSdlSurfaceFunctionIsDirty = true;
 		}
-	}
-
-	car.updateTimer(milliseconds);
-}
 
-unsigned int Race::update(unsigned int milliseconds) {
-	while ( milliseconds > 8 ) {
-		moveCar(8);
+		Car & car = mSimulation.getCar(miPlayerCar);
 		switch (car.lapflag) {
 			case 1: // if we completed a lap
 				printInfoLog("Lap Complete");
@@ -571,11 +567,35 @@ unsigned int Race::update(unsigned int milliseconds) {
 			default: // nothing
 				break;
 		}
-		milliseconds -= 8;
+		mTelemetry.publish(mSimulation, miTrackId, miPlayerCar);
+		mSharedTelemetry.write(mTelemetry.getPublished());
+		mTelemetryServer.notify();
+		mRecorder.record(mSimulation);
+		milliseconds -= Simulation::TICK_MS;
+		if (NULL != ticks) {
+			++*ticks;
+		}
 	}
 	return milliseconds;
 }
 
+// recordings/<track>-<date>-<time>.ctl, see TelemetryLog.h
+void Race::toggleRecording() {
+	if (mRecorder.isRecording()) {
+		mRecorder.stop();
+		return;
+	}
+	if (NULL == mxTrackMap) {
+		return;
+	}
+	mkdir(RECORDINGS_DIR, 0755);
+	char date[32];
+	time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y%m%d-%H%M%S", localtime(&now));
+	std::string filename = std::string(RECORDINGS_DIR "/") + mTrackCatalog.get(miTrackId).filename + "-" + date + ".ctl";
+	mRecorder.start(filename.c_str(), mSimulation, miTrackId, true);
+}
+
 static void printModifiers(Uint16 mod) {
 	printf( "Modifers: " );
 
@@ -640,7 +660,20 @@ bool Race::eventHandlerKeyboard(SDL_Event & event) {
 		case SDL_KEYUP: {
 			switch (event.key.keysym.sym) {
 				case SDLK_SPACE:
-					car.togglePositionLights();
+					mSimulation.getCar(miPlayerCar).togglePositionLights();
+					break;
+				case SDLK_r:
+					toggleRecording();
+					break;
+				case SDLK_c:
+				case SDLK_HOME: // back to following the car
+					mCamera.setMode(Camera::MODE_FOLLOW);
+					break;
+				case SDLK_PAGEUP:
+					mCamera.zoomBy(1.25, miMouseX, miMouseY);
+					break;
+				case SDLK_PAGEDOWN:
+					mCamera.zoomBy(0.8, miMouseX, miMouseY);
 					break;
 				case SDLK_UP:
 					mUpKey = false;
@@ -676,6 +709,11 @@ bool Race::eventHandlerMouse(SDL_Event & event) {
 			//	event.motion.xrel,
 			//	event.motion.yrel
 			//);
+			if (mbDragging) { // xrel and yrel are not always available
+				mCamera.pan(event.motion.x - miMouseX, event.motion.y - miMouseY);
+			}
+			miMouseX = event.motion.x;
+			miMouseY = event.motion.y;
 			return true;
 		}
 
@@ -687,6 +725,9 @@ bool Race::eventHandlerMouse(SDL_Event & event) {
 			//	event.button.x,
 			//	event.button.y
 			//);
+			mbDragging = (SDL_MOUSEBUTTONDOWN == event.type);
+			miMouseX = event.button.x;
+			miMouseY = event.button.y;
 			return true;
 		}
 
@@ -696,6 +737,11 @@ bool Race::eventHandlerMouse(SDL_Event & event) {
 			//	event.wheel.x,
 			//	event.wheel.y
 			//);
+			if (event.wheel.y > 0) {
+				mCamera.zoomBy(1.25, miMouseX, miMouseY);
+			} else if (event.wheel.y < 0) {
+				mCamera.zoomBy(0.8, miMouseX, miMouseY);
+			}
 			return true;
 		}
 
@@ -763,22 +809,26 @@ bool Race::eventHandlerUser(SDL_Event & event) {
 }
 
 bool Race::getInfo(void * dest, unsigned int type, intptr_t param) {
+	if (NULL == mxTrackData || 0 == mSimulation.getNumberOfCars()) {
+		return false;
+	}
+	const Car & car = mSimulation.getCar(miPlayerCar);
 	switch (type) {
 		case INFO_NONE: {
 			return true;
 		}
 		case INFO_POSITION_3F: {
 			float * f = (float*)dest;
-			f[0] = car.getPosX() * XY_UNIT_TO_M;
-			f[1] = car.getPosY() * XY_UNIT_TO_M;
-			f[2] = car.getPosZ() * Z_UNIT_TO_M;
+			f[0] = car.getPosX() * Simulation::XY_UNIT_TO_M;
+			f[1] = car.getPosY() * Simulation::XY_UNIT_TO_M;
+			f[2] = car.getPosZ() * Simulation::Z_UNIT_TO_M;
 			return true;
 		}
 		case INFO_SPEED_3F: {
 			float * f = (float*)dest;
-			f[0] = car.getSpeedX() * XY_UNIT_TO_M;
-			f[1] = car.getSpeedY() * XY_UNIT_TO_M;
-			f[2] = car.getSpeedZ() * Z_UNIT_TO_M;
+			f[0] = car.getSpeedX() * Simulation::XY_UNIT_TO_M;
+			f[1] = car.getSpeedY() * Simulation::XY_UNIT_TO_M;
+			f[2] = car.getSpeedZ() * Simulation::Z_UNIT_TO_M;
 			return true;
 		}
 		case INFO_ANGLES_3F: {
@@ -794,6 +844,29 @@ bool Race::getInfo(void * dest, unsigned int type, intptr_t param) {
 			i[1] = car.getLastCheckpoint();
 			return true;
 		}
+		case INFO_STANDING_2I: {
+			int * i = (int*)dest;
+			i[0] = mSimulation.getStanding(miPlayerCar) + 1;
+			i[1] = mSimulation.getNumberOfCars();
+			return true;
+		}
+		case INFO_PROGRESS_3F: {
+			float * f = (float*)dest;
+			f[0] = car.getProgress() * Simulation::XY_UNIT_TO_M;
+			f[1] = mxTrackMap->getLapLength() * Simulation::XY_UNIT_TO_M;
+			f[2] = mSimulation.getGapTime(miPlayerCar);
+			return true;
+		}
+		case INFO_LIDAR_32F: {
+			float * f = (float*)dest;
+			if (Lidar::DEFAULT_RAYS != mSimulation.getLidarRays() || !mSimulation.scanLidar(miPlayerCar, f)) {
+				return false;
+			}
+			for (int i = 0; i < Lidar::DEFAULT_RAYS; ++i) {
+				f[i] *= Simulation::XY_UNIT_TO_M;
+			}
+			return true;
+		}
 		default:
 			return false;
 	}
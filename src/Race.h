@@ -19,225 +19,44 @@
 #ifndef RACE_H_A71ADAE4_6CB3_11E4_93E0_10FEED04CD1C
 #define RACE_H_A71ADAE4_6CB3_11E4_93E0_10FEED04CD1C
 
+#include "Car.h"
+#include "Simulation.h"
+#include "PursuitDriver.h"
+#include "NeuralDriver.h"
+#include "Telemetry.h"
+#include "SharedTelemetry.h"
+#include "TelemetryServer.h"
+#include "TelemetryRecorder.h"
+#include "TrackCatalog.h"
+#include "TrackCache.h"
+#include "Camera.h"
+#include "SpatialGrid.h"
+
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 
 #include <stdint.h>
 #include <cmath>
-
-#ifndef M_PI
-#define M_PI 3.141592654
-#endif
-
-class Car {
-public:
-	int lap;
-	int lapflag;
-	int crashflag;
-	int color;
-
-	Car() {
-	}
-
-	void resetTimer() {
-		global_time_ms = 0;
-		inc_time_ms    = 0;
-	}
-	void setSize(int l, int w) {
-		length        = l;
-		width         = w;
-	}
-	void setPosition(float x, float y, float azimut) {
-		now.pos_x     = x;
-		now.pos_y     = y;
-		now.ang_yaw   = azimut;
-	}
-	void setZ(float z, float pitch, float roll) {
-		now.pos_z     = z;
-		now.ang_pitch = pitch;
-		now.ang_roll  = roll;
-	}
-	void computeNewPosition(unsigned int milliseconds) {
-		inertia_coef *= 0.995;
-		now.pos_x -= cos(now.ang_yaw) * inertia_coef;
-		now.pos_y -= sin(now.ang_yaw) * inertia_coef;
-	}
-	void incYaw(float ch) {
-		now.ang_yaw += ch;
-		fixAngles();
-	}
-	void turnLeft(float ch) {
-		if (inertia_coef < 0) {
-			now.ang_yaw += ch;
-		} else {
-			now.ang_yaw -= ch;
-		}
-		fixAngles();
-	}
-	void turnRight(float ch) {
-		if (inertia_coef < 0) {
-			now.ang_yaw -= ch;
-		} else {
-			now.ang_yaw += ch;
-		}
-		fixAngles();
-	}
-	void setInertiaCoef(float s) {
-		inertia_coef = s;
-	}
-	void incInertiaCoef(float is) {
-		inertia_coef += is ;
-	}
-	void decInertiaCoef(float ds) {
-		inertia_coef -= ds ;
-	}
-	void decInertiaCoefByFactor(float fs) {
-		inertia_coef -= inertia_coef * fs;
-	}
-	void backupPosition() {
-		before = now;
-	}
-	void restorePosition() {
-		now = before;
-	}
-	float getPosX() {
-		return now.pos_x;
-	}
-	float getPosY() {
-		return now.pos_y;
-	}
-	float getPosZ() {
-		return now.pos_z;
-	}
-	float getSpeedX() {
-		return now.spd_x;
-	}
-	float getSpeedY() {
-		return now.spd_y;
-	}
-	float getSpeedZ() {
-		return now.spd_z;
-	}
-	float getWidth() {
-		return width;
-	}
-	float getLength() {
-		return length;
-	}
-	float getYaw() {
-		return now.ang_yaw;
-	}
-	float getPitch() {
-		return now.ang_pitch;
-	}
-	float getRoll() {
-		return now.ang_roll;
-	}
-	int getCurrentCheckpoint() {
-		return current_checkpoint;
-	}
-	int getLastCheckpoint() {
-		return last_checkpoint;
-	}
-	void cleanCheckpoints() {
-		current_checkpoint = 0;
-		last_checkpoint = 0;
-	}
-	float getInertiaCoef() {
-		return inertia_coef;
-	}
-	unsigned int getTimer() {
-		return global_time_ms;
-	}
-	void togglePositionLights() {
-		position_lights = !position_lights;
-	}
-
-	void updateCheckpoints(int cp);
-	void updateTimer(unsigned int milliseconds);
-	void drawBrakeLights(SDL_Renderer * renderer);
-	void drawReversingLights(SDL_Renderer * renderer);
-	void drawWarningLights(SDL_Renderer * renderer);
-	void drawPositionLights(SDL_Renderer * renderer);
-
-private:
-	void fixAngles() { // limit angle between 0 and 2*pi
-		if ( now.ang_yaw < 0. ) {
-			now.ang_yaw += 2. * M_PI;
-		}
-		if ( now.ang_yaw > 2. * M_PI ) {
-			now.ang_yaw -= 2. * M_PI;
-		}
-	}
-
-	static void drawRawLight(SDL_Renderer * renderer, int x, int y, int r);
-
-	int length;
-	int width;
-
-	struct State {
-		float pos_x;
-		float pos_y;
-		float pos_z;
-		float spd_x;
-		float spd_y;
-		float spd_z;
-		float acc_x;
-		float acc_y;
-		float acc_z;
-
-		float ang_yaw; // rotation around vertical axis
-		float ang_pitch; // rotation around axis orthogonal to movement
-		float ang_roll; // rotation around axis in direction of movement
-
-		State() :
-			pos_x(0),
-			pos_y(0),
-			pos_z(0),
-			spd_x(0),
-			spd_y(0),
-			spd_z(0),
-			acc_x(0),
-			acc_y(0),
-			acc_z(0),
-			ang_yaw(0),
-			ang_pitch(0),
-			ang_roll(0)
-		{
-		}
-	};
-
-	State now;
-	State before;
-
-	int current_checkpoint;
-	int last_checkpoint;
-
-	float inertia_coef;
-	bool position_lights;
-	unsigned int global_time_ms;
-	unsigned int inc_time_ms;
-};
-
-struct Track {
-	const char *filename;
-	int start_x;
-	int start_y;
-	int start_a;
-	const char *name;
-	const char *author;
-};
+#include <vector>
 
 class Race {
 public:
 	Race();
 	~Race();
 
-	bool draw();
-	unsigned int update(unsigned int milliseconds);
+	bool draw(); // false if there is nothing to draw; the caller presents it
+	// simulates milliseconds, of which at most MAX_CATCH_UP_MS after a stall, and
+	// returns what is left for the next time; the ticks run and those dropped go to
+	// ticks and dropped, if given
+	unsigned int update(unsigned int milliseconds, int * ticks = NULL, int * dropped = NULL);
 
 	void setUp(SDL_Renderer * renderer);
-	void startTrack(int id);
+	void tearDown();
+	bool startTrack(int id);
+	int getNumberOfTracks() const {
+		return mTrackCatalog.size();
+	}
+	void setNumberOfCars(int n); // applied when the next track starts
 
 	bool eventHandlerKeyboard(SDL_Event & event);
 	bool eventHandlerMouse(SDL_Event & event);
@@ -245,19 +64,22 @@ public:
 	bool eventHandlerUser(SDL_Event & event);
 
 	bool getInfo(void * dest, unsigned int type, intptr_t param);
+	const TelemetryChannel & getTelemetry() const {
+		return mTelemetry;
+	}
 
 private:
 	static const size_t MAXLINELENGTH = 80;
 	static const int DELAY = 7;
 	static const int NB_CARS = 16;
-	static const int MAX_TRACKS = 16;
+	static const size_t TRACK_CACHE_BYTES = 64 * 1024 * 1024;
+	static const size_t STREAMED_TRACK_BYTES = 32 * 1024 * 1024;
+	static const int MAX_TILE_TEXTURES = 64;
+	static const unsigned int MAX_CATCH_UP_MS = 250; // else the frames get longer and longer catching up
 
 	static const int SCREEN_WIDTH  = 1024;
 	static const int SCREEN_HEIGHT = 768;
 
-	static const float XY_UNIT_TO_M = 0.01;
-	static const float  Z_UNIT_TO_M = 0.01;
-
 	// SDL interprets each pixel as a 32-bit number, so our masks must depend on the endianness (byte order) of the machine
 #if SDL_BYTEORDER == SDL_BIG_ENDIAN
 	static const Uint32 RMASK = 0xff000000;
@@ -273,21 +95,63 @@ private:
 
 	SDL_Renderer * mxSdlRenderer;
 
-	SDL_Texture * mpSdlTextureCircuit;
-	SDL_Surface * mpSdlSurfaceCircuit;
-	SDL_Surface * mpSdlSurfaceFunction;
-	bool mSdlSurfaceFunctionIsDirty;
-
 	int miTrackId;
-	static const Track track[MAX_TRACKS];
+	TrackCatalog mTrackCatalog;
+	TrackCache mTrackCache;
+	TrackData * mxTrackData;
+	TileMap * mxTrackMap;
+
+	struct TileTexture {
+		SDL_Texture * texture; // the tire marks are drawn on it, the cached track is never modified
+		unsigned int last_frame;
+		std::vector<uint8_t> marks; // a bit per pixel of the tire marks, kept without the texture
+	};
+
+	struct TireMark {
+		int tile;
+		int pixel; // y * tile size + x
+		bool operator<(const TireMark & other) const {
+			return tile < other.tile || (tile == other.tile && pixel < other.pixel);
+		}
+	};
+
+	std::vector<TileTexture> mTileTextures; // one per display tile, created when first visible
+	int miTileTextureCount;
+	unsigned int miFrame;
+	std::vector<TireMark> mTireMarks;      // added to the tiles in the next frame
+	std::vector<SDL_Point> mTireMarkPoints; // new ones of a tile, drawn at once
+	std::vector<uint8_t> mTilePixels;      // of a tile with its marks, for its texture
+
+	Simulation mSimulation;
+	PursuitDriver mPursuitDriver;
+	NeuralDriver mNeuralDriver;  // instead of the other one, if there is a policy
+	Controller * mxDriver;
+	std::vector<int> mDrivenCars; // all of them but the player's
+	TelemetryChannel mTelemetry;  // published after every tick
+	SharedTelemetry mSharedTelemetry; // and exported to the other processes
+	TelemetryServer mTelemetryServer; // and streamed to the viewers
+	TelemetryRecorder mRecorder;  // toggled with R, until the track changes
 
 	int miCarId;
-	Car car;
+	int miNumberOfCars;
+	int miPlayerCar;
 	bool show_tires;
 	SDL_Surface * mpaSdlSurfaceCars[NB_CARS][256];
+	SDL_Texture * mpaSdlTextureCars[NB_CARS][256]; // created the first time they are drawn
+
+	Camera mCamera;
+	SpatialGrid mCarGrid;
+	std::vector<float> mCarGridX;
+	std::vector<float> mCarGridY;
+	std::vector<int> mVisibleCars;
+	std::vector<TileMap::Focus> mFoci;
+
+	int miCarBodyLength; // of the unrotated sprites
+	int miCarBodyWidth;
 
-	static const float JOY_AXIS_MIN_THRESHOLD = 0.01;
-	static const float JOY_AXIS_BRAKE_THRESHOLD = 0.9;
+	bool mbDragging;
+	int miMouseX;
+	int miMouseY;
 
 	float mLeftRightJoyAxis;
 	float mUpDownJoyAxis;
@@ -298,7 +162,17 @@ private:
 	bool mRightKey;
 
 	void generateCars();
-	void moveCar(unsigned int milliseconds);
+	void placeCars(const Track & track);
+	void toggleRecording();
+	void releaseCarTextures();
+	SDL_Texture * getTileTexture(int tx, int ty);
+	void trimTileTextures();
+	void releaseTileTextures();
+	void drawTrack(const SDL_Rect & view);
+	void drawTireMarks();
+	void addTireMark(float x, float y);
+	void addTireMarks(const Car & car);
+	void drawCars(const Camera::Rect & view);
 	void darkenTrack(SDL_Surface * surface, float coef = 0.3);
 };
 
@@ -1,7 +1,13 @@
 #include "Sdl2App.h"
 #include "Threads.h"
+#include "Profiler.h"
+
+#include <time.h>
 
 #define LOGO_BMP "data/sdl_logo.bmp"
+#define PROFILE_PATTERN "profile-%Y%m%d-%H%M%S.json" // written with F12
+#define PERF_OVERLAY_X 8    // toggled with F11
+#define PERF_OVERLAY_Y 8
 
 struct Sdl2AppThread : public ThreadBase {
 	Sdl2AppThread(Sdl2App * app) : App(app), KeepRunning(true) {
@@ -86,9 +92,12 @@ void Sdl2App::init(SDL_Window * sdl_window, int w, int h) {
 	mRace.startTrack(12);
 
 	miLastUpdateTime = SDL_GetTicks();
+	miLastFrameTime = 0;
 }
 
 void Sdl2App::destroy() {
+	mRace.tearDown();
+
 	if (NULL != mpSdlImage) {
 		SDL_FreeSurface (mpSdlImage);
 		mpSdlImage = NULL;
@@ -106,6 +115,8 @@ void Sdl2App::destroy() {
 }
 
 void Sdl2App::draw() {
+	PROFILE_SCOPE("Sdl2App::draw");
+	int64_t begin = Profiler::now();
 	if (!mRace.draw()) {
 		SDL_Rect dest_rect;
 		dest_rect.w = mpSdlImage->w;
@@ -115,20 +126,30 @@ void Sdl2App::draw() {
 
 		SDL_RenderClear(mpSdlRenderer);
 		SDL_RenderCopy(mpSdlRenderer, mpSdlTexture, NULL, &dest_rect);
-		SDL_RenderPresent(mpSdlRenderer);
 	}
+	mPerfOverlay.draw(mpSdlRenderer, PERF_OVERLAY_X, PERF_OVERLAY_Y);
+	SDL_RenderPresent(mpSdlRenderer);
+	int64_t end = Profiler::now();
+	if (0 != miLastFrameTime) {
+		mPerfOverlay.addFrame(begin - miLastFrameTime, end - begin);
+	}
+	miLastFrameTime = begin;
 
 	int delta = SDL_GetTicks() - miStartClock;
 	miStartClock = SDL_GetTicks();
 	if (delta != 0) {
 		mfFramesPerSecond = 1000.0 / delta;
-		//printf("%2.2f fps\n", mfFramesPerSecond);
+		PROFILE_COUNTER("fps", mfFramesPerSecond);
 	}
 }
 
 void Sdl2App::update() {
+	PROFILE_SCOPE("Sdl2App::update");
 	Uint32 current_time = SDL_GetTicks();
-	unsigned int pending = mRace.update(current_time - miLastUpdateTime);
+	int ticks, dropped;
+	int64_t begin = Profiler::now();
+	unsigned int pending = mRace.update(current_time - miLastUpdateTime, &ticks, &dropped);
+	mPerfOverlay.addUpdate(Profiler::now() - begin, ticks, dropped);
 	miLastUpdateTime = current_time - pending;
 }
 
@@ -136,7 +157,12 @@ bool Sdl2App::getInfo(void * dest, unsigned int type, intptr_t param) {
 	return mRace.getInfo(dest, type, param);
 }
 
+const TelemetryChannel & Sdl2App::getTelemetry() const {
+	return mRace.getTelemetry();
+}
+
 void Sdl2App::processEvents() {
+	PROFILE_SCOPE("Sdl2App::processEvents");
 	SDL_Event event;
 	while ( SDL_PollEvent( &event ) ) {
 			eventHandler(event);
@@ -157,6 +183,14 @@ bool Sdl2App::eventHandler(SDL_Event & event) {
 
 		case SDL_KEYDOWN:
 		case SDL_KEYUP:
+			if (SDL_KEYUP == event.type && SDLK_F12 == event.key.keysym.sym) {
+				dumpProfile();
+				return true;
+			}
+			if (SDL_KEYUP == event.type && SDLK_F11 == event.key.keysym.sym) {
+				mPerfOverlay.toggle();
+				return true;
+			}
 			return mRace.eventHandlerKeyboard(event);
 
 		case SDL_WINDOWEVENT:
@@ -264,6 +298,13 @@ void Sdl2App::releaseInputGrab() {
 	mbInputGrabRequested = false;
 }
 
+void Sdl2App::dumpProfile() {
+	char filename[64];
+	time_t now = time(NULL);
+	strftime(filename, sizeof(filename), PROFILE_PATTERN, localtime(&now));
+	Profiler::dump(filename);
+}
+
 void Sdl2App::processTextInput(const char *str, int len) {
 }
 
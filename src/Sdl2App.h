@@ -3,6 +3,7 @@
 
 #include "ISdl2App.h"
 #include "Race.h"
+#include "PerfOverlay.h"
 
 #include <SDL2/SDL.h>
 #include <stdint.h>
@@ -24,6 +25,7 @@ class Sdl2App : public ISdl2App {
 		virtual void processEvents();
 
 		virtual bool getInfo(void * dest, unsigned int type, intptr_t param);
+		virtual const TelemetryChannel & getTelemetry() const;
 
 	protected:
 		bool eventHandler(SDL_Event & event);
@@ -34,6 +36,7 @@ class Sdl2App : public ISdl2App {
 		void processTextInput(const char *str, int len);
 		void processKeyboardKey(int code, bool isdown);
 		void processQuitRequest();
+		void dumpProfile();
 
 	private:
 		SDL_Window   * mxSdlWindow;
@@ -43,6 +46,7 @@ class Sdl2App : public ISdl2App {
 		SDL_Texture * mpSdlTexture;
 
 		Race mRace;
+		PerfOverlay mPerfOverlay;
 
 		int miScreenWidth;
 		int miScreenHeight;
@@ -58,6 +62,7 @@ class Sdl2App : public ISdl2App {
 		float mfFramesPerSecond;
 
 		Uint32 miLastUpdateTime;
+		int64_t miLastFrameTime; // ns, for the overlay
 
 		Sdl2AppThread * mpThread;
 
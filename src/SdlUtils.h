@@ -0,0 +1,81 @@
+#ifndef SDLUTILS_H_81E73200_0CA8_11E4_80BB_10FEED04CD1C
+#define SDLUTILS_H_81E73200_0CA8_11E4_80BB_10FEED04CD1C
+
+#include <SDL2/SDL.h>
+
+// 32-bit pixel format whose bytes are stored in memory as R, G, B, A
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+#define SDL_PIXELFORMAT_RGBA_BYTES SDL_PIXELFORMAT_RGBA8888
+#else
+#define SDL_PIXELFORMAT_RGBA_BYTES SDL_PIXELFORMAT_ABGR8888
+#endif
+
+/*
+ * Return the pixel value at (x, y)
+ * NOTE: The surface must be locked before calling this!
+ */
+static inline Uint32 sdlGetPixel(SDL_Surface *surface, int x, int y) {
+	int bpp = surface->format->BytesPerPixel;
+	// Here p is the address to the pixel we want to retrieve
+	Uint8 *p = (Uint8 *)surface->pixels + y * surface->pitch + x * bpp;
+
+	switch(bpp) {
+		case 1:
+			return *p;
+		case 2:
+			return *(Uint16 *)p;
+		case 3:
+			if(SDL_BYTEORDER == SDL_BIG_ENDIAN)
+				return p[0] << 16 | p[1] << 8 | p[2];
+			else
+				return p[0] | p[1] << 8 | p[2] << 16;
+		case 4:
+			return *(Uint32 *)p;
+		default:
+			return 0; // shouldn't happen, but avoids warnings
+    }
+}
+
+/*
+ * Set the pixel at (x, y) to the given value
+ * NOTE: The surface must be locked before calling this!
+ */
+static inline void sdlPutPixel(SDL_Surface *surface, int x, int y, Uint32 pixel) {
+	int bpp = surface->format->BytesPerPixel;
+	// Here p is the address to the pixel we want to set
+	Uint8 *p = (Uint8 *)surface->pixels + y * surface->pitch + x * bpp;
+
+	switch(bpp) {
+		case 1:
+			*p = pixel;
+			break;
+		case 2:
+			*(Uint16 *)p = pixel;
+			break;
+		case 3:
+			if(SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+				p[0] = (pixel >> 16) & 0xff;
+				p[1] = (pixel >> 8) & 0xff;
+				p[2] = pixel & 0xff;
+			} else {
+				p[0] = pixel & 0xff;
+				p[1] = (pixel >> 8) & 0xff;
+				p[2] = (pixel >> 16) & 0xff;
+			}
+			break;
+		case 4:
+			*(Uint32 *)p = pixel;
+			break;
+		default:
+			return; // shouldn't happen, but avoids warnings
+	}
+}
+
+/*
+ * Approximate memory used by the pixels of a surface
+ */
+static inline size_t sdlSurfaceBytes(const SDL_Surface *surface) {
+	return (NULL != surface ? (size_t)surface->pitch * surface->h : 0);
+}
+
+#endif // SDLUTILS_H_81E73200_0CA8_11E4_80BB_10FEED04CD1C
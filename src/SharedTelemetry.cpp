@@ -0,0 +1,104 @@
+#include "SharedTelemetry.h"
+#include "Common.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+SharedTelemetry::SharedTelemetry() :
+	mpHeader(NULL),
+	mpaSlots(NULL),
+	miSize(0)
+{
+	maName[0] = '\0';
+}
+
+SharedTelemetry::~SharedTelemetry() {
+	close();
+}
+
+bool SharedTelemetry::open(const char * name) {
+	close();
+
+	// a segment left by a game that crashed is reused, with the header written again,
+	// but not the one of another game that is running
+	int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		printWarningLog("Can't create the shared memory %s: %s", name, strerror(errno));
+		return false;
+	}
+	TelemetryShmHeader old;
+	if (
+		pread(fd, &old, sizeof(old), 0) == (ssize_t)sizeof(old) &&
+		old.writer_pid > 0 && 0 == kill(old.writer_pid, 0)
+	) {
+		printWarningLog("The telemetry is already exported by the process %d", old.writer_pid);
+		::close(fd);
+		return false;
+	}
+	size_t header_size = (sizeof(TelemetryShmHeader) + 63) & ~(size_t)63;
+	size_t size = header_size + TELEMETRY_SHM_SLOTS * sizeof(TelemetryShmSlot);
+	if (ftruncate(fd, size) != 0) {
+		printWarningLog("Can't resize the shared memory %s: %s", name, strerror(errno));
+		::close(fd);
+		shm_unlink(name);
+		return false;
+	}
+	void * mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (MAP_FAILED == mapping) {
+		printWarningLog("Can't map the shared memory %s: %s", name, strerror(errno));
+		shm_unlink(name);
+		return false;
+	}
+	memset(mapping, 0, size);
+
+	mpHeader = static_cast<TelemetryShmHeader *>(mapping);
+	mpaSlots = reinterpret_cast<TelemetryShmSlot *>(static_cast<char *>(mapping) + header_size);
+	miSize = size;
+	strncpy(maName, name, sizeof(maName) - 1);
+	maName[sizeof(maName) - 1] = '\0';
+
+	mpHeader->version = TELEMETRY_SHM_VERSION;
+	mpHeader->header_size = header_size;
+	mpHeader->slot_size = sizeof(TelemetryShmSlot);
+	mpHeader->slots = TELEMETRY_SHM_SLOTS;
+	mpHeader->writer_pid = getpid();
+	// the magic last, for the readers that open it meanwhile
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(mpHeader->magic, TELEMETRY_SHM_MAGIC, sizeof(mpHeader->magic));
+	return true;
+}
+
+void SharedTelemetry::close() {
+	if (NULL == mpHeader) {
+		return;
+	}
+	__atomic_store_n(&mpHeader->writer_pid, 0, __ATOMIC_RELEASE);
+	munmap(mpHeader, miSize);
+	shm_unlink(maName); // the readers that have it mapped keep it
+	mpHeader = NULL;
+	mpaSlots = NULL;
+	miSize = 0;
+}
+
+void SharedTelemetry::write(const TelemetryFrame & frame) {
+	if (NULL == mpHeader) {
+		return;
+	}
+	uint64_t n = mpHeader->frames;
+	TelemetryShmSlot & slot = mpaSlots[n % TELEMETRY_SHM_SLOTS];
+	__atomic_store_n(&slot.sequence, (uint32_t)(2 * n + 1), __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	int count = std::min(std::max(frame.car_count, 0), (int)TelemetryFrame::MAX_CARS);
+	memcpy(&slot.frame, &frame, offsetof(TelemetryFrame, cars) + count * sizeof(CarTelemetry));
+
+	__atomic_store_n(&slot.sequence, (uint32_t)(2 * n + 2), __ATOMIC_RELEASE);
+	__atomic_store_n(&mpHeader->frames, n + 1, __ATOMIC_RELEASE);
+}
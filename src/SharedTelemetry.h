@@ -0,0 +1,35 @@
+#ifndef SHAREDTELEMETRY_H_D64A32A9_00AB_11E4_71AB_10FEED04CD1C
+#define SHAREDTELEMETRY_H_D64A32A9_00AB_11E4_71AB_10FEED04CD1C
+
+#include "TelemetryShm.h"
+
+#include <stddef.h>
+
+// Writer of the shared memory segment of TelemetryShm.h. Writing a frame copies only
+// the cars that are used, a couple of kilobytes, into the next slot of the ring. It
+// never waits for the readers, that copy the frame again if it changed meanwhile.
+class SharedTelemetry {
+public:
+	SharedTelemetry();
+	~SharedTelemetry();
+
+	bool open(const char * name = TELEMETRY_SHM_NAME);
+	void close(); // and remove it
+
+	bool isOpen() const {
+		return NULL != mpHeader;
+	}
+
+	void write(const TelemetryFrame & frame);
+
+private:
+	TelemetryShmHeader * mpHeader;
+	TelemetryShmSlot * mpaSlots;
+	size_t miSize;
+	char maName[64];
+
+	SharedTelemetry(const SharedTelemetry &);
+	SharedTelemetry & operator=(const SharedTelemetry &);
+};
+
+#endif // SHAREDTELEMETRY_H_D64A32A9_00AB_11E4_71AB_10FEED04CD1C
@@ -0,0 +1,529 @@
+#include "Simulation.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <algorithm>
+
+Simulation::Simulation() :
+	mxMap(NULL),
+	mbIndependent(false),
+	miCarLength(30), // the rotated sprites of the game
+	miCarWidth(30),
+	miCarBodyLength(24),
+	miCarBodyWidth(15),
+	mfStartX(0),
+	mfStartY(0),
+	mfStartAngle(0),
+	miRaceTime(0)
+{
+}
+
+void Simulation::setMap(TileMap * map) {
+	mxMap = map;
+	mCrop.clearMap();
+	if (NULL == map || map->isStreamed()) { // it would page in the whole track
+		mLidar.clearMap();
+	} else {
+		mLidar.setMap(*map);
+	}
+}
+
+void Simulation::setIndependentCars(bool independent) {
+	mbIndependent = independent;
+}
+
+void Simulation::setCarSize(int length, int width, int body_length, int body_width) {
+	miCarLength = length;
+	miCarWidth = width;
+	miCarBodyLength = body_length;
+	miCarBodyWidth = body_width;
+}
+
+void Simulation::placeCars(int count, float start_x, float start_y, float start_angle) {
+	mfStartX = start_x;
+	mfStartY = start_y;
+	mfStartAngle = start_angle * 2. * M_PI / 360.;
+
+	mCars.resize(count);
+	CarInput no_input = { 0, 0 };
+	mCarInputs.assign(count, no_input);
+	for (int i = 0; i < count; ++i) {
+		resetCar(i);
+	}
+
+	miRaceTime = 0;
+	mLeaderTimes.clear();
+	mRaceDistance.assign(count, 0);
+	mCarStanding.assign(count, 0);
+	mStandings.resize(count);
+	for (int i = 0; i < count; ++i) {
+		mStandings[i] = i;
+	}
+	if (!mbIndependent) {
+		updateStandings();
+	}
+}
+
+void Simulation::resetCar(int i) {
+	float cos_a = cos(mfStartAngle);
+	float sin_a = sin(mfStartAngle);
+	int slot = (mbIndependent ? 0 : i);
+
+	Car & car = mCars[i];
+	// the cars point to -(cos, sin), so behind them is +(cos, sin)
+	float back = (slot / 2) * miCarLength * 1.5;
+	float side = (slot % 2 ? miCarWidth : 0);
+	car.setSize(miCarLength, miCarWidth);
+	car.setBodySize(miCarBodyLength, miCarBodyWidth);
+	car.setPosition(mfStartX + cos_a * back - sin_a * side, mfStartY + sin_a * back + cos_a * side, mfStartAngle);
+	car.setInertiaCoef(0);
+	car.resetTimer();
+	car.backupPosition();
+
+	car.cleanCheckpoints();
+	car.setCheckpoints(mxMap->getCheckpoints());
+	car.lapflag = 0;
+	car.crashflag = 0;
+	car.slideflag = 0;
+
+	CarInput no_input = { 0, 0 };
+	mCarInputs[i] = no_input;
+}
+
+// moves a range of cars, which don't touch each other until collideCars()
+class Simulation::Mover : public ParallelTask {
+public:
+	Mover(Simulation & simulation) :
+		mxSimulation(simulation)
+	{
+	}
+
+	virtual void run(int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			mxSimulation.moveCar(mxSimulation.mCars[i], mxSimulation.mCarInputs[i], TICK_MS);
+		}
+	}
+
+private:
+	Simulation & mxSimulation;
+};
+
+void Simulation::tick(ThreadPool * pool) {
+	int count = mCars.size();
+	Mover mover(*this);
+	if (NULL != pool && count >= PARALLEL_MOVES) {
+		pool->parallelFor(count, mover, 16);
+	} else {
+		mover.run(0, count);
+	}
+	if (!mbIndependent) {
+		collideCars(pool);
+	}
+	miRaceTime += TICK_MS;
+	if (!mbIndependent) {
+		updateStandings();
+	}
+}
+
+void Simulation::save(Snapshot & snapshot) const {
+	snapshot.cars = mCars;
+	snapshot.inputs = mCarInputs;
+	snapshot.race_time = miRaceTime;
+	snapshot.race_distance = mRaceDistance;
+	snapshot.standings = mStandings;
+	snapshot.car_standing = mCarStanding;
+	snapshot.leader_times = mLeaderTimes;
+}
+
+void Simulation::restore(const Snapshot & snapshot) {
+	mCars = snapshot.cars;
+	mCarInputs = snapshot.inputs;
+	miRaceTime = snapshot.race_time;
+	mRaceDistance = snapshot.race_distance;
+	mStandings = snapshot.standings;
+	mCarStanding = snapshot.car_standing;
+	mLeaderTimes = snapshot.leader_times;
+}
+
+void Simulation::moveCar(Car & car, const CarInput & input, unsigned int milliseconds) {
+	PROFILE_SCOPE("Simulation::moveCar");
+	// reset flags
+	car.crashflag=0;
+	car.slideflag=0;
+
+	float center_x = car.getPosX();
+	float center_y = car.getPosY();
+	const uint8_t * c;
+
+	// get the pixel color under the center of car in the function map
+	c = mxMap->functionAt(center_x, center_y);
+
+	// green layer = road quality; blue = map height (the checkpoints are found with their gates)
+	uint8_t center_g = c[1], center_b = c[2];
+
+	float angle  = car.getYaw();
+	float length = car.getLength();
+	float width  = car.getWidth();
+
+	float left_back_x = center_x + cos(angle) * length/3 - sin(angle)*3;
+	float left_back_y = center_y + sin(angle) * width/3 + cos(angle)*4;
+	c = mxMap->functionAt(left_back_x, left_back_y);
+	uint8_t left_back_g = c[1], left_back_b = c[2];
+
+	float right_back_x = center_x + cos(angle) * length/3 + sin(angle)*3;
+	float right_back_y = center_y + sin(angle) * width/3 - cos(angle)*4;
+	c = mxMap->functionAt(right_back_x, right_back_y);
+	uint8_t right_back_g = c[1], right_back_b = c[2];
+
+	float left_front_x = center_x - cos(angle) * length/3 - sin(angle)*4;
+	float left_front_y = center_y - sin(angle) * width/3 + cos(angle)*4;
+	c = mxMap->functionAt(left_front_x, left_front_y);
+	uint8_t left_front_g = c[1], left_front_b = c[2];
+
+	float right_front_x = center_x - cos(angle) * length/3 + sin(angle)*4;
+	float right_front_y = center_y - sin(angle) * width/3 - cos(angle)*4;
+	c = mxMap->functionAt(right_front_x, right_front_y);
+	uint8_t right_front_g = c[1], right_front_b = c[2];
+
+	float pitch_m = ( ( left_front_b + right_front_b - left_back_b - right_back_b ) * Z_UNIT_TO_M ) / ( ( 2.0 * length ) * XY_UNIT_TO_M );
+	float roll_m  = ( ( left_front_b + left_back_b - right_front_b - right_back_b)  * Z_UNIT_TO_M ) / ( ( 2.0 * width) * XY_UNIT_TO_M );
+	float pitch   = atan( pitch_m );
+	float roll    = atan( roll_m );
+
+	car.setZ(center_b, pitch, roll);
+
+	car.incYaw( roll_m * car.getInertiaCoef() * 0.05 );
+	car.incInertiaCoef( -pitch_m * 0.01 );
+
+	if (input.up_down < -JOY_AXIS_MIN_THRESHOLD) {
+		car.incInertiaCoef( (-input.up_down) * 0.01 * 2. );
+	}
+	if (input.up_down > JOY_AXIS_MIN_THRESHOLD) {
+		car.decInertiaCoef( input.up_down * 0.01 );
+	}
+	if (input.left_right < -JOY_AXIS_MIN_THRESHOLD) {
+		car.turnLeft( (-input.left_right) * mPhysics.steering );
+	}
+	if (input.left_right > JOY_AXIS_MIN_THRESHOLD) {
+		car.turnRight( input.left_right * mPhysics.steering );
+	}
+
+	// update the inertia_coef depending on the road quality
+	float average_g = ( left_back_g + right_back_g + left_front_g + right_front_g ) / 4.0 ;
+	car.decInertiaCoefByFactor( (255 - average_g) / mPhysics.grip_divisor );
+
+	// if it is a wall we move back to the last position
+	if ( 0 == center_g || 0 == left_back_g || 0 == right_back_g || 0 == left_front_g || 0 == right_front_g ) {
+		car.restorePosition();
+		car.crashflag=1;
+	}
+
+	// save the old position and compute the new one
+	car.backupPosition();
+	car.computeNewPosition(milliseconds, mPhysics.inertia_decay);
+
+	// if a wall was crossed on the way, don't move at all
+	if (!sweepCar(car)) {
+		car.restorePosition();
+		car.crashflag=1;
+	}
+
+	// collision with the border of the screen
+	float radius = ( car.getWidth() < car.getLength() ? car.getLength() : car.getWidth() ) / 2.0;
+	if (
+		car.getPosX() < radius ||
+		car.getPosX() > mxMap->getWidth() - radius ||
+		car.getPosY() < radius ||
+		car.getPosY() > mxMap->getHeight() - radius
+	) {
+		car.restorePosition();
+		car.setInertiaCoef(0);
+		car.crashflag = 1;
+	}
+
+	crossGates(car, center_x, center_y);
+	car.updateProgress(mxMap->progressAt(car.getPosX(), car.getPosY()));
+
+	if (
+		( car.getInertiaCoef()>0.5 && (input.up_down > JOY_AXIS_BRAKE_THRESHOLD) ) ||
+		( car.getInertiaCoef()>2.0 && !(input.up_down < -JOY_AXIS_MIN_THRESHOLD) )
+	) { // if the car is fast or braking, it slides; Race draws the tire marks
+		car.slideflag = (input.up_down > JOY_AXIS_BRAKE_THRESHOLD ? 2 : 1);
+	}
+
+	car.updateTimer(milliseconds);
+}
+
+// check that the car didn't go through a wall between its last position and the current one,
+// which can happen to fast cars on thin walls because the probes are only checked once per tick
+bool Simulation::sweepCar(Car & car) {
+	float last_x = car.getLastPosX();
+	float last_y = car.getLastPosY();
+	float move_x = car.getPosX() - last_x;
+	float move_y = car.getPosY() - last_y;
+
+	float angle  = car.getYaw();
+	float length = car.getLength();
+	float width  = car.getWidth();
+	float cos_a  = cos(angle);
+	float sin_a  = sin(angle);
+
+	// the same probes as in moveCar(), relative to the centre of the car
+	float probe_x[5] = {
+		0,
+		cos_a * length/3 - sin_a*3,
+		cos_a * length/3 + sin_a*3,
+		- cos_a * length/3 - sin_a*4,
+		- cos_a * length/3 + sin_a*4
+	};
+	float probe_y[5] = {
+		0,
+		sin_a * width/3 + cos_a*4,
+		sin_a * width/3 - cos_a*4,
+		- sin_a * width/3 + cos_a*4,
+		- sin_a * width/3 - cos_a*4
+	};
+
+	// usually a single lookup is enough: the nearest wall is further than any probe can move
+	float reach = sqrt((length*length + width*width) / 9.0 + 16) + sqrt(move_x*move_x + move_y*move_y);
+	if (mxMap->distanceAt(last_x, last_y) - 1 > reach) {
+		return true;
+	}
+
+	for (int i = 0; i < 5; ++i) {
+		float x0 = last_x + probe_x[i];
+		float y0 = last_y + probe_y[i];
+		if (mxMap->distanceAt(x0, y0) <= 0) { // already on a wall, moveCar() deals with it
+			continue;
+		}
+		if (mxMap->traceSegment(x0, y0, x0 + move_x, y0 + move_y) < 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// validate the checkpoints whose gates the car went through, from where it was at the beginning of the tick
+void Simulation::crossGates(Car & car, float x0, float y0) {
+	float x1 = car.getPosX();
+	float y1 = car.getPosY();
+	float min_x = std::min(x0, x1), max_x = std::max(x0, x1);
+	float min_y = std::min(y0, y1), max_y = std::max(y0, y1);
+
+	int checkpoints = mxMap->getCheckpoints();
+	for (int k = 0; k < checkpoints; ++k) {
+		const Checkpoint & checkpoint = mxMap->getCheckpoint(k);
+		if (
+			max_x < std::min(checkpoint.gate_x0, checkpoint.gate_x1) ||
+			min_x > std::max(checkpoint.gate_x0, checkpoint.gate_x1) ||
+			max_y < std::min(checkpoint.gate_y0, checkpoint.gate_y1) ||
+			min_y > std::max(checkpoint.gate_y0, checkpoint.gate_y1)
+		) {
+			continue;
+		}
+		int crossing = checkpoint.crossGate(x0, y0, x1, y1);
+		if (crossing > 0) {
+			car.updateCheckpoints(k);
+		} else if (crossing < 0) {
+			car.leaveCheckpoint(k);
+		}
+	}
+}
+
+// find the cars that touch each other with a grid of cells as big as a car, and push them apart
+void Simulation::collideCars(ThreadPool * pool) {
+	int count = mCars.size();
+	if (count < 2) {
+		return;
+	}
+
+	// broadphase on the circles around the bodies, narrowphase on the bodies themselves
+	float radius = 0;
+	mCollisionX.resize(count);
+	mCollisionY.resize(count);
+	mCarBoxes.resize(count);
+	for (int i = 0; i < count; ++i) {
+		const Car & car = mCars[i];
+		mCollisionX[i] = car.getPosX();
+		mCollisionY[i] = car.getPosY();
+		mCarBoxes.set(i, car.getPosX(), car.getPosY(), car.getYaw(), car.getBodyLength(), car.getBodyWidth());
+		float r = sqrt(car.getBodyLength() * car.getBodyLength() + car.getBodyWidth() * car.getBodyWidth()) / 2;
+		if (r > radius) {
+			radius = r;
+		}
+	}
+	mCollisionGrid.build(&mCollisionX[0], &mCollisionY[0], count, 2 * radius);
+	mCollisionGrid.findPairs(2 * radius, mCarPairs, count >= PARALLEL_CARS ? pool : NULL);
+	if (mCarPairs.empty()) {
+		return;
+	}
+
+	mCarContacts.clear();
+	collideBoxes(mCarBoxes, &mCarPairs[0], mCarPairs.size(), mCarContacts);
+	for (size_t i = 0; i < mCarContacts.size(); ++i) {
+		const BoxContact & contact = mCarContacts[i];
+		bounceCars(mCars[contact.a], mCars[contact.b], contact);
+	}
+}
+
+// separate two overlapping cars and exchange their speed along the contact normal, as
+// bodies of the same mass; unlike the walls, the cars are never moved back in time
+void Simulation::bounceCars(Car & a, Car & b, const BoxContact & contact) {
+	float nx = contact.normal_x;
+	float ny = contact.normal_y;
+
+	// share the penetration, unless that would put a car into a wall
+	float a_x = a.getPosX() - nx * contact.depth / 2;
+	float a_y = a.getPosY() - ny * contact.depth / 2;
+	float b_x = b.getPosX() + nx * contact.depth / 2;
+	float b_y = b.getPosY() + ny * contact.depth / 2;
+	bool a_moves = mxMap->distanceAt(a_x, a_y) > a.getBodyWidth() / 2;
+	bool b_moves = mxMap->distanceAt(b_x, b_y) > b.getBodyWidth() / 2;
+	float share = (a_moves && b_moves ? 0.5 : 1.0);
+	if (a_moves) {
+		a.push(-nx * contact.depth * share, -ny * contact.depth * share);
+	}
+	if (b_moves) {
+		b.push(nx * contact.depth * share, ny * contact.depth * share);
+	}
+	a.crashflag = 1;
+	b.crashflag = 1;
+
+	// velocities in pixels per tick, the cars move towards -(cos, sin)
+	float a_vx = -cos(a.getYaw()) * a.getInertiaCoef();
+	float a_vy = -sin(a.getYaw()) * a.getInertiaCoef();
+	float b_vx = -cos(b.getYaw()) * b.getInertiaCoef();
+	float b_vy = -sin(b.getYaw()) * b.getInertiaCoef();
+	float approach = (b_vx - a_vx) * nx + (b_vy - a_vy) * ny;
+	if (approach >= 0) { // already moving apart
+		return;
+	}
+	float impulse = -(1 + CAR_RESTITUTION) * approach / 2;
+	setCarVelocity(a, a_vx - nx * impulse, a_vy - ny * impulse);
+	setCarVelocity(b, b_vx + nx * impulse, b_vy + ny * impulse);
+}
+
+// the cars only move along their heading: the speed along it becomes the new inertia,
+// and the sideways speed turns the car towards it, as the tyres grip the road
+void Simulation::setCarVelocity(Car & car, float vx, float vy) {
+	float cos_a = cos(car.getYaw());
+	float sin_a = sin(car.getYaw());
+	float forward  = -(vx * cos_a + vy * sin_a);
+	float sideways = vx * sin_a - vy * cos_a; // increasing the yaw turns the heading this way
+	float kick = sideways * CAR_YAW_RESPONSE;
+	if (forward < 0) { // in reverse the back of the car leads
+		kick = -kick;
+	}
+	if (kick > CAR_MAX_YAW_KICK) {
+		kick = CAR_MAX_YAW_KICK;
+	} else if (kick < -CAR_MAX_YAW_KICK) {
+		kick = -CAR_MAX_YAW_KICK;
+	}
+	car.setInertiaCoef(forward);
+	car.incYaw(kick);
+}
+
+const float * Simulation::scanLidar(ThreadPool * pool) {
+	if (!mLidar.hasMap() || mCars.empty()) {
+		return NULL;
+	}
+	int count = mCars.size();
+	mLidarDistances.resize((size_t)count * mLidar.getRays());
+	updatePoses();
+	mLidar.scan(&mPoseX[0], &mPoseY[0], &mPoseYaw[0], count, &mLidarDistances[0], pool);
+	return &mLidarDistances[0];
+}
+
+bool Simulation::scanLidar(int car, float * distances) const {
+	if (!mLidar.hasMap()) {
+		return false;
+	}
+	float x = mCars[car].getPosX();
+	float y = mCars[car].getPosY();
+	float yaw = mCars[car].getYaw();
+	mLidar.scan(&x, &y, &yaw, 1, distances);
+	return true;
+}
+
+void Simulation::setCrop(int size, float scale) {
+	mCrop.setSize(size, scale);
+}
+
+bool Simulation::cropMap(float * crops, ThreadPool * pool) {
+	if (NULL == mxMap || mxMap->isStreamed()) {
+		return false;
+	}
+	if (!mCrop.hasMap()) {
+		mCrop.setMap(*mxMap);
+	}
+	if (mCars.empty()) {
+		return true;
+	}
+	updatePoses();
+	mCrop.crop(&mPoseX[0], &mPoseY[0], &mPoseYaw[0], mCars.size(), crops, pool);
+	return true;
+}
+
+void Simulation::updatePoses() {
+	int count = mCars.size();
+	mPoseX.resize(count);
+	mPoseY.resize(count);
+	mPoseYaw.resize(count);
+	for (int i = 0; i < count; ++i) {
+		mPoseX[i] = mCars[i].getPosX();
+		mPoseY[i] = mCars[i].getPosY();
+		mPoseYaw[i] = mCars[i].getYaw();
+	}
+}
+
+// distance covered since the start of the race, in pixels
+float Simulation::getRaceDistance(const Car & car) const {
+	float lap_length = mxMap->getLapLength();
+	if (lap_length <= 0) { // no progress field, count checkpoints
+		return (car.lap * mxMap->getCheckpoints() + car.getLastCheckpoint()) * GAP_STEP;
+	}
+	float progress = car.getProgress();
+	if (0 == car.getLastCheckpoint() && progress > lap_length / 2) { // still before the start line
+		progress -= lap_length;
+	}
+	return car.lap * lap_length + progress;
+}
+
+void Simulation::updateStandings() {
+	for (size_t i = 0; i < mCars.size(); ++i) {
+		mRaceDistance[i] = getRaceDistance(mCars[i]);
+	}
+
+	// insertion sort, as the order hardly changes from one tick to the next
+	for (size_t i = 1; i < mStandings.size(); ++i) {
+		int car = mStandings[i];
+		size_t j = i;
+		while (j > 0 && mRaceDistance[mStandings[j - 1]] < mRaceDistance[car]) {
+			mStandings[j] = mStandings[j - 1];
+			--j;
+		}
+		mStandings[j] = car;
+	}
+	for (size_t i = 0; i < mStandings.size(); ++i) {
+		mCarStanding[mStandings[i]] = i;
+	}
+
+	// remember when the leader went past every step, to know how far behind the others are
+	float leader = (mStandings.empty() ? 0 : mRaceDistance[mStandings[0]]);
+	while (leader >= 0 && mLeaderTimes.size() <= leader / GAP_STEP) {
+		mLeaderTimes.push_back(miRaceTime);
+	}
+}
+
+// seconds since the leader was where the car is now
+float Simulation::getGapTime(int car) const {
+	float distance = mRaceDistance[car];
+	if (distance < 0 || mLeaderTimes.empty()) {
+		return 0;
+	}
+	size_t step = distance / GAP_STEP;
+	if (step >= mLeaderTimes.size()) {
+		step = mLeaderTimes.size() - 1;
+	}
+	return (miRaceTime - mLeaderTimes[step]) / 1000.0;
+}
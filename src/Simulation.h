@@ -0,0 +1,179 @@
+#ifndef SIMULATION_H_576A026D_CDE4_11E4_A1C9_10FEED04CD1C
+#define SIMULATION_H_576A026D_CDE4_11E4_A1C9_10FEED04CD1C
+
+#include "Car.h"
+#include "TileMap.h"
+#include "SpatialGrid.h"
+#include "BoxCollision.h"
+#include "Lidar.h"
+#include "MapCrop.h"
+#include "Threads.h"
+
+#include <vector>
+
+// The physics of a race, with nothing to do with drawing it: cars on the function
+// map of a track, moved in fixed ticks from their inputs. Race draws one and lets
+// the player drive; env/CarEnv.h steps many cars as fast as it can.
+class Simulation {
+public:
+	static const int TICK_MS = 8;
+	static const int PARALLEL_MOVES = 64;  // from this many cars on, they are moved in the pool
+	static const int PARALLEL_CARS = 1024; // and from this many on, the collisions are found in it too
+
+	static const float XY_UNIT_TO_M = 0.01;
+	static const float  Z_UNIT_TO_M = 0.01;
+
+	static const float JOY_AXIS_MIN_THRESHOLD = 0.01;
+	static const float JOY_AXIS_BRAKE_THRESHOLD = 0.9;
+
+	// the constants of the physics of the cars, to try others
+	struct PhysicsParams {
+		float inertia_decay; // share of the speed kept every tick
+		float grip_divisor;  // share of the speed lost every tick on the ground: (255 - grip) / grip_divisor
+		float steering;      // radians per tick with the joystick all the way to a side
+
+		PhysicsParams() : inertia_decay(0.995), grip_divisor(1000), steering(0.02) {
+		}
+	};
+
+	// everything that changes while racing, to go back to it later
+	struct Snapshot {
+		std::vector<Car> cars;
+		std::vector<CarInput> inputs;
+		unsigned int race_time;
+		std::vector<float> race_distance;
+		std::vector<int> standings;
+		std::vector<int> car_standing;
+		std::vector<unsigned int> leader_times;
+	};
+
+	Simulation();
+
+	// the map is borrowed; the lidar field is built for resident maps only
+	void setMap(TileMap * map);
+	TileMap * getMap() const {
+		return mxMap;
+	}
+
+	// independent cars don't collide with each other, and there are no standings;
+	// every one of them starts on the pole
+	void setIndependentCars(bool independent);
+
+	void setPhysics(const PhysicsParams & physics) {
+		mPhysics = physics;
+	}
+	const PhysicsParams & getPhysics() const {
+		return mPhysics;
+	}
+
+	// size of the sprite (wall probes, drawing) and of the body (collisions)
+	void setCarSize(int length, int width, int body_length, int body_width);
+
+	// cars two by row behind (x, y), all of them heading to angle (in degrees)
+	void placeCars(int count, float start_x, float start_y, float start_angle);
+	void resetCar(int i); // back to its place on the start line, stopped
+
+	int getNumberOfCars() const {
+		return mCars.size();
+	}
+	Car & getCar(int i) {
+		return mCars[i];
+	}
+	const Car & getCar(int i) const {
+		return mCars[i];
+	}
+	CarInput & getInput(int i) {
+		return mCarInputs[i];
+	}
+	const CarInput & getInput(int i) const {
+		return mCarInputs[i];
+	}
+
+	// move every car by TICK_MS; with a pool and enough cars, in parallel
+	void tick(ThreadPool * pool = NULL);
+
+	unsigned int getRaceTime() const {
+		return miRaceTime;
+	}
+	float getRaceDistance(const Car & car) const; // since the start of the race, in pixels
+	int getStanding(int car) const { // 0 for the leader
+		return mCarStanding[car];
+	}
+	float getGapTime(int car) const;
+
+	// distance in pixels to the walls around every car, getLidarRays() values per car
+	// (see Lidar::scan()); NULL if the track has no lidar field
+	const float * scanLidar(ThreadPool * pool = NULL);
+	bool scanLidar(int car, float * distances) const; // only one of them
+	int getLidarRays() const {
+		return mLidar.getRays();
+	}
+
+	// the function map around every car, crop.getValues() floats per car (see
+	// MapCrop::crop()); false if the track is streamed. The map is copied for the
+	// crops the first time they are asked for.
+	void setCrop(int size, float scale);
+	const MapCrop & getCrop() const {
+		return mCrop;
+	}
+	bool cropMap(float * crops, ThreadPool * pool = NULL);
+
+	void save(Snapshot & snapshot) const;
+	void restore(const Snapshot & snapshot);
+
+private:
+	static const int GAP_STEP = 16; // pixels between the times at which the leader is recorded
+
+	static const float CAR_RESTITUTION = 0.3;   // share of the approaching speed that bounces back
+	static const float CAR_YAW_RESPONSE = 0.05; // radians per pixel/tick of sideways speed after a hit
+	static const float CAR_MAX_YAW_KICK = 0.15;
+
+	TileMap * mxMap;
+	bool mbIndependent;
+	PhysicsParams mPhysics;
+
+	int miCarLength;
+	int miCarWidth;
+	int miCarBodyLength;
+	int miCarBodyWidth;
+	float mfStartX;
+	float mfStartY;
+	float mfStartAngle; // radians
+
+	std::vector<Car> mCars;
+	std::vector<CarInput> mCarInputs;
+
+	SpatialGrid mCollisionGrid; // rebuilt every tick
+	std::vector<float> mCollisionX;
+	std::vector<float> mCollisionY;
+	std::vector<SpatialGrid::Pair> mCarPairs;
+	BoxSet mCarBoxes;
+	std::vector<BoxContact> mCarContacts;
+
+	std::vector<float> mPoseX; // of every car, for the sensors
+	std::vector<float> mPoseY;
+	std::vector<float> mPoseYaw;
+	Lidar mLidar;
+	std::vector<float> mLidarDistances;
+	MapCrop mCrop;
+
+	unsigned int miRaceTime;
+	std::vector<float> mRaceDistance;        // of every car, in pixels
+	std::vector<int> mStandings;             // car indices, the leader first
+	std::vector<int> mCarStanding;           // position of every car, 0 for the leader
+	std::vector<unsigned int> mLeaderTimes;  // race time at which the leader got to every GAP_STEP
+
+	class Mover;
+	friend class Mover;
+
+	void moveCar(Car & car, const CarInput & input, unsigned int milliseconds);
+	bool sweepCar(Car & car);
+	void crossGates(Car & car, float x0, float y0);
+	void collideCars(ThreadPool * pool);
+	void bounceCars(Car & a, Car & b, const BoxContact & contact);
+	static void setCarVelocity(Car & car, float vx, float vy);
+	void updateStandings();
+	void updatePoses();
+};
+
+#endif // SIMULATION_H_576A026D_CDE4_11E4_A1C9_10FEED04CD1C
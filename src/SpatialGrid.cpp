@@ -0,0 +1,175 @@
+#include "SpatialGrid.h"
+
+#include <algorithm>
+
+SpatialGrid::SpatialGrid() :
+	mfCellSize(1),
+	mfInvCellSize(1),
+	mfMinX(0),
+	mfMinY(0),
+	miCellsX(1),
+	miCellsY(1)
+{
+}
+
+void SpatialGrid::build(const float * x, const float * y, int count, float cell_size) {
+	mItems.resize(count);
+	mItemCell.resize(count);
+	mSortedX.resize(count);
+	mSortedY.resize(count);
+	mSortedCell.resize(count);
+
+	if (0 == count) {
+		miCellsX = miCellsY = 1;
+		mCellStart.assign(2, 0);
+		return;
+	}
+
+	float min_x = x[0], max_x = x[0];
+	float min_y = y[0], max_y = y[0];
+	for (int i = 1; i < count; ++i) {
+		if (x[i] < min_x) min_x = x[i];
+		if (x[i] > max_x) max_x = x[i];
+		if (y[i] < min_y) min_y = y[i];
+		if (y[i] > max_y) max_y = y[i];
+	}
+
+	// don't let a sparse set of items use more cells than it is worth
+	int max_cells = (count < 256 ? 1024 : 4 * count);
+	if (cell_size <= 0) {
+		cell_size = 1;
+	}
+	while ((double)((max_x - min_x) / cell_size + 1) * ((max_y - min_y) / cell_size + 1) > max_cells) {
+		cell_size *= 2;
+	}
+
+	mfCellSize = cell_size;
+	mfInvCellSize = 1.0 / cell_size;
+	mfMinX = min_x;
+	mfMinY = min_y;
+	miCellsX = (int)((max_x - min_x) * mfInvCellSize) + 1;
+	miCellsY = (int)((max_y - min_y) * mfInvCellSize) + 1;
+
+	// counting sort of the items by cell
+	int cells = miCellsX * miCellsY;
+	mCellStart.assign(cells + 1, 0);
+	for (int i = 0; i < count; ++i) {
+		int cell = cellX(x[i]) + cellY(y[i]) * miCellsX;
+		mItemCell[i] = cell;
+		++mCellStart[cell + 1];
+	}
+	for (int c = 0; c < cells; ++c) {
+		mCellStart[c + 1] += mCellStart[c];
+	}
+	for (int i = 0; i < count; ++i) {
+		int slot = mCellStart[mItemCell[i]]++;
+		mItems[slot] = i;
+		mSortedX[slot] = x[i];
+		mSortedY[slot] = y[i];
+		mSortedCell[slot] = mItemCell[i];
+	}
+	for (int c = cells; c > 0; --c) { // the scatter advanced every start to the next cell
+		mCellStart[c] = mCellStart[c - 1];
+	}
+	mCellStart[0] = 0;
+}
+
+void SpatialGrid::query(float x0, float y0, float x1, float y1, std::vector<int> & result) const {
+	result.clear();
+	if (mItems.empty() || x1 < mfMinX || y1 < mfMinY ||
+		x0 > mfMinX + miCellsX * mfCellSize || y0 > mfMinY + miCellsY * mfCellSize) {
+		return;
+	}
+	int cx0 = cellX(x0), cx1 = cellX(x1);
+	int cy0 = cellY(y0), cy1 = cellY(y1);
+	for (int cy = cy0; cy <= cy1; ++cy) {
+		const int * start = &mCellStart[cy * miCellsX];
+		result.insert(result.end(), mItems.begin() + start[cx0], mItems.begin() + start[cx1 + 1]);
+	}
+}
+
+// every item is compared with the ones after it in its cell, the ones in the cell on
+// its right and the ones in the three cells below, so that every pair is seen once.
+// As the cells are sorted by rows, those are just two ranges of the sorted items.
+void SpatialGrid::findPairsInRows(int row0, int row1, float distance, std::vector<Pair> & pairs) const {
+	float distance2 = distance * distance;
+	for (int cy = row0; cy < row1; ++cy) {
+		int row = cy * miCellsX;
+		bool has_below = (cy + 1 < miCellsY);
+		for (int i = mCellStart[row], row_end = mCellStart[row + miCellsX]; i < row_end; ++i) {
+			int cell = mSortedCell[i];
+			int cx = cell - row;
+			float x = mSortedX[i];
+			float y = mSortedY[i];
+
+			int same_end = mCellStart[cell + (cx + 1 < miCellsX ? 2 : 1)];
+			int below_begin = same_end, below_end = same_end;
+			if (has_below) {
+				int below = cell + miCellsX;
+				below_begin = mCellStart[below - (cx > 0 ? 1 : 0)];
+				below_end = mCellStart[below + (cx + 1 < miCellsX ? 2 : 1)];
+			}
+
+			for (int j = i + 1; j < same_end; ++j) {
+				float dx = mSortedX[j] - x;
+				float dy = mSortedY[j] - y;
+				if (dx * dx + dy * dy < distance2) {
+					Pair pair = { std::min(mItems[i], mItems[j]), std::max(mItems[i], mItems[j]) };
+					pairs.push_back(pair);
+				}
+			}
+			for (int j = below_begin; j < below_end; ++j) {
+				float dx = mSortedX[j] - x;
+				float dy = mSortedY[j] - y;
+				if (dx * dx + dy * dy < distance2) {
+					Pair pair = { std::min(mItems[i], mItems[j]), std::max(mItems[i], mItems[j]) };
+					pairs.push_back(pair);
+				}
+			}
+		}
+	}
+}
+
+// Pairs of a range of rows of cells, kept apart so that the result is in the same order whatever the threads
+class SpatialGrid::PairFinder : public ParallelTask {
+public:
+	static const int ROWS_PER_RANGE = 4;
+
+	PairFinder(const SpatialGrid & grid, float distance) :
+		mGrid(grid), mfDistance(distance), mRanges((grid.miCellsY + ROWS_PER_RANGE - 1) / ROWS_PER_RANGE)
+	{
+	}
+
+	virtual void run(int begin, int end) {
+		for (int row = begin; row < end; row += ROWS_PER_RANGE) {
+			std::vector<Pair> & pairs = mRanges[row / ROWS_PER_RANGE];
+			pairs.clear();
+			mGrid.findPairsInRows(row, std::min(row + ROWS_PER_RANGE, end), mfDistance, pairs);
+		}
+	}
+
+	void collect(std::vector<Pair> & pairs) {
+		for (size_t r = 0; r < mRanges.size(); ++r) {
+			pairs.insert(pairs.end(), mRanges[r].begin(), mRanges[r].end());
+		}
+	}
+
+private:
+	const SpatialGrid & mGrid;
+	float mfDistance;
+	std::vector< std::vector<Pair> > mRanges;
+};
+
+void SpatialGrid::findPairs(float distance, std::vector<Pair> & pairs, ThreadPool * pool) const {
+	pairs.clear();
+	if (mItems.size() < 2) {
+		return;
+	}
+	if (NULL == pool || miCellsY <= PairFinder::ROWS_PER_RANGE) {
+		findPairsInRows(0, miCellsY, distance, pairs);
+		return;
+	}
+	PairFinder finder(*this, distance);
+	pool->parallelFor(miCellsY, finder, PairFinder::ROWS_PER_RANGE);
+	finder.collect(pairs);
+}
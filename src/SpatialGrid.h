@@ -0,0 +1,66 @@
+#ifndef SPATIALGRID_H_57408302_DE0D_11E4_5674_10FEED04CD1C
+#define SPATIALGRID_H_57408302_DE0D_11E4_5674_10FEED04CD1C
+
+#include "Threads.h"
+
+#include <vector>
+
+// Uniform grid over a set of points, rebuilt from scratch every time with a
+// counting sort, so that the items of each cell end up contiguous in memory.
+class SpatialGrid {
+public:
+	struct Pair {
+		int a; // a < b
+		int b;
+	};
+
+	SpatialGrid();
+
+	void build(const float * x, const float * y, int count, float cell_size);
+
+	// indices of the items whose cells intersect the given rectangle
+	void query(float x0, float y0, float x1, float y1, std::vector<int> & result) const;
+
+	// every pair of items that are closer than the given distance, once; it looks
+	// only at the neighbouring cells, so the distance must not be bigger than the
+	// cell size. With a pool, the rows of cells are split between its threads.
+	void findPairs(float distance, std::vector<Pair> & pairs, ThreadPool * pool = NULL) const;
+
+	int getCount() const {
+		return mItems.size();
+	}
+	float getCellSize() const {
+		return mfCellSize;
+	}
+
+private:
+	float mfCellSize;
+	float mfInvCellSize;
+	float mfMinX;
+	float mfMinY;
+	int miCellsX;
+	int miCellsY;
+
+	std::vector<int> mCellStart; // first item of every cell, plus one past the last item
+	std::vector<int> mItems;     // item indices sorted by cell
+	std::vector<int> mItemCell;  // cell of every item, in the original order
+	std::vector<float> mSortedX; // positions of the items, in the order of mItems
+	std::vector<float> mSortedY;
+	std::vector<int> mSortedCell;
+
+	class PairFinder;
+	friend class PairFinder;
+
+	void findPairsInRows(int row0, int row1, float distance, std::vector<Pair> & pairs) const;
+
+	int cellX(float x) const {
+		int cx = (int)((x - mfMinX) * mfInvCellSize);
+		return (cx < 0 ? 0 : (cx >= miCellsX ? miCellsX - 1 : cx));
+	}
+	int cellY(float y) const {
+		int cy = (int)((y - mfMinY) * mfInvCellSize);
+		return (cy < 0 ? 0 : (cy >= miCellsY ? miCellsY - 1 : cy));
+	}
+};
+
+#endif // SPATIALGRID_H_57408302_DE0D_11E4_5674_10FEED04CD1C
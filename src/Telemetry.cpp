@@ -0,0 +1,78 @@
+#include "Telemetry.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <sched.h>
+
+TelemetryChannel::TelemetryChannel() : miSequence(0) {
+	memset(&mFrame, 0, sizeof(mFrame));
+}
+
+void TelemetryChannel::publish(const Simulation & simulation, int track, int player) {
+	uint32_t sequence = miSequence;
+	__atomic_store_n(&miSequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	TelemetryFrame & frame = mFrame;
+	int count = std::min(simulation.getNumberOfCars(), (int)TelemetryFrame::MAX_CARS);
+	const TileMap * map = simulation.getMap();
+	frame.version = TelemetryFrame::VERSION;
+	frame.tick = simulation.getRaceTime() / Simulation::TICK_MS;
+	frame.race_time_ms = simulation.getRaceTime();
+	frame.track = track;
+	frame.player = player;
+	frame.lap_length = (NULL != map ? map->getLapLength() * Simulation::XY_UNIT_TO_M : 0);
+	frame.car_count = count;
+	for (int i = 0; i < count; ++i) {
+		const Car & car = simulation.getCar(i);
+		CarTelemetry & t = frame.cars[i];
+		t.position[0] = car.getPosX() * Simulation::XY_UNIT_TO_M;
+		t.position[1] = car.getPosY() * Simulation::XY_UNIT_TO_M;
+		t.position[2] = car.getPosZ() * Simulation::Z_UNIT_TO_M;
+		t.speed[0] = car.getSpeedX() * Simulation::XY_UNIT_TO_M;
+		t.speed[1] = car.getSpeedY() * Simulation::XY_UNIT_TO_M;
+		t.speed[2] = car.getSpeedZ() * Simulation::Z_UNIT_TO_M;
+		t.acceleration[0] = car.getAccelX() * Simulation::XY_UNIT_TO_M;
+		t.acceleration[1] = car.getAccelY() * Simulation::XY_UNIT_TO_M;
+		t.acceleration[2] = car.getAccelZ() * Simulation::Z_UNIT_TO_M;
+		t.angles[0] = car.getYaw();
+		t.angles[1] = car.getPitch();
+		t.angles[2] = car.getRoll();
+		t.progress = car.getProgress() * Simulation::XY_UNIT_TO_M;
+		t.race_distance = (NULL != map ? simulation.getRaceDistance(car) * Simulation::XY_UNIT_TO_M : 0);
+		t.gap = simulation.getGapTime(i);
+		t.current_checkpoint = car.getCurrentCheckpoint();
+		t.last_checkpoint = car.getLastCheckpoint();
+		t.lap = car.lap;
+		t.standing = simulation.getStanding(i);
+		t.timer_ms = car.getTimer();
+		t.crash = car.crashflag;
+		t.slide = car.slideflag;
+	}
+
+	__atomic_store_n(&miSequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+bool TelemetryChannel::read(TelemetryFrame & frame) const {
+	for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt) {
+		uint32_t before = __atomic_load_n(&miSequence, __ATOMIC_ACQUIRE);
+		if (0 == before) {
+			return false;
+		}
+		if (before & 1) { // being written
+			sched_yield();
+			continue;
+		}
+		// the cars that are not used are not copied
+		memcpy(&frame, &mFrame, offsetof(TelemetryFrame, cars));
+		int count = std::min(std::max(frame.car_count, 0), (int)TelemetryFrame::MAX_CARS);
+		memcpy(frame.cars, mFrame.cars, count * sizeof(CarTelemetry));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&miSequence, __ATOMIC_RELAXED) == before) {
+			frame.car_count = count;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,41 @@
+#ifndef TELEMETRY_H_57C3B0F9_914B_11E4_0D66_10FEED04CD1C
+#define TELEMETRY_H_57C3B0F9_914B_11E4_0D66_10FEED04CD1C
+
+#include "Simulation.h"
+#include "TelemetryShm.h"
+
+#include <stdint.h>
+
+// The last frame of a race, written once per tick and read by anybody without locks:
+// a seqlock, whose sequence is odd while the frame is being written, so that readers
+// copy it again if it changed while they were copying it. There is only one writer.
+class TelemetryChannel {
+public:
+	TelemetryChannel();
+
+	void publish(const Simulation & simulation, int track, int player);
+
+	// a consistent copy of the last frame; false if there is none yet
+	bool read(TelemetryFrame & frame) const;
+
+	// the frame that was published last, for the thread that publishes only
+	const TelemetryFrame & getPublished() const {
+		return mFrame;
+	}
+
+	// changes every time a frame is published
+	uint32_t getSequence() const {
+		return __atomic_load_n(&miSequence, __ATOMIC_ACQUIRE);
+	}
+
+private:
+	static const int MAX_READ_ATTEMPTS = 1000;
+
+	uint32_t miSequence;
+	TelemetryFrame mFrame;
+
+	TelemetryChannel(const TelemetryChannel &);
+	TelemetryChannel & operator=(const TelemetryChannel &);
+};
+
+#endif // TELEMETRY_H_57C3B0F9_914B_11E4_0D66_10FEED04CD1C
@@ -0,0 +1,140 @@
+#include "TelemetryLog.h"
+#include "ColumnCodec.h"
+#include "Common.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+TelemetryLog::TelemetryLog() :
+	miFd(-1),
+	mpMapping(NULL),
+	miSize(0),
+	mxChannels(NULL),
+	miTicks(0)
+{
+	memset(&mHeader, 0, sizeof(mHeader));
+}
+
+TelemetryLog::~TelemetryLog() {
+	close();
+}
+
+bool TelemetryLog::open(const char * filename) {
+	close();
+
+	miFd = ::open(filename, O_RDONLY);
+	if (miFd < 0) {
+		printErrorLog("Can't open %s: %s", filename, strerror(errno));
+		return false;
+	}
+	struct stat st;
+	fstat(miFd, &st);
+	miSize = st.st_size;
+	if (miSize < sizeof(TelemetryLogHeader)) {
+		printErrorLog("Invalid telemetry log %s", filename);
+		close();
+		return false;
+	}
+	void * mapping = mmap(NULL, miSize, PROT_READ, MAP_SHARED, miFd, 0);
+	if (MAP_FAILED == mapping) {
+		printErrorLog("Can't map %s: %s", filename, strerror(errno));
+		close();
+		return false;
+	}
+	mpMapping = static_cast<const uint8_t *>(mapping);
+	madvise(mapping, miSize, MADV_SEQUENTIAL);
+
+	memcpy(&mHeader, mpMapping, sizeof(mHeader));
+	size_t offset = sizeof(mHeader) + mHeader.channels * sizeof(TelemetryLogChannel);
+	if (
+		memcmp(mHeader.magic, TELEMETRY_LOG_MAGIC, sizeof(mHeader.magic)) != 0 ||
+		mHeader.version != TelemetryLogHeader::VERSION ||
+		0 == mHeader.channels || mHeader.channels > TelemetryLogHeader::MAX_CHANNELS ||
+		0 == mHeader.cars || offset > miSize
+	) {
+		printErrorLog("Invalid telemetry log %s", filename);
+		close();
+		return false;
+	}
+	mxChannels = reinterpret_cast<const TelemetryLogChannel *>(mpMapping + sizeof(mHeader));
+
+	// the blocks, up to the first one that is not whole
+	while (offset + sizeof(TelemetryLogBlock) <= miSize) {
+		Block block;
+		block.header = reinterpret_cast<const TelemetryLogBlock *>(mpMapping + offset);
+		size_t next = offset + sizeof(TelemetryLogBlock) + mHeader.channels * sizeof(TelemetryLogColumn);
+		if (memcmp(block.header->magic, TELEMETRY_BLOCK_MAGIC, sizeof(block.header->magic)) != 0 || next > miSize) {
+			break;
+		}
+		block.columns = reinterpret_cast<const TelemetryLogColumn *>(block.header + 1);
+		for (uint32_t i = 0; i < mHeader.channels && next <= miSize; ++i) {
+			block.data.push_back(mpMapping + next);
+			next += alignTelemetryLog(block.columns[i].stored_bytes);
+		}
+		if (next > miSize) {
+			break;
+		}
+		mBlocks.push_back(block);
+		miTicks += block.header->ticks;
+		offset = next;
+	}
+	if (offset != miSize) {
+		printWarningLog("Telemetry log %s ends with an incomplete block", filename);
+	}
+	return true;
+}
+
+void TelemetryLog::close() {
+	if (NULL != mpMapping) {
+		munmap(const_cast<uint8_t *>(mpMapping), miSize);
+		mpMapping = NULL;
+	}
+	if (miFd >= 0) {
+		::close(miFd);
+		miFd = -1;
+	}
+	miSize = 0;
+	memset(&mHeader, 0, sizeof(mHeader));
+	mxChannels = NULL;
+	mBlocks.clear();
+	miTicks = 0;
+}
+
+int TelemetryLog::findChannel(const char * name) const {
+	for (uint32_t i = 0; i < mHeader.channels; ++i) {
+		if (0 == strncmp(mxChannels[i].name, name, sizeof(mxChannels[i].name))) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool TelemetryLog::isRaw(int block, int channel) const {
+	return COLUMN_RAW == mBlocks[block].columns[channel].encoding;
+}
+
+const uint32_t * TelemetryLog::getColumn(int block, int channel, std::vector<uint32_t> & scratch) const {
+	const Block & b = mBlocks[block];
+	const TelemetryLogColumn & column = b.columns[channel];
+	int count = b.header->ticks * mHeader.cars;
+	if (COLUMN_RAW == column.encoding) {
+		if (column.stored_bytes != count * sizeof(uint32_t)) {
+			return NULL;
+		}
+		return reinterpret_cast<const uint32_t *>(b.data[channel]);
+	}
+	scratch.resize(count);
+	if (0 == count) {
+		return NULL;
+	}
+	if (!decodeColumn(b.data[channel], column.stored_bytes, column.plain_bytes, column.encoding,
+		&scratch[0], count, mHeader.cars))
+	{
+		return NULL;
+	}
+	return &scratch[0];
+}
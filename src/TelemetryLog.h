@@ -0,0 +1,133 @@
+#ifndef TELEMETRYLOG_H_A252ACAE_7E52_11E4_8E9C_10FEED04CD1C
+#define TELEMETRYLOG_H_A252ACAE_7E52_11E4_8E9C_10FEED04CD1C
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define TELEMETRY_LOG_MAGIC   "CARTLM01"
+#define TELEMETRY_BLOCK_MAGIC "BLCK"
+
+// Layout of the files of TelemetryRecorder: a header, the channels, and then blocks of
+// up to a few thousand ticks, every one of them with a column of 32 bits values per
+// channel (ticks * cars values, tick by tick, see ColumnCodec.h for their encodings).
+// Everything is little endian and aligned to 8 bytes, so that a raw column can be
+// used right from the mapping of the file.
+struct TelemetryLogHeader {
+	static const uint32_t VERSION = 1;
+	static const uint32_t MAX_CHANNELS = 256;
+
+	char magic[8];   // TELEMETRY_LOG_MAGIC
+	uint32_t version;
+	uint32_t channels;
+	uint32_t cars;
+	uint32_t tick_ms;
+	uint32_t track;
+	uint32_t reserved;
+};
+
+enum TelemetryChannelType {
+	CHANNEL_FLOAT = 0,
+	CHANNEL_INT32 = 1
+};
+
+struct TelemetryLogChannel {
+	char name[16];
+	uint32_t type;  // TelemetryChannelType
+	float scale;    // to SI units (metres), 1 if the values are not lengths
+};
+
+struct TelemetryLogBlock {
+	char magic[4];   // TELEMETRY_BLOCK_MAGIC
+	uint32_t ticks;
+	uint32_t first_tick;
+	uint32_t reserved;
+	// followed by a TelemetryLogColumn for every channel and then their data
+};
+
+struct TelemetryLogColumn {
+	uint32_t encoding;     // ColumnEncoding
+	uint32_t stored_bytes; // in the file, without the padding to 8 bytes
+	uint32_t plain_bytes;  // before COLUMN_LZ
+	uint32_t reserved;
+};
+
+// Reader of those files, mapped in memory. A file that was not closed, because the
+// game crashed, is read up to its last whole block.
+class TelemetryLog {
+public:
+	TelemetryLog();
+	~TelemetryLog();
+
+	bool open(const char * filename);
+	void close();
+
+	int getCars() const {
+		return mHeader.cars;
+	}
+	int getTickMs() const {
+		return mHeader.tick_ms;
+	}
+	int getTrack() const {
+		return mHeader.track;
+	}
+	int getChannels() const {
+		return mHeader.channels;
+	}
+	const TelemetryLogChannel & getChannel(int channel) const {
+		return mxChannels[channel];
+	}
+	int findChannel(const char * name) const; // -1 if there is none
+
+	int getBlocks() const {
+		return mBlocks.size();
+	}
+	int getBlockTicks(int block) const {
+		return mBlocks[block].header->ticks;
+	}
+	uint32_t getBlockFirstTick(int block) const {
+		return mBlocks[block].header->first_tick;
+	}
+	uint64_t getTicks() const {
+		return miTicks;
+	}
+	size_t getStoredBytes(int block, int channel) const {
+		return mBlocks[block].columns[channel].stored_bytes;
+	}
+	bool isRaw(int block, int channel) const;
+
+	// the getBlockTicks() * getCars() values of a channel in a block, the cars of a tick
+	// one after the other: a pointer into the mapping when the column is raw, or into
+	// scratch, where it is decoded; NULL if the column is damaged
+	const uint32_t * getColumn(int block, int channel, std::vector<uint32_t> & scratch) const;
+	const float * getFloats(int block, int channel, std::vector<uint32_t> & scratch) const {
+		return reinterpret_cast<const float *>(getColumn(block, channel, scratch));
+	}
+	const int32_t * getInts(int block, int channel, std::vector<uint32_t> & scratch) const {
+		return reinterpret_cast<const int32_t *>(getColumn(block, channel, scratch));
+	}
+
+private:
+	struct Block {
+		const TelemetryLogBlock * header;
+		const TelemetryLogColumn * columns;
+		std::vector<const uint8_t *> data;
+	};
+
+	int miFd;
+	const uint8_t * mpMapping;
+	size_t miSize;
+	TelemetryLogHeader mHeader;
+	const TelemetryLogChannel * mxChannels;
+	std::vector<Block> mBlocks;
+	uint64_t miTicks;
+
+	TelemetryLog(const TelemetryLog &);
+	TelemetryLog & operator=(const TelemetryLog &);
+};
+
+static inline size_t alignTelemetryLog(size_t size) {
+	return (size + 7) & ~(size_t)7;
+}
+
+#endif // TELEMETRYLOG_H_A252ACAE_7E52_11E4_8E9C_10FEED04CD1C
@@ -0,0 +1,312 @@
+#include "TelemetryRecorder.h"
+#include "ColumnCodec.h"
+#include "Common.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+enum RecordedChannel {
+	REC_POS_X,
+	REC_POS_Y,
+	REC_POS_Z,
+	REC_YAW,
+	REC_PITCH,
+	REC_ROLL,
+	REC_SPEED_X,
+	REC_SPEED_Y,
+	REC_INERTIA_COEF,
+	REC_PROGRESS,
+	REC_CENTER_G,     // road quality under the centre of the car
+	REC_CHECKPOINT,
+	REC_LAP,
+	REC_CRASH,
+	REC_SLIDE,
+	REC_UP_DOWN,      // the inputs that were applied
+	REC_LEFT_RIGHT,
+	NB_RECORDED_CHANNELS
+};
+
+static const TelemetryLogChannel CHANNELS[NB_RECORDED_CHANNELS] = {
+	{ "pos_x",        CHANNEL_FLOAT, Simulation::XY_UNIT_TO_M },
+	{ "pos_y",        CHANNEL_FLOAT, Simulation::XY_UNIT_TO_M },
+	{ "pos_z",        CHANNEL_FLOAT, Simulation::Z_UNIT_TO_M },
+	{ "yaw",          CHANNEL_FLOAT, 1 },
+	{ "pitch",        CHANNEL_FLOAT, 1 },
+	{ "roll",         CHANNEL_FLOAT, 1 },
+	{ "speed_x",      CHANNEL_FLOAT, Simulation::XY_UNIT_TO_M },
+	{ "speed_y",      CHANNEL_FLOAT, Simulation::XY_UNIT_TO_M },
+	{ "inertia_coef", CHANNEL_FLOAT, 1 },
+	{ "progress",     CHANNEL_FLOAT, Simulation::XY_UNIT_TO_M },
+	{ "center_g",     CHANNEL_INT32, 1 },
+	{ "checkpoint",   CHANNEL_INT32, 1 },
+	{ "lap",          CHANNEL_INT32, 1 },
+	{ "crash",        CHANNEL_INT32, 1 },
+	{ "slide",        CHANNEL_INT32, 1 },
+	{ "up_down",      CHANNEL_FLOAT, 1 },
+	{ "left_right",   CHANNEL_FLOAT, 1 },
+};
+
+static inline uint32_t bitsOf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+class TelemetryRecorder::Writer : public ThreadBase {
+public:
+	Writer(TelemetryRecorder * recorder) : mxRecorder(recorder) {
+	}
+
+	virtual void run();
+
+private:
+	TelemetryRecorder * mxRecorder;
+};
+
+void TelemetryRecorder::Writer::run() {
+	std::vector<uint8_t> buffer;
+	while (true) {
+		Block * block;
+		{
+			Mutex::MutexHolder lock(&mxRecorder->mMutex);
+			while (!mxRecorder->mbStopping && mxRecorder->mQueue.empty()) {
+				mxRecorder->mCondition.wait(mxRecorder->mMutex);
+			}
+			if (mxRecorder->mQueue.empty()) { // stopping, and everything was written
+				return;
+			}
+			block = mxRecorder->mQueue.front();
+			mxRecorder->mQueue.pop_front();
+		}
+
+		if (!mxRecorder->mbFailed) {
+			mxRecorder->writeBlock(*block, buffer);
+		}
+
+		Mutex::MutexHolder lock(&mxRecorder->mMutex);
+		mxRecorder->mFree.push_back(block);
+	}
+}
+
+TelemetryRecorder::TelemetryRecorder() :
+	mpWriter(NULL),
+	miFd(-1),
+	miCars(0),
+	mbCompress(false),
+	mpBlock(NULL),
+	miRecordedTicks(0),
+	miDroppedTicks(0),
+	mbStopping(false),
+	mbFailed(false)
+{
+}
+
+TelemetryRecorder::~TelemetryRecorder() {
+	stop();
+}
+
+bool TelemetryRecorder::start(const char * filename, const Simulation & simulation, int track, bool compress) {
+	stop();
+
+	if (simulation.getNumberOfCars() <= 0) {
+		return false;
+	}
+	miFd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (miFd < 0) {
+		printErrorLog("Can't create %s: %s", filename, strerror(errno));
+		return false;
+	}
+
+	TelemetryLogHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TELEMETRY_LOG_MAGIC, sizeof(header.magic));
+	header.version = TelemetryLogHeader::VERSION;
+	header.channels = NB_RECORDED_CHANNELS;
+	header.cars = simulation.getNumberOfCars();
+	header.tick_ms = Simulation::TICK_MS;
+	header.track = track;
+	if (
+		write(miFd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+		write(miFd, CHANNELS, sizeof(CHANNELS)) != (ssize_t)sizeof(CHANNELS)
+	) {
+		printErrorLog("Can't write %s: %s", filename, strerror(errno));
+		close(miFd);
+		miFd = -1;
+		return false;
+	}
+
+	miCars = header.cars;
+	mbCompress = compress;
+	miRecordedTicks = 0;
+	miDroppedTicks = 0;
+	mbStopping = false;
+	mbFailed = false;
+	mpWriter = new Writer(this);
+	if (!mpWriter->start()) {
+		printErrorLog("Unable to start the telemetry writer thread");
+		delete mpWriter;
+		mpWriter = NULL;
+		close(miFd);
+		miFd = -1;
+		return false;
+	}
+	printInfoLog("Recording the telemetry of %d cars in %s", miCars, filename);
+	return true;
+}
+
+void TelemetryRecorder::stop() {
+	if (NULL == mpWriter) {
+		return;
+	}
+	if (NULL != mpBlock && mpBlock->ticks > 0) {
+		queueBlock();
+	}
+	{
+		Mutex::MutexHolder lock(&mMutex);
+		mbStopping = true;
+		mCondition.signal();
+	}
+	mpWriter->join();
+	delete mpWriter;
+	mpWriter = NULL;
+	if (0 != close(miFd)) {
+		mbFailed = true;
+	}
+	miFd = -1;
+
+	delete mpBlock;
+	mpBlock = NULL;
+	for (size_t i = 0; i < mFree.size(); ++i) {
+		delete mFree[i];
+	}
+	mFree.clear();
+
+	if (mbFailed) {
+		printErrorLog("The telemetry recording is incomplete");
+	} else if (miDroppedTicks > 0) {
+		printWarningLog("Telemetry recorded: %llu ticks, %llu dropped",
+			(unsigned long long)miRecordedTicks, (unsigned long long)miDroppedTicks);
+	} else {
+		printInfoLog("Telemetry recorded: %llu ticks", (unsigned long long)miRecordedTicks);
+	}
+}
+
+void TelemetryRecorder::queueBlock() {
+	Mutex::MutexHolder lock(&mMutex);
+	mQueue.push_back(mpBlock);
+	mpBlock = NULL;
+	mCondition.signal();
+}
+
+void TelemetryRecorder::record(const Simulation & simulation) {
+	if (NULL == mpWriter) {
+		return;
+	}
+	if (NULL == mpBlock) {
+		Mutex::MutexHolder lock(&mMutex);
+		if (mQueue.size() >= (size_t)MAX_QUEUED_BLOCKS) {
+			++miDroppedTicks;
+			return;
+		}
+		if (mFree.empty()) {
+			mpBlock = new Block;
+			mpBlock->values.resize((size_t)NB_RECORDED_CHANNELS * BLOCK_TICKS * miCars);
+		} else {
+			mpBlock = mFree.back();
+			mFree.pop_back();
+		}
+		mpBlock->ticks = 0;
+		mpBlock->first_tick = simulation.getRaceTime() / Simulation::TICK_MS;
+	}
+
+	// with the cars one after the other in every column, for the deltas of the same car
+	const size_t channel_stride = (size_t)BLOCK_TICKS * miCars;
+	uint32_t * values = &mpBlock->values[(size_t)mpBlock->ticks * miCars];
+	TileMap * map = simulation.getMap();
+	int count = std::min(simulation.getNumberOfCars(), miCars);
+	for (int i = 0; i < count; ++i) {
+		const Car & car = simulation.getCar(i);
+		const CarInput & input = simulation.getInput(i);
+		uint32_t * v = values + i;
+		v[REC_POS_X        * channel_stride] = bitsOf(car.getPosX());
+		v[REC_POS_Y        * channel_stride] = bitsOf(car.getPosY());
+		v[REC_POS_Z        * channel_stride] = bitsOf(car.getPosZ());
+		v[REC_YAW          * channel_stride] = bitsOf(car.getYaw());
+		v[REC_PITCH        * channel_stride] = bitsOf(car.getPitch());
+		v[REC_ROLL         * channel_stride] = bitsOf(car.getRoll());
+		v[REC_SPEED_X      * channel_stride] = bitsOf(car.getSpeedX());
+		v[REC_SPEED_Y      * channel_stride] = bitsOf(car.getSpeedY());
+		v[REC_INERTIA_COEF * channel_stride] = bitsOf(car.getInertiaCoef());
+		v[REC_PROGRESS     * channel_stride] = bitsOf(car.getProgress());
+		v[REC_CENTER_G     * channel_stride] = (NULL != map ? map->functionAt(car.getPosX(), car.getPosY())[1] : 0);
+		v[REC_CHECKPOINT   * channel_stride] = car.getCurrentCheckpoint();
+		v[REC_LAP          * channel_stride] = car.lap;
+		v[REC_CRASH        * channel_stride] = car.crashflag;
+		v[REC_SLIDE        * channel_stride] = car.slideflag;
+		v[REC_UP_DOWN      * channel_stride] = bitsOf(input.up_down);
+		v[REC_LEFT_RIGHT   * channel_stride] = bitsOf(input.left_right);
+	}
+	for (int i = count; i < miCars; ++i) { // cars that were removed since the start
+		for (int channel = 0; channel < NB_RECORDED_CHANNELS; ++channel) {
+			values[channel * channel_stride + i] = 0;
+		}
+	}
+
+	++miRecordedTicks;
+	if (++mpBlock->ticks == BLOCK_TICKS) {
+		queueBlock();
+	}
+}
+
+// in the thread of the writer; the whole block in a single write
+void TelemetryRecorder::writeBlock(const Block & block, std::vector<uint8_t> & buffer) {
+	const size_t channel_stride = (size_t)BLOCK_TICKS * miCars;
+	int count = block.ticks * miCars;
+
+	size_t header_bytes = sizeof(TelemetryLogBlock) + NB_RECORDED_CHANNELS * sizeof(TelemetryLogColumn);
+	buffer.assign(header_bytes, 0);
+	TelemetryLogBlock header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TELEMETRY_BLOCK_MAGIC, sizeof(header.magic));
+	header.ticks = block.ticks;
+	header.first_tick = block.first_tick;
+	memcpy(&buffer[0], &header, sizeof(header));
+
+	std::vector<uint8_t> encoded;
+	for (int channel = 0; channel < NB_RECORDED_CHANNELS; ++channel) {
+		const uint32_t * values = &block.values[channel * channel_stride];
+		TelemetryLogColumn column;
+		memset(&column, 0, sizeof(column));
+		if (mbCompress) {
+			size_t plain_bytes;
+			column.encoding = encodeColumn(values, count, miCars, encoded, plain_bytes);
+			column.plain_bytes = plain_bytes;
+		} else {
+			const uint8_t * bytes = reinterpret_cast<const uint8_t *>(values);
+			encoded.assign(bytes, bytes + count * sizeof(uint32_t));
+			column.encoding = COLUMN_RAW;
+			column.plain_bytes = encoded.size();
+		}
+		column.stored_bytes = encoded.size();
+		memcpy(&buffer[sizeof(header) + channel * sizeof(column)], &column, sizeof(column));
+		buffer.insert(buffer.end(), encoded.begin(), encoded.end());
+		buffer.resize(alignTelemetryLog(buffer.size()), 0);
+	}
+
+	size_t written = 0;
+	while (written < buffer.size()) {
+		ssize_t n = write(miFd, &buffer[written], buffer.size() - written);
+		if (n < 0 && EINTR == errno) {
+			continue;
+		}
+		if (n <= 0) {
+			printErrorLog("Can't write the telemetry: %s", strerror(errno));
+			mbFailed = true;
+			return;
+		}
+		written += n;
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef TELEMETRYRECORDER_H_2046201A_2080_11E4_C4B6_10FEED04CD1C
+#define TELEMETRYRECORDER_H_2046201A_2080_11E4_C4B6_10FEED04CD1C
+
+#include "Simulation.h"
+#include "TelemetryLog.h"
+#include "Threads.h"
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+// Records the state of every car after every tick in a TelemetryLog file. The thread
+// of the simulation only copies the values into the columns of the current block;
+// the full blocks are encoded and written by a thread of the recorder. If that one
+// falls behind by more than MAX_QUEUED_BLOCKS, the ticks are dropped, and counted,
+// rather than slowing the race down.
+class TelemetryRecorder {
+public:
+	static const int BLOCK_TICKS = 4096;  // 33 seconds of race
+	static const int MAX_QUEUED_BLOCKS = 4;
+
+	TelemetryRecorder();
+	~TelemetryRecorder();
+
+	// the number of cars is the one of the simulation now; compressed, the columns are
+	// stored as COLUMN_DELTA | COLUMN_LZ when that makes them smaller
+	bool start(const char * filename, const Simulation & simulation, int track, bool compress);
+	void record(const Simulation & simulation);
+	void stop(); // writes the last block and waits for the thread
+
+	bool isRecording() const {
+		return NULL != mpWriter;
+	}
+	uint64_t getRecordedTicks() const {
+		return miRecordedTicks;
+	}
+	uint64_t getDroppedTicks() const {
+		return miDroppedTicks;
+	}
+
+private:
+	class Writer;
+	friend class Writer;
+
+	struct Block {
+		uint32_t first_tick;
+		int ticks;
+		std::vector<uint32_t> values; // [channel][tick][car]
+	};
+
+	Writer * mpWriter;
+	int miFd;
+	int miCars;
+	bool mbCompress;
+	Block * mpBlock;              // being filled
+	uint64_t miRecordedTicks;
+	uint64_t miDroppedTicks;
+
+	Mutex mMutex;
+	Condition mCondition;
+	std::deque<Block *> mQueue;   // full, to be written
+	std::vector<Block *> mFree;   // written, to be filled again
+	bool mbStopping;
+	bool mbFailed;                // the file could not be written, the blocks are discarded
+
+	void queueBlock();
+	void writeBlock(const Block & block, std::vector<uint8_t> & buffer);
+
+	TelemetryRecorder(const TelemetryRecorder &);
+	TelemetryRecorder & operator=(const TelemetryRecorder &);
+};
+
+#endif // TELEMETRYRECORDER_H_2046201A_2080_11E4_C4B6_10FEED04CD1C
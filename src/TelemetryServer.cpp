@@ -0,0 +1,364 @@
+#include "TelemetryServer.h"
+#include "Common.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+class TelemetryServer::Thread : public ThreadBase {
+public:
+	Thread(TelemetryServer * server) : mxServer(server) {
+	}
+
+	virtual void run() {
+		mxServer->run();
+	}
+
+private:
+	TelemetryServer * mxServer;
+};
+
+static void setNonBlocking(int fd) {
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static int listenUnix(const char * path) {
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		printErrorLog("Socket path too long: %s", path);
+		return -1;
+	}
+	strcpy(address.sun_path, path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	// the socket is only left by a game that crashed if nobody answers on it
+	if (0 == connect(fd, (struct sockaddr *)&address, sizeof(address))) {
+		printWarningLog("Another game streams its telemetry on %s, not streaming", path);
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 8) != 0) {
+		printErrorLog("Can't listen on %s: %s", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	setNonBlocking(fd);
+	return fd;
+}
+
+static int listenTcp(int port) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	int yes = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 8) != 0) {
+		printErrorLog("Can't listen on the port %d: %s", port, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	setNonBlocking(fd);
+	return fd;
+}
+
+TelemetryServer::TelemetryServer(const TelemetryChannel & channel) :
+	mChannel(channel),
+	mpThread(NULL),
+	miUnixFd(-1),
+	miTcpFd(-1),
+	miWakePending(0),
+	miClientCount(0),
+	mbStopping(false),
+	mpFrame(NULL),
+	mWords(TELEMETRY_FRAME_WORDS, 0),
+	mPrevious(TELEMETRY_FRAME_WORDS, 0),
+	mbHavePrevious(false),
+	miLastSequence(0),
+	miKeyframeTick(0)
+{
+	maWakeFds[0] = maWakeFds[1] = -1;
+}
+
+TelemetryServer::~TelemetryServer() {
+	stop();
+}
+
+bool TelemetryServer::start(const char * path, int port) {
+	stop();
+
+	if (pipe(maWakeFds) != 0) {
+		return false;
+	}
+	setNonBlocking(maWakeFds[0]);
+	setNonBlocking(maWakeFds[1]);
+	miUnixFd = listenUnix(path);
+	if (port > 0) {
+		miTcpFd = listenTcp(port);
+	}
+	if (miUnixFd < 0 && miTcpFd < 0) {
+		stop();
+		return false;
+	}
+	mPath = (miUnixFd >= 0 ? path : "");
+
+	mpFrame = new TelemetryFrame;
+	mbHavePrevious = false;
+	miLastSequence = 0;
+	mbStopping = false;
+	mpThread = new Thread(this);
+	if (!mpThread->start()) {
+		printErrorLog("Unable to start the telemetry server thread");
+		delete mpThread;
+		mpThread = NULL;
+		stop();
+		return false;
+	}
+	if (miTcpFd >= 0) {
+		printInfoLog("Streaming the telemetry on %s and on the port %d", path, port);
+	} else {
+		printInfoLog("Streaming the telemetry on %s", path);
+	}
+	return true;
+}
+
+void TelemetryServer::stop() {
+	if (NULL != mpThread) {
+		__atomic_store_n(&mbStopping, true, __ATOMIC_RELEASE);
+		char byte = 0;
+		if (write(maWakeFds[1], &byte, 1) < 0) {
+			// full, so it will wake up anyway
+		}
+		mpThread->join();
+		delete mpThread;
+		mpThread = NULL;
+	}
+	while (!mClients.empty()) {
+		removeClient(mClients.size() - 1);
+	}
+	if (miUnixFd >= 0) {
+		close(miUnixFd);
+		miUnixFd = -1;
+		unlink(mPath.c_str());
+	}
+	if (miTcpFd >= 0) {
+		close(miTcpFd);
+		miTcpFd = -1;
+	}
+	for (int i = 0; i < 2; ++i) {
+		if (maWakeFds[i] >= 0) {
+			close(maWakeFds[i]);
+			maWakeFds[i] = -1;
+		}
+	}
+	delete mpFrame;
+	mpFrame = NULL;
+}
+
+void TelemetryServer::notify() {
+	if (
+		__atomic_load_n(&miClientCount, __ATOMIC_RELAXED) > 0 &&
+		0 == __atomic_exchange_n(&miWakePending, 1, __ATOMIC_ACQ_REL)
+	) {
+		char byte = 0;
+		if (write(maWakeFds[1], &byte, 1) < 0) {
+			// full, so it will wake up anyway
+		}
+	}
+}
+
+void TelemetryServer::run() {
+	std::vector<struct pollfd> fds;
+	while (!__atomic_load_n(&mbStopping, __ATOMIC_ACQUIRE)) {
+		fds.clear();
+		struct pollfd wake = { maWakeFds[0], POLLIN, 0 };
+		struct pollfd unix_listen = { miUnixFd, POLLIN, 0 };
+		struct pollfd tcp_listen = { miTcpFd, POLLIN, 0 };
+		fds.push_back(wake);
+		fds.push_back(unix_listen); // ignored by poll() when there is none
+		fds.push_back(tcp_listen);
+		for (size_t i = 0; i < mClients.size(); ++i) {
+			const Client & client = mClients[i];
+			struct pollfd fd = { client.fd, (short)(POLLIN | (client.sent < client.out.size() ? POLLOUT : 0)), 0 };
+			fds.push_back(fd);
+		}
+		if (poll(&fds[0], fds.size(), -1) < 0) {
+			if (EINTR == errno) {
+				continue;
+			}
+			printErrorLog("Telemetry server: %s", strerror(errno));
+			return;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			char bytes[64];
+			while (read(maWakeFds[0], bytes, sizeof(bytes)) > 0) {
+			}
+			__atomic_store_n(&miWakePending, 0, __ATOMIC_RELEASE); // before reading the frame
+			broadcast();
+		}
+
+		// the clients are still those of fds, broadcast() only marks those that are gone
+		for (size_t i = 0; i < mClients.size(); ++i) {
+			Client & client = mClients[i];
+			short revents = fds[3 + i].revents;
+			client.gone = client.gone || (revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+			if (!client.gone && (revents & POLLIN)) { // nothing is expected from them, but their end
+				char bytes[256];
+				ssize_t n = recv(client.fd, bytes, sizeof(bytes), 0);
+				client.gone = (0 == n || (n < 0 && EAGAIN != errno && EINTR != errno));
+			}
+			if (!client.gone && (revents & POLLOUT)) {
+				client.gone = !flush(client);
+			}
+		}
+		for (size_t i = mClients.size(); i-- > 0; ) {
+			if (mClients[i].gone) {
+				removeClient(i);
+			}
+		}
+
+		if (fds[1].revents & POLLIN) {
+			accept(miUnixFd);
+		}
+		if (fds[2].revents & POLLIN) {
+			accept(miTcpFd);
+		}
+	}
+}
+
+void TelemetryServer::accept(int listen_fd) {
+	int fd = ::accept(listen_fd, NULL, NULL);
+	if (fd < 0) {
+		return;
+	}
+	if (mClients.size() >= (size_t)MAX_CLIENTS) {
+		printWarningLog("Too many telemetry viewers");
+		close(fd);
+		return;
+	}
+	setNonBlocking(fd);
+	if (listen_fd == miTcpFd) {
+		int yes = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+	}
+	Client client;
+	client.fd = fd;
+	client.synced = false; // until the next frame, that will be a keyframe for it
+	client.sent = 0;
+	client.dropped = 0;
+	client.gone = false;
+	mClients.push_back(client);
+	__atomic_store_n(&miClientCount, (int)mClients.size(), __ATOMIC_RELAXED);
+}
+
+void TelemetryServer::removeClient(size_t i) {
+	if (mClients[i].dropped > 0) {
+		printInfoLog("Telemetry viewer gone, after missing %u frames", mClients[i].dropped);
+	}
+	close(mClients[i].fd);
+	mClients.erase(mClients.begin() + i);
+	__atomic_store_n(&miClientCount, (int)mClients.size(), __ATOMIC_RELAXED);
+}
+
+// the frame is encoded at most once as a keyframe and once as a delta, whatever the
+// number of viewers
+void TelemetryServer::broadcast() {
+	uint32_t sequence = mChannel.getSequence();
+	if (sequence == miLastSequence || !mChannel.read(*mpFrame)) {
+		return;
+	}
+	miLastSequence = sequence;
+	int count = getTelemetryWords(*mpFrame, &mWords[0]);
+
+	// a new race starts again from tick 0
+	bool keyframe_due = !mbHavePrevious || mpFrame->tick < miKeyframeTick ||
+		mpFrame->tick - miKeyframeTick >= KEYFRAME_TICKS;
+	mKeyframe.clear();
+	mDelta.clear();
+	if (keyframe_due) {
+		miKeyframeTick = mpFrame->tick;
+	} else {
+		encodeTelemetryMessage(TELEMETRY_DELTA, &mPrevious[0], &mWords[0], count, mDelta);
+	}
+
+	for (size_t i = 0; i < mClients.size(); ++i) {
+		Client & client = mClients[i];
+		if (client.gone) {
+			continue;
+		}
+		size_t queued = client.out.size() - client.sent;
+		if (keyframe_due || !client.synced) {
+			if (!client.synced && queued > RESYNC_BYTES) {
+				++client.dropped;
+				continue;
+			}
+			if (mKeyframe.empty()) {
+				encodeTelemetryMessage(TELEMETRY_KEYFRAME, NULL, &mWords[0], count, mKeyframe);
+			}
+			if (queued + mKeyframe.size() > MAX_QUEUED_BYTES) {
+				client.synced = false;
+				++client.dropped;
+				continue;
+			}
+			queue(client, mKeyframe);
+			client.synced = true;
+		} else if (queued + mDelta.size() > MAX_QUEUED_BYTES) {
+			client.synced = false;
+			++client.dropped;
+		} else {
+			queue(client, mDelta);
+		}
+	}
+	mPrevious.swap(mWords);
+	mbHavePrevious = true;
+
+	for (size_t i = 0; i < mClients.size(); ++i) {
+		if (!mClients[i].gone && !flush(mClients[i])) {
+			mClients[i].gone = true;
+		}
+	}
+}
+
+void TelemetryServer::queue(Client & client, const std::vector<uint8_t> & message) {
+	if (client.sent == client.out.size()) {
+		client.out.clear();
+		client.sent = 0;
+	} else if (client.sent > MAX_QUEUED_BYTES) {
+		client.out.erase(client.out.begin(), client.out.begin() + client.sent);
+		client.sent = 0;
+	}
+	client.out.insert(client.out.end(), message.begin(), message.end());
+}
+
+bool TelemetryServer::flush(Client & client) {
+	while (client.sent < client.out.size()) {
+		ssize_t n = send(client.fd, &client.out[client.sent], client.out.size() - client.sent, MSG_NOSIGNAL);
+		if (n < 0) {
+			return (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno);
+		}
+		client.sent += n;
+	}
+	return true;
+}
@@ -0,0 +1,85 @@
+#ifndef TELEMETRYSERVER_H_303A158E_919E_11E4_6B1D_10FEED04CD1C
+#define TELEMETRYSERVER_H_303A158E_919E_11E4_6B1D_10FEED04CD1C
+
+#include "Telemetry.h"
+#include "TelemetryStream.h"
+#include "Threads.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Streams the frames of a TelemetryChannel to the viewers connected to a UNIX socket,
+// or to a TCP port, in the messages of TelemetryStream.h. Its thread encodes every
+// frame once, as a delta with the previous one, for all of the viewers, and sends
+// keyframes every KEYFRAME_TICKS to the viewers that were already there. A viewer
+// that doesn't read fast enough misses frames while it has more than MAX_QUEUED_BYTES
+// waiting, and then gets a keyframe; the simulation never waits for it.
+class TelemetryServer {
+public:
+	static const int MAX_CLIENTS = 32;
+	static const uint32_t KEYFRAME_TICKS = 125;         // a second of race
+	static const size_t MAX_QUEUED_BYTES = 256 * 1024;  // for a viewer
+	static const size_t RESYNC_BYTES = 16 * 1024;       // left for a viewer that misses frames to get a keyframe
+
+	TelemetryServer(const TelemetryChannel & channel);
+	~TelemetryServer();
+
+	// port 0 for no TCP; the socket at path is not taken from another game that is running
+	bool start(const char * path, int port = 0);
+	void stop();
+
+	bool isRunning() const {
+		return NULL != mpThread;
+	}
+
+	// from the thread of the simulation, after every publish(); only wakes up the
+	// thread of the server, and only if there are viewers
+	void notify();
+
+private:
+	class Thread;
+	friend class Thread;
+
+	struct Client {
+		int fd;
+		bool synced;                // it got a keyframe, and every frame since
+		std::vector<uint8_t> out;   // queued
+		size_t sent;                // of out
+		unsigned int dropped;
+		bool gone;                  // removed after the events of the poll
+	};
+
+	const TelemetryChannel & mChannel;
+	Thread * mpThread;
+	std::string mPath;
+	int miUnixFd;
+	int miTcpFd;
+	int maWakeFds[2];            // a pipe
+	int miWakePending;
+	int miClientCount;           // for notify()
+	bool mbStopping;
+
+	std::vector<Client> mClients;
+	TelemetryFrame * mpFrame;
+	std::vector<uint32_t> mWords;
+	std::vector<uint32_t> mPrevious;
+	bool mbHavePrevious;
+	uint32_t miLastSequence;
+	uint32_t miKeyframeTick;
+	std::vector<uint8_t> mKeyframe;
+	std::vector<uint8_t> mDelta;
+
+	void run();
+	void accept(int listen_fd);
+	void broadcast();
+	void queue(Client & client, const std::vector<uint8_t> & message);
+	bool flush(Client & client); // false if it is gone
+	void removeClient(size_t i);
+
+	TelemetryServer(const TelemetryServer &);
+	TelemetryServer & operator=(const TelemetryServer &);
+};
+
+#endif // TELEMETRYSERVER_H_303A158E_919E_11E4_6B1D_10FEED04CD1C
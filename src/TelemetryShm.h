@@ -0,0 +1,96 @@
+#ifndef TELEMETRYSHM_H_0A9AC948_1D43_11E4_E489_10FEED04CD1C
+#define TELEMETRYSHM_H_0A9AC948_1D43_11E4_E489_10FEED04CD1C
+
+/*
+ * Layout of the telemetry frames, and of the shared memory segment where the game
+ * exports them, so that other local processes can follow the race without asking
+ * for it. This header is C too, see src/tools/TelemetryReader.c.
+ *
+ * The segment, /dev/shm/car_sim_telemetry on Linux, holds a TelemetryShmHeader and
+ * then a ring of TELEMETRY_SHM_SLOTS frames; frame n (from 0) is in slot
+ * n % slots, and the header counts the frames written so far. Every slot is a
+ * seqlock: its sequence is 2n + 1 while frame n is being written in it, and 2n + 2
+ * once it is there. To read frame n, check that the sequence of its slot is 2n + 2,
+ * copy the frame, and check that the sequence didn't change meanwhile. The ring lets
+ * a reader that is late by less than TELEMETRY_SHM_SLOTS ticks see every frame.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMETRY_FRAME_VERSION 1
+#define TELEMETRY_MAX_CARS 256
+
+#define TELEMETRY_SHM_NAME "/car_sim_telemetry"
+#define TELEMETRY_SHM_MAGIC "CARSHM01"
+#define TELEMETRY_SHM_VERSION 1
+#define TELEMETRY_SHM_SLOTS 8
+
+/* what every car is doing, in meters and seconds */
+struct CarTelemetry {
+	float position[3];
+	float speed[3];
+	float acceleration[3];
+	float angles[3];        /* yaw, pitch, roll, in radians */
+	float progress;         /* distance along the current lap */
+	float race_distance;    /* since the start of the race */
+	float gap;              /* seconds behind the leader */
+	int32_t current_checkpoint;
+	int32_t last_checkpoint;
+	int32_t lap;
+	int32_t standing;       /* 0 for the leader */
+	uint32_t timer_ms;      /* since the car started */
+	int32_t crash;          /* Car::crashflag */
+	int32_t slide;          /* Car::slideflag */
+};
+
+/* the whole race after a tick, with the same layout everywhere so that it can be
+   copied as it is; only the first car_count cars are valid */
+struct TelemetryFrame {
+#ifdef __cplusplus
+	static const uint32_t VERSION = TELEMETRY_FRAME_VERSION;
+	static const int MAX_CARS = TELEMETRY_MAX_CARS; /* the others are not published */
+#endif
+
+	uint32_t version;
+	uint32_t tick;          /* ticks since the start of the race */
+	uint32_t race_time_ms;
+	int32_t track;          /* id in the catalog */
+	int32_t player;         /* car of the player, -1 if none */
+	float lap_length;
+	int32_t car_count;
+	struct CarTelemetry cars[TELEMETRY_MAX_CARS];
+};
+
+struct TelemetryShmHeader {
+	char magic[8];          /* TELEMETRY_SHM_MAGIC */
+	uint32_t version;       /* TELEMETRY_SHM_VERSION, the frames have their own */
+	uint32_t header_size;   /* offset of the first slot */
+	uint32_t slot_size;
+	uint32_t slots;
+	int32_t writer_pid;     /* 0 once the game is gone */
+	uint32_t reserved;
+	uint64_t frames;        /* written so far */
+};
+
+struct TelemetryShmSlot {
+	uint32_t sequence;
+	uint32_t reserved;
+	struct TelemetryFrame frame;
+};
+
+#ifndef __cplusplus
+typedef struct CarTelemetry CarTelemetry;
+typedef struct TelemetryFrame TelemetryFrame;
+typedef struct TelemetryShmHeader TelemetryShmHeader;
+typedef struct TelemetryShmSlot TelemetryShmSlot;
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRYSHM_H_0A9AC948_1D43_11E4_E489_10FEED04CD1C
@@ -0,0 +1,137 @@
+#include "TelemetryStream.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+static const int HEADER_WORDS = offsetof(TelemetryFrame, cars) / sizeof(uint32_t);
+static const int CAR_WORDS = sizeof(CarTelemetry) / sizeof(uint32_t);
+
+static inline void putVarint(uint32_t value, std::vector<uint8_t> & out) {
+	while (value >= 0x80) {
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+// false if the varint doesn't end before end
+static inline bool getVarint(const uint8_t * & p, const uint8_t * end, uint32_t & value) {
+	value = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		if (p >= end) {
+			return false;
+		}
+		uint8_t byte = *p++;
+		value |= (uint32_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int getTelemetryWords(const TelemetryFrame & frame, uint32_t * words) {
+	int cars = std::min(std::max(frame.car_count, 0), (int)TelemetryFrame::MAX_CARS);
+	int count = HEADER_WORDS + cars * CAR_WORDS;
+	memcpy(words, &frame, count * sizeof(uint32_t));
+	memset(words + count, 0, (TELEMETRY_FRAME_WORDS - count) * sizeof(uint32_t));
+	return count;
+}
+
+void encodeTelemetryMessage(int type, const uint32_t * previous, const uint32_t * words, int count,
+	std::vector<uint8_t> & out)
+{
+	// all of the words, so that the cars that are gone are set to 0 at the other end too
+	std::vector<uint8_t> body;
+	body.reserve(64);
+	body.push_back((uint8_t)type);
+	putVarint(count, body);
+	int last = -1;
+	for (int i = 0; i < TELEMETRY_FRAME_WORDS; ++i) {
+		uint32_t before = (NULL != previous ? previous[i] : 0);
+		if (words[i] == before) {
+			continue;
+		}
+		uint32_t delta = words[i] - before;
+		putVarint(i - last - 1, body);
+		putVarint((delta << 1) ^ (uint32_t)((int32_t)delta >> 31), body);
+		last = i;
+	}
+	putVarint(body.size(), out);
+	out.insert(out.end(), body.begin(), body.end());
+}
+
+TelemetryStreamDecoder::TelemetryStreamDecoder() :
+	miRead(0),
+	mWords(TELEMETRY_FRAME_WORDS, 0),
+	mbSynced(false)
+{
+}
+
+void TelemetryStreamDecoder::feed(const uint8_t * data, size_t size) {
+	if (miRead > 0 && miRead == mBuffer.size()) {
+		mBuffer.clear();
+		miRead = 0;
+	} else if (miRead > 65536) {
+		mBuffer.erase(mBuffer.begin(), mBuffer.begin() + miRead);
+		miRead = 0;
+	}
+	mBuffer.insert(mBuffer.end(), data, data + size);
+}
+
+int TelemetryStreamDecoder::next(TelemetryFrame & frame, int * type) {
+	while (true) {
+		if (miRead >= mBuffer.size()) {
+			return 0;
+		}
+		const uint8_t * begin = &mBuffer[0] + miRead;
+		const uint8_t * end = &mBuffer[0] + mBuffer.size();
+		const uint8_t * p = begin;
+		uint32_t size;
+		if (!getVarint(p, end, size)) {
+			return (end - begin >= 5 ? -1 : 0);
+		}
+		if (size < 2 || size > MAX_MESSAGE_BYTES) {
+			return -1;
+		}
+		if ((size_t)(end - p) < size) {
+			return 0;
+		}
+		end = p + size;
+		miRead = end - &mBuffer[0];
+
+		int message_type = *p++;
+		uint32_t count;
+		if (!getVarint(p, end, count) || count > (uint32_t)TELEMETRY_FRAME_WORDS) {
+			return -1;
+		}
+		if (TELEMETRY_KEYFRAME == message_type) {
+			std::fill(mWords.begin(), mWords.end(), 0);
+			mbSynced = true;
+		} else if (TELEMETRY_DELTA != message_type) {
+			return -1;
+		} else if (!mbSynced) {
+			continue;
+		}
+
+		int index = -1;
+		while (p < end) {
+			uint32_t skip, delta;
+			if (!getVarint(p, end, skip) || !getVarint(p, end, delta)) {
+				return -1;
+			}
+			index += skip + 1;
+			if (index < 0 || index >= TELEMETRY_FRAME_WORDS) {
+				return -1;
+			}
+			mWords[index] += (delta >> 1) ^ (0u - (delta & 1));
+		}
+
+		memcpy(&frame, &mWords[0], count * sizeof(uint32_t));
+		if (NULL != type) {
+			*type = message_type;
+		}
+		return 1;
+	}
+}
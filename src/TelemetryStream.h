@@ -0,0 +1,59 @@
+#ifndef TELEMETRYSTREAM_H_5FA3C0E4_65B2_11E4_9FAF_10FEED04CD1C
+#define TELEMETRYSTREAM_H_5FA3C0E4_65B2_11E4_9FAF_10FEED04CD1C
+
+#include "TelemetryShm.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define TELEMETRY_SOCKET "/tmp/car_sim_telemetry.sock" // where the game streams it
+
+// Messages of the telemetry streamed by TelemetryServer. A TelemetryFrame is seen as
+// an array of 32 bits words, of which the header and the car_count cars are valid, the
+// others being 0. Every message is:
+//
+//   varint  number of bytes of the rest of the message
+//   byte    TELEMETRY_KEYFRAME or TELEMETRY_DELTA
+//   varint  number of valid words
+//   and for every word that changed, in order:
+//     varint  number of unchanged words since the previous one that changed
+//     varint  difference with the previous value of its bits, zigzagged
+//
+// A keyframe is the difference with a frame of zeros, for the viewers that join late
+// or that lost frames; a delta is the difference with the previous message.
+enum TelemetryMessageType {
+	TELEMETRY_KEYFRAME = 1,
+	TELEMETRY_DELTA = 2
+};
+
+static const int TELEMETRY_FRAME_WORDS = sizeof(TelemetryFrame) / sizeof(uint32_t);
+
+// the valid words of the frame; the others are set to 0
+int getTelemetryWords(const TelemetryFrame & frame, uint32_t * words);
+
+// appended to out
+void encodeTelemetryMessage(int type, const uint32_t * previous, const uint32_t * words, int count,
+	std::vector<uint8_t> & out);
+
+// The other end: the bytes as they are received, and the frames when they are whole.
+class TelemetryStreamDecoder {
+public:
+	static const size_t MAX_MESSAGE_BYTES = 16 + TELEMETRY_FRAME_WORDS * 10;
+
+	TelemetryStreamDecoder();
+
+	void feed(const uint8_t * data, size_t size);
+
+	// the next frame: 1 if there is one, 0 if more bytes are needed, and -1 if the
+	// stream is not valid. The deltas before the first keyframe are skipped.
+	int next(TelemetryFrame & frame, int * type = NULL);
+
+private:
+	std::vector<uint8_t> mBuffer;
+	size_t miRead;
+	std::vector<uint32_t> mWords;
+	bool mbSynced;
+};
+
+#endif // TELEMETRYSTREAM_H_5FA3C0E4_65B2_11E4_9FAF_10FEED04CD1C
@@ -5,8 +5,144 @@
 #include <signal.h>
 #include <sys/time.h>
 #include <time.h>
+#include <unistd.h>
 
 const pthread_mutex_t  Mutex::Initializer = PTHREAD_MUTEX_INITIALIZER;
 const pthread_mutex_t  RecursiveMutex::Initializer = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
 const pthread_cond_t   Condition::Initializer = PTHREAD_COND_INITIALIZER;
 const pthread_rwlock_t RWLock::Initializer = PTHREAD_RWLOCK_INITIALIZER;
+
+static __thread bool tsInsideParallelTask = false;
+static __thread int tsThreadIndex = 0;
+
+class ThreadPool::Worker : public ThreadBase {
+public:
+	Worker(ThreadPool * pool, int index) : mxPool(pool), miIndex(index) {
+	}
+
+	virtual void run();
+
+private:
+	ThreadPool * mxPool;
+	int miIndex;
+};
+
+void ThreadPool::Worker::run() {
+	tsInsideParallelTask = true;
+	tsThreadIndex = miIndex;
+	unsigned int generation = 0;
+	while (true) {
+		{
+			Mutex::MutexHolder lock(&mxPool->mMutex);
+			while (!mxPool->mbStopping && generation == mxPool->miGeneration) {
+				mxPool->mStartCondition.wait(mxPool->mMutex);
+			}
+			if (mxPool->mbStopping) {
+				return;
+			}
+			generation = mxPool->miGeneration;
+		}
+
+		mxPool->runRanges();
+
+		Mutex::MutexHolder lock(&mxPool->mMutex);
+		if (0 == --mxPool->miBusyWorkers) {
+			mxPool->mDoneCondition.signal();
+		}
+	}
+}
+
+ThreadPool::ThreadPool(int threads) :
+	miThreads(threads),
+	mpaWorkers(NULL),
+	miGeneration(0),
+	miBusyWorkers(0),
+	mbStopping(false),
+	mxTask(NULL),
+	miCount(0),
+	miGrain(1),
+	miNext(0)
+{
+	if (miThreads <= 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		miThreads = (cpus > 0 ? cpus : 1);
+	}
+	mpaWorkers = new Worker *[miThreads - 1];
+	for (int i = 0; i < miThreads - 1; ++i) {
+		mpaWorkers[i] = new Worker(this, i + 1);
+		if (!mpaWorkers[i]->start()) { // keep the ones that could be started
+			fprintf(stderr, "Unable to start worker thread %d\n", i);
+			delete mpaWorkers[i];
+			miThreads = i + 1;
+			break;
+		}
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		Mutex::MutexHolder lock(&mMutex);
+		mbStopping = true;
+		mStartCondition.broadcast();
+	}
+	for (int i = 0; i < miThreads - 1; ++i) {
+		mpaWorkers[i]->join();
+		delete mpaWorkers[i];
+	}
+	delete [] mpaWorkers;
+}
+
+int ThreadPool::getThreadIndex() {
+	return tsThreadIndex;
+}
+
+ThreadPool & ThreadPool::getDefault() {
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::runRanges() {
+	while (true) {
+		int begin = __sync_fetch_and_add(&miNext, miGrain);
+		if (begin >= miCount) {
+			return;
+		}
+		int end = (miCount - begin < miGrain ? miCount : begin + miGrain);
+		mxTask->run(begin, end);
+	}
+}
+
+void ThreadPool::parallelFor(int count, ParallelTask & task, int grain) {
+	if (count <= 0) {
+		return;
+	}
+	if (grain < 1) {
+		grain = 1;
+	}
+	if (tsInsideParallelTask || miThreads <= 1 || count <= grain) {
+		task.run(0, count);
+		return;
+	}
+
+	Mutex::MutexHolder caller_lock(&mCallerMutex);
+	{
+		Mutex::MutexHolder lock(&mMutex);
+		mxTask = &task;
+		miCount = count;
+		miGrain = grain;
+		miNext = 0;
+		miBusyWorkers = miThreads - 1;
+		++miGeneration;
+		mStartCondition.broadcast();
+	}
+
+	tsInsideParallelTask = true;
+	runRanges();
+	tsInsideParallelTask = false;
+
+	Mutex::MutexHolder lock(&mMutex);
+	while (miBusyWorkers > 0) {
+		mDoneCondition.wait(mMutex);
+	}
+	mxTask = NULL;
+}
@@ -290,4 +290,61 @@ private:
 	pthread_rwlock_t mPthrRWLock;
 };
 
+// Work that can be split in independent ranges of indices, see ThreadPool::parallelFor()
+class ParallelTask {
+public:
+	virtual ~ParallelTask() {
+	}
+
+	virtual void run(int begin, int end) = 0;
+};
+
+// Fixed set of worker threads that share the ranges of a ParallelTask with the
+// calling thread. Only one task runs at a time; parallelFor() called from inside
+// a task runs serially in the calling thread.
+class ThreadPool {
+public:
+	ThreadPool(int threads = 0); // 0 = as many threads as online processors
+	~ThreadPool();
+
+	int getNumberOfThreads() const { // including the thread calling parallelFor()
+		return miThreads;
+	}
+
+	// call task.run() over [0, count) in ranges of grain indices, and wait for all of them
+	void parallelFor(int count, ParallelTask & task, int grain = 1);
+
+	// from inside of a task, which of the threads of the pool runs it: 0 for the one
+	// that called parallelFor(), up to getNumberOfThreads() - 1 for the workers. It lets
+	// the tasks keep per thread results without locking.
+	static int getThreadIndex();
+
+	static ThreadPool & getDefault();
+
+private:
+	class Worker;
+	friend class Worker;
+
+	int miThreads;
+	Worker ** mpaWorkers;
+
+	Mutex mCallerMutex; // one parallelFor() at a time
+	Mutex mMutex;
+	Condition mStartCondition;
+	Condition mDoneCondition;
+	unsigned int miGeneration;
+	int miBusyWorkers;
+	bool mbStopping;
+
+	ParallelTask * mxTask;
+	int miCount;
+	int miGrain;
+	int miNext;
+
+	void runRanges();
+
+	ThreadPool(const ThreadPool &);
+	ThreadPool & operator=(const ThreadPool &);
+};
+
 #endif // THREADS_H_93AC6A3A_6098_11E4_B320_10FEED04CD1C
@@ -0,0 +1,590 @@
+#include "TileMap.h"
+#include "DistanceTransform.h"
+#include "ProgressField.h"
+#include "Common.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+const uint8_t TileMap::OUTSIDE[TileMap::BYTES_PER_PIXEL] = { 0, 0, 0, 0 };
+const char TileMap::MAGIC[8] = { 'C', 'A', 'R', 'T', 'I', 'L', 'E', '4' };
+
+// Background thread that reads the prefetched tiles from the file
+class TileMap::Loader : public ThreadBase {
+public:
+	Loader(TileMap * map) : mxMap(map), KeepRunning(true) {
+	}
+
+	bool stop() {
+		{
+			Mutex::MutexHolder lock(&mxMap->mMutex);
+			KeepRunning = false;
+			mxMap->mCondition.broadcast();
+		}
+		return join();
+	}
+
+	virtual void run();
+
+private:
+	TileMap * mxMap;
+	volatile bool KeepRunning;
+};
+
+void TileMap::Loader::run() {
+	while (true) {
+		TileRequest request;
+		{
+			Mutex::MutexHolder lock(&mxMap->mMutex);
+			while (KeepRunning && mxMap->mRequests.empty()) {
+				mxMap->mCondition.wait(mxMap->mMutex);
+			}
+			if (!KeepRunning) {
+				return;
+			}
+			request = mxMap->mRequests.front();
+			mxMap->mRequests.pop_front();
+		}
+		if (NULL == __atomic_load_n(&mxMap->mpaTiles[request.layer][request.index], __ATOMIC_ACQUIRE)) {
+			mxMap->loadTile(request.layer, request.index);
+		}
+	}
+}
+
+TileMap::TileMap() :
+	miWidth(0),
+	miHeight(0),
+	miTileShift(DEFAULT_TILE_SHIFT),
+	miTilesX(0),
+	miTilesY(0),
+	mfLapLength(0),
+	miResidentTiles(0),
+	miMaxTiles(0),
+	miStamp(0),
+	miFile(-1),
+	mpaOffsets(NULL),
+	mpaFill(NULL),
+	mpLoader(NULL)
+{
+	for (int l = 0; l < NB_LAYERS; ++l) {
+		mpaTiles[l] = NULL;
+	}
+}
+
+TileMap::~TileMap() {
+	close();
+}
+
+void TileMap::freeTiles() {
+	for (size_t i = 0; i < mResident.size(); ++i) {
+		free(mResident[i]->pixels);
+		delete mResident[i];
+	}
+	mResident.clear();
+	miResidentTiles = 0;
+	for (int l = 0; l < NB_LAYERS; ++l) {
+		delete [] mpaTiles[l];
+		mpaTiles[l] = NULL;
+	}
+}
+
+void TileMap::close() {
+	if (NULL != mpLoader) {
+		mpLoader->stop();
+		delete mpLoader;
+		mpLoader = NULL;
+	}
+	mRequests.clear();
+	freeTiles();
+	if (miFile >= 0) {
+		::close(miFile);
+		miFile = -1;
+	}
+	delete [] mpaOffsets;
+	mpaOffsets = NULL;
+	delete [] mpaFill;
+	mpaFill = NULL;
+	miWidth = miHeight = 0;
+	miTilesX = miTilesY = 0;
+	mCheckpoints.clear();
+	mfLapLength = 0;
+}
+
+bool TileMap::create(int width, int height, int tile_shift) {
+	close();
+	if (width <= 0 || height <= 0 || tile_shift < 4 || tile_shift > 12) {
+		return false;
+	}
+	miWidth = width;
+	miHeight = height;
+	miTileShift = tile_shift;
+	miTilesX = (width  + (1 << tile_shift) - 1) >> tile_shift;
+	miTilesY = (height + (1 << tile_shift) - 1) >> tile_shift;
+
+	int count = miTilesX * miTilesY;
+	for (int l = 0; l < NB_LAYERS; ++l) {
+		mpaTiles[l] = new Tile * [count];
+		for (int i = 0; i < count; ++i) {
+			Tile * tile = new Tile;
+			tile->pixels = (uint8_t *)calloc(getTileBytes(), 1);
+			tile->stamp = 0;
+			tile->layer = l;
+			tile->index = i;
+			mpaTiles[l][i] = tile;
+			mResident.push_back(tile);
+		}
+	}
+	miResidentTiles = mResident.size();
+	miMaxTiles = miResidentTiles;
+	return true;
+}
+
+bool TileMap::open(const char * filename, size_t max_bytes) {
+	close();
+
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	TileFileHeader header;
+	if (
+		pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+		memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+		header.layers != NB_LAYERS ||
+		header.tile_shift < 4 || header.tile_shift > 12 ||
+		header.tiles_x != ((header.width  + (1u << header.tile_shift) - 1) >> header.tile_shift) ||
+		header.tiles_y != ((header.height + (1u << header.tile_shift) - 1) >> header.tile_shift) ||
+		header.checkpoints > MAX_CHECKPOINTS
+	) {
+		printErrorLog("Invalid tile file %s", filename);
+		::close(fd);
+		return false;
+	}
+
+	miWidth = header.width;
+	miHeight = header.height;
+	miTileShift = header.tile_shift;
+	miTilesX = header.tiles_x;
+	miTilesY = header.tiles_y;
+	mfLapLength = header.lap_length;
+
+	size_t count = (size_t)miTilesX * miTilesY;
+	mpaOffsets = new uint64_t[NB_LAYERS * count];
+	mpaFill = new uint32_t[NB_LAYERS * count];
+	mCheckpoints.resize(header.checkpoints);
+	size_t checkpoint_bytes = header.checkpoints * sizeof(Checkpoint);
+	off_t pos = sizeof(header) + checkpoint_bytes;
+	if (
+		(checkpoint_bytes > 0 && pread(fd, &mCheckpoints[0], checkpoint_bytes, sizeof(header)) != (ssize_t)checkpoint_bytes) ||
+		pread(fd, mpaOffsets, NB_LAYERS * count * sizeof(uint64_t), pos) != (ssize_t)(NB_LAYERS * count * sizeof(uint64_t)) ||
+		pread(fd, mpaFill, NB_LAYERS * count * sizeof(uint32_t), pos + NB_LAYERS * count * sizeof(uint64_t)) != (ssize_t)(NB_LAYERS * count * sizeof(uint32_t))
+	) {
+		printErrorLog("Truncated tile file %s", filename);
+		::close(fd);
+		close();
+		return false;
+	}
+
+	for (int l = 0; l < NB_LAYERS; ++l) {
+		mpaTiles[l] = new Tile * [count];
+		memset(mpaTiles[l], 0, count * sizeof(Tile *));
+	}
+
+	miFile = fd;
+	miMaxTiles = max_bytes / getTileBytes();
+	if (miMaxTiles < 9 * NB_LAYERS) { // at least the neighbourhood of one car
+		miMaxTiles = 9 * NB_LAYERS;
+	}
+
+	mpLoader = new Loader(this);
+	if (!mpLoader->start()) {
+		delete mpLoader;
+		mpLoader = NULL;
+	}
+	return true;
+}
+
+bool TileMap::readTile(int layer, int index, uint8_t * pixels) {
+	size_t slot = (size_t)layer * miTilesX * miTilesY + index;
+	if (0 == mpaOffsets[slot]) { // uniform tile
+		uint32_t fill = mpaFill[slot];
+		uint8_t rgba[BYTES_PER_PIXEL] = {
+			(uint8_t)(fill), (uint8_t)(fill >> 8), (uint8_t)(fill >> 16), (uint8_t)(fill >> 24)
+		};
+		size_t n = (size_t)1 << (2 * miTileShift);
+		for (size_t i = 0; i < n; ++i) {
+			memcpy(pixels + i * BYTES_PER_PIXEL, rgba, BYTES_PER_PIXEL);
+		}
+		return true;
+	}
+	return pread(miFile, pixels, getTileBytes(), mpaOffsets[slot]) == (ssize_t)getTileBytes();
+}
+
+TileMap::Tile * TileMap::loadTile(int layer, int index) {
+	uint8_t * pixels = (uint8_t *)malloc(getTileBytes());
+	if (!isStreamed() || !readTile(layer, index, pixels)) {
+		printErrorLog("Unable to read tile %d of layer %d", index, layer);
+		memset(pixels, 0, getTileBytes());
+	}
+
+	Mutex::MutexHolder lock(&mMutex);
+	Tile * tile = mpaTiles[layer][index];
+	if (NULL != tile) { // somebody else was faster
+		free(pixels);
+		return tile;
+	}
+	tile = new Tile;
+	tile->pixels = pixels;
+	tile->stamp = miStamp;
+	tile->layer = layer;
+	tile->index = index;
+	mResident.push_back(tile);
+	++miResidentTiles;
+	__atomic_store_n(&mpaTiles[layer][index], tile, __ATOMIC_RELEASE);
+	return tile;
+}
+
+uint8_t * TileMap::getTilePixels(Layer layer, int tx, int ty) {
+	if (tx < 0 || ty < 0 || tx >= miTilesX || ty >= miTilesY) {
+		return NULL;
+	}
+	Tile * tile = getTile(layer, tx + ty * miTilesX);
+	tile->stamp = miStamp;
+	return tile->pixels;
+}
+
+void TileMap::put(Layer layer, int x, int y, const uint8_t * rgba) {
+	if (x < 0 || y < 0 || x >= miWidth || y >= miHeight) {
+		return;
+	}
+	Tile * tile = getTile(layer, (x >> miTileShift) + (y >> miTileShift) * miTilesX);
+	int mask = (1 << miTileShift) - 1;
+	memcpy(tile->pixels + (((y & mask) << miTileShift) + (x & mask)) * BYTES_PER_PIXEL, rgba, BYTES_PER_PIXEL);
+	tile->stamp = miStamp;
+}
+
+// NOTE: mMutex must be held by the caller
+void TileMap::requestTile(int layer, int tx, int ty) {
+	if (tx < 0 || ty < 0 || tx >= miTilesX || ty >= miTilesY) {
+		return;
+	}
+	int index = tx + ty * miTilesX;
+	Tile * tile = mpaTiles[layer][index];
+	if (NULL != tile) {
+		tile->stamp = miStamp;
+		return;
+	}
+	for (size_t i = 0; i < mRequests.size(); ++i) {
+		if (mRequests[i].layer == layer && mRequests[i].index == index) {
+			return;
+		}
+	}
+	TileRequest request;
+	request.layer = layer;
+	request.index = index;
+	mRequests.push_back(request);
+}
+
+struct TileStampOrder {
+	template <typename T> bool operator()(const T * a, const T * b) const {
+		return a->stamp < b->stamp;
+	}
+};
+
+// NOTE: mMutex must be held by the caller
+void TileMap::evict() {
+	// leave room for the tiles that are about to be prefetched
+	size_t max_tiles = (mRequests.size() < miMaxTiles ? miMaxTiles - mRequests.size() : 0);
+	if (miResidentTiles <= max_tiles) {
+		return;
+	}
+	std::sort(mResident.begin(), mResident.end(), TileStampOrder());
+	size_t evicted = 0;
+	while (miResidentTiles > max_tiles && evicted < mResident.size()) {
+		Tile * tile = mResident[evicted];
+		if (tile->stamp == miStamp) { // needed around the current points of interest
+			break;
+		}
+		mpaTiles[tile->layer][tile->index] = NULL;
+		free(tile->pixels);
+		delete tile;
+		--miResidentTiles;
+		++evicted;
+	}
+	mResident.erase(mResident.begin(), mResident.begin() + evicted);
+}
+
+void TileMap::update(const Focus * focus, int count) {
+	if (!isStreamed()) {
+		return;
+	}
+
+	++miStamp;
+
+	// the tiles right under the cars are needed now
+	for (int i = 0; i < count; ++i) {
+		functionAt(focus[i].x, focus[i].y);
+	}
+
+	Mutex::MutexHolder lock(&mMutex);
+	for (int i = 0; i < count; ++i) {
+		int tx = (int)floorf(focus[i].x) >> miTileShift;
+		int ty = (int)floorf(focus[i].y) >> miTileShift;
+		for (int l = 0; l < NB_LAYERS; ++l) {
+			for (int dy = -1; dy <= 1; ++dy) {
+				for (int dx = -1; dx <= 1; ++dx) {
+					requestTile(l, tx + dx, ty + dy);
+				}
+			}
+		}
+
+		float len = sqrtf(focus[i].dx * focus[i].dx + focus[i].dy * focus[i].dy);
+		if (len > 0) {
+			float step = (float)(1 << miTileShift) / len;
+			for (int k = 2; k <= 1 + PREFETCH_TILES; ++k) {
+				int px = (int)floorf(focus[i].x + focus[i].dx * step * k) >> miTileShift;
+				int py = (int)floorf(focus[i].y + focus[i].dy * step * k) >> miTileShift;
+				for (int l = 0; l < NB_LAYERS; ++l) {
+					requestTile(l, px, py);
+				}
+			}
+		}
+	}
+	if (!mRequests.empty()) {
+		mCondition.signal();
+	}
+
+	evict();
+}
+
+bool TileMap::save(const char * filename) {
+	if (isStreamed() || 0 == miWidth) {
+		return false;
+	}
+
+	FILE * f = fopen(filename, "wb");
+	if (NULL == f) {
+		printErrorLog("Unable to create %s", filename);
+		return false;
+	}
+
+	TileFileHeader header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.width = miWidth;
+	header.height = miHeight;
+	header.tile_shift = miTileShift;
+	header.layers = NB_LAYERS;
+	header.tiles_x = miTilesX;
+	header.tiles_y = miTilesY;
+	header.checkpoints = mCheckpoints.size();
+	header.lap_length = mfLapLength;
+
+	size_t count = (size_t)miTilesX * miTilesY;
+	std::vector<uint64_t> offsets(NB_LAYERS * count, 0);
+	std::vector<uint32_t> fill(NB_LAYERS * count, 0);
+	uint64_t pos = sizeof(header) + mCheckpoints.size() * sizeof(Checkpoint) + NB_LAYERS * count * (sizeof(uint64_t) + sizeof(uint32_t));
+
+	size_t pixels = (size_t)1 << (2 * miTileShift);
+	for (int l = 0; l < NB_LAYERS; ++l) {
+		for (size_t i = 0; i < count; ++i) {
+			const uint8_t * p = mpaTiles[l][i]->pixels;
+			bool uniform = true;
+			for (size_t k = 1; k < pixels && uniform; ++k) {
+				uniform = (memcmp(p, p + k * BYTES_PER_PIXEL, BYTES_PER_PIXEL) == 0);
+			}
+			if (uniform) {
+				fill[l * count + i] = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+			} else {
+				offsets[l * count + i] = pos;
+				pos += getTileBytes();
+			}
+		}
+	}
+
+	bool ok =
+		fwrite(&header, sizeof(header), 1, f) == 1 &&
+		(mCheckpoints.empty() || fwrite(&mCheckpoints[0], sizeof(Checkpoint), mCheckpoints.size(), f) == mCheckpoints.size()) &&
+		fwrite(&offsets[0], sizeof(uint64_t), offsets.size(), f) == offsets.size() &&
+		fwrite(&fill[0], sizeof(uint32_t), fill.size(), f) == fill.size();
+	for (int l = 0; l < NB_LAYERS && ok; ++l) {
+		for (size_t i = 0; i < count && ok; ++i) {
+			if (0 != offsets[l * count + i]) {
+				ok = fwrite(mpaTiles[l][i]->pixels, getTileBytes(), 1, f) == 1;
+			}
+		}
+	}
+	if (fclose(f) != 0) {
+		ok = false;
+	}
+	if (!ok) {
+		printErrorLog("Error writing %s", filename);
+	}
+	return ok;
+}
+
+void TileMap::highlightHeightBorders() {
+	static const uint8_t alpha = 255;
+
+	for (int x = 0; x < miWidth; ++x) {
+		uint8_t prev_b = 0;
+		for (int y = 0; y < miHeight; ++y) {
+			uint8_t b = functionAt(x, y)[2];
+			if (0 != y) {
+				if ( (prev_b / 4) != (b / 4) ) {
+					uint8_t grey[BYTES_PER_PIXEL] = { b, b, b, alpha };
+					put(LAYER_DISPLAY, x, y, grey);
+				}
+			}
+			prev_b = b;
+		}
+	}
+
+	for (int y = 0; y < miHeight; ++y) {
+		uint8_t prev_b = 0;
+		for (int x = 0; x < miWidth; ++x) {
+			uint8_t b = functionAt(x, y)[2];
+			if (0 != x) {
+				if ( (prev_b / 4) != (b / 4) ) {
+					uint8_t grey[BYTES_PER_PIXEL] = { b, b, b, alpha };
+					put(LAYER_DISPLAY, x, y, grey);
+				}
+			}
+			prev_b = b;
+		}
+	}
+}
+
+bool TileMap::computeDistanceField() {
+	if (isStreamed() || 0 == miWidth || 0 == miHeight) {
+		return false;
+	}
+
+	std::vector<uint8_t> walls((size_t)miWidth * miHeight);
+	for (int y = 0; y < miHeight; ++y) {
+		for (int x = 0; x < miWidth; ++x) {
+			walls[(size_t)y * miWidth + x] = (0 == functionAt(x, y)[1]);
+		}
+	}
+
+	std::vector<float> distance(walls.size());
+	signedDistanceTransform(&walls[0], miWidth, miHeight, &distance[0]);
+
+	int size = getTileSize();
+	for (int ty = 0; ty < miTilesY; ++ty) {
+		for (int tx = 0; tx < miTilesX; ++tx) {
+			uint8_t * pixels = getTilePixels(LAYER_FUNCTION, tx, ty);
+			int w = std::min(size, miWidth - tx * size);
+			int h = std::min(size, miHeight - ty * size);
+			for (int y = 0; y < h; ++y) {
+				const float * row = &distance[(size_t)(ty * size + y) * miWidth + tx * size];
+				uint8_t * pixel = pixels + y * size * BYTES_PER_PIXEL;
+				int map_y = ty * size + y;
+				int border_y = std::min(map_y, miHeight - 1 - map_y);
+				for (int x = 0; x < w; ++x, pixel += BYTES_PER_PIXEL) {
+					// outside of the map is a wall too, half a pixel away from the last ones
+					int map_x = tx * size + x;
+					float border = std::min(std::min(map_x, miWidth - 1 - map_x), border_y) + 0.5;
+					float value = floor(std::min(row[x], border) * DISTANCE_STEPS + 0.5) + DISTANCE_ZERO;
+					pixel[3] = (value < 0 ? 0 : (value > 255 ? 255 : value));
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// sphere tracing: every step goes as far as the clearance at the current point allows,
+// minus one pixel because the distances are measured from the centres of the pixels
+float TileMap::traceSegment(float x0, float y0, float x1, float y1) {
+	static const float MIN_STEP = 0.5;
+
+	float dx = x1 - x0;
+	float dy = y1 - y0;
+	float length = sqrt(dx * dx + dy * dy);
+	if (length < MIN_STEP) {
+		return (distanceAt(x1, y1) > 0 ? 1 : 0);
+	}
+	dx /= length;
+	dy /= length;
+
+	float t = 0;
+	while (true) {
+		float d = distanceAt(x0 + dx * t, y0 + dy * t);
+		if (d <= 0) {
+			return t / length;
+		}
+		if (t >= length) {
+			return 1;
+		}
+		t = std::min(t + std::max(d - 1, MIN_STEP), length);
+	}
+}
+
+// checkpoint (red / 8) and road quality (green) of every pixel of the function layer
+void TileMap::getFunctionPlanes(std::vector<uint8_t> & checkpoint, std::vector<uint8_t> & road) {
+	size_t count = (size_t)miWidth * miHeight;
+	checkpoint.resize(count);
+	road.resize(count);
+	for (int y = 0; y < miHeight; ++y) {
+		for (int x = 0; x < miWidth; ++x) {
+			const uint8_t * c = functionAt(x, y);
+			size_t i = (size_t)y * miWidth + x;
+			checkpoint[i] = c[0] / 8;
+			road[i] = c[1];
+		}
+	}
+}
+
+bool TileMap::computeCheckpoints() {
+	if (isStreamed() || 0 == miWidth || 0 == miHeight) {
+		return false;
+	}
+
+	std::vector<uint8_t> checkpoint;
+	std::vector<uint8_t> road;
+	getFunctionPlanes(checkpoint, road);
+	int count = scanCheckpoints(&checkpoint[0], &road[0], miWidth, miHeight, mCheckpoints);
+	for (int k = 0; k < count; ++k) {
+		if (0 == mCheckpoints[k].pixels) {
+			printWarningLog("Checkpoint %d of %d is missing", k, count);
+		}
+	}
+	return count > 0;
+}
+
+bool TileMap::computeProgressField() {
+	if (isStreamed() || 0 == miWidth || 0 == miHeight) {
+		return false;
+	}
+
+	std::vector<uint8_t> checkpoint;
+	std::vector<uint8_t> road;
+	getFunctionPlanes(checkpoint, road);
+	size_t count = checkpoint.size();
+
+	std::vector<float> progress(count);
+	mfLapLength = ::computeProgressField(&checkpoint[0], &road[0], miWidth, miHeight, getCheckpoints(), &progress[0]);
+
+	int size = getTileSize();
+	for (int ty = 0; ty < miTilesY; ++ty) {
+		for (int tx = 0; tx < miTilesX; ++tx) {
+			uint8_t * pixels = getTilePixels(LAYER_PROGRESS, tx, ty);
+			int w = std::min(size, miWidth - tx * size);
+			int h = std::min(size, miHeight - ty * size);
+			for (int y = 0; y < h; ++y) {
+				memcpy(
+					pixels + y * size * BYTES_PER_PIXEL,
+					&progress[(size_t)(ty * size + y) * miWidth + tx * size],
+					w * sizeof(float)
+				);
+			}
+		}
+	}
+	return mfLapLength > 0;
+}
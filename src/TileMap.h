@@ -0,0 +1,217 @@
+#ifndef TILEMAP_H_AC4A3E60_3D1B_11E4_5C21_10FEED04CD1C
+#define TILEMAP_H_AC4A3E60_3D1B_11E4_5C21_10FEED04CD1C
+
+#include "Threads.h"
+#include "Checkpoints.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+
+// Track images split in square tiles of RGBA bytes, one set of tiles per layer.
+//
+// A map is either resident (built in memory, every tile loaded) or streamed from
+// a tile file, in which case tiles are paged in on demand and the least recently
+// used ones are evicted in update(), so memory stays bounded whatever the size
+// of the track.
+//
+// Tile file layout (little endian):
+//   TileFileHeader ("CARTILE4": distance field in the function layer, and progress layer)
+//   Checkpoint checkpoint[checkpoints]
+//   uint64_t offset[layers][tiles_y][tiles_x]  (0 if the tile is uniform)
+//   uint32_t fill[layers][tiles_y][tiles_x]    (RGBA value of uniform tiles)
+//   raw tiles, tile_size * tile_size * 4 bytes each
+class TileMap {
+public:
+	enum Layer {
+		LAYER_FUNCTION, // red = checkpoints; green = road quality; blue = map height; alpha = distance to the walls
+		LAYER_DISPLAY,  // what is shown on the screen
+		LAYER_PROGRESS, // float distance along the racing direction from the start line
+		NB_LAYERS
+	};
+
+	static const int BYTES_PER_PIXEL = 4;
+	static const int DEFAULT_TILE_SHIFT = 8; // 256x256 pixel tiles
+	static const int MAX_CHECKPOINTS = 32; // the checkpoint is the red of the function layer / 8
+
+	// encoding of the signed distance to the walls (green = 0) in the alpha of the
+	// function layer, in quarters of pixel: from -32 (inside of a wall) to +31.75
+	static const int DISTANCE_ZERO = 128;
+	static const int DISTANCE_STEPS = 4;
+
+	struct Focus { // a point of interest, usually a car, and where it is heading to
+		float x;
+		float y;
+		float dx;
+		float dy;
+	};
+
+	TileMap();
+	~TileMap();
+
+	bool create(int width, int height, int tile_shift = DEFAULT_TILE_SHIFT);
+	bool open(const char * filename, size_t max_bytes);
+	bool save(const char * filename);
+	void close();
+
+	bool isStreamed() const {
+		return miFile >= 0;
+	}
+	int getWidth() const {
+		return miWidth;
+	}
+	int getHeight() const {
+		return miHeight;
+	}
+	int getTileSize() const {
+		return 1 << miTileShift;
+	}
+	int getTilesX() const {
+		return miTilesX;
+	}
+	int getTilesY() const {
+		return miTilesY;
+	}
+	int getCheckpoints() const {
+		return mCheckpoints.size();
+	}
+	const Checkpoint & getCheckpoint(int k) const {
+		return mCheckpoints[k];
+	}
+	float getLapLength() const { // 0 if there is no progress layer
+		return mfLapLength;
+	}
+	size_t getTileBytes() const {
+		return (size_t)BYTES_PER_PIXEL << (2 * miTileShift);
+	}
+	size_t getResidentBytes() const {
+		return miResidentTiles * getTileBytes();
+	}
+
+	// RGBA bytes of the pixel at (x, y); outside of the map everything is 0 (a wall)
+	const uint8_t * at(Layer layer, int x, int y) {
+		if (x < 0 || y < 0 || x >= miWidth || y >= miHeight) {
+			return OUTSIDE;
+		}
+		Tile * tile = getTile(layer, (x >> miTileShift) + (y >> miTileShift) * miTilesX);
+		tile->stamp = miStamp;
+		int mask = (1 << miTileShift) - 1;
+		return tile->pixels + (((y & mask) << miTileShift) + (x & mask)) * BYTES_PER_PIXEL;
+	}
+	const uint8_t * functionAt(int x, int y) {
+		return at(LAYER_FUNCTION, x, y);
+	}
+
+	// distance in pixels to the nearest wall, negative inside of them
+	float distanceAt(int x, int y) {
+		return (float)(functionAt(x, y)[3] - DISTANCE_ZERO) / DISTANCE_STEPS;
+	}
+
+	// distance in pixels along the racing direction from the start line, negative if unknown
+	float progressAt(int x, int y) {
+		float progress;
+		memcpy(&progress, at(LAYER_PROGRESS, x, y), sizeof(progress));
+		return progress;
+	}
+
+	// fraction of the segment that can be travelled before entering a wall, 1 if it is clear
+	float traceSegment(float x0, float y0, float x1, float y1);
+
+	void put(Layer layer, int x, int y, const uint8_t * rgba);
+
+	// pixels of a whole tile (tile_size * tile_size * 4 bytes), loading it if needed
+	uint8_t * getTilePixels(Layer layer, int tx, int ty);
+
+	// page in the tiles around the given points, queue their neighbours along the
+	// heading of each one for prefetching, and evict what doesn't fit in memory.
+	// It must not be called while other threads are reading from the map.
+	void update(const Focus * focus, int count);
+
+	// draw the borders between the height levels of the function map on the display
+	void highlightHeightBorders();
+
+	// fill the alpha of the function layer with the distance to the walls (resident maps only)
+	bool computeDistanceField();
+
+	// find the checkpoints in the function layer (resident maps only)
+	bool computeCheckpoints();
+
+	// fill the progress layer, once the checkpoints are known (resident maps only)
+	bool computeProgressField();
+
+private:
+	struct Tile {
+		uint8_t * pixels;
+		unsigned int stamp;
+		int layer;
+		int index;
+	};
+
+	struct TileFileHeader {
+		char magic[8];
+		uint32_t width;
+		uint32_t height;
+		uint32_t tile_shift;
+		uint32_t layers;
+		uint32_t tiles_x;
+		uint32_t tiles_y;
+		uint32_t checkpoints;
+		float lap_length;
+	};
+
+	struct TileRequest {
+		int layer;
+		int index;
+	};
+
+	class Loader;
+	friend class Loader;
+
+	static const uint8_t OUTSIDE[BYTES_PER_PIXEL];
+	static const char MAGIC[8];
+	static const int PREFETCH_TILES = 2;
+
+	int miWidth;
+	int miHeight;
+	int miTileShift;
+	int miTilesX;
+	int miTilesY;
+	std::vector<Checkpoint> mCheckpoints;
+	float mfLapLength;
+
+	Tile ** mpaTiles[NB_LAYERS];
+	std::vector<Tile *> mResident;
+	size_t miResidentTiles;
+	size_t miMaxTiles;
+	unsigned int miStamp;
+
+	int miFile;
+	uint64_t * mpaOffsets;
+	uint32_t * mpaFill;
+
+	Mutex mMutex;
+	Condition mCondition;
+	std::deque<TileRequest> mRequests;
+	Loader * mpLoader;
+
+	Tile * getTile(Layer layer, int index) {
+		Tile * tile = __atomic_load_n(&mpaTiles[layer][index], __ATOMIC_ACQUIRE);
+		if (NULL == tile) {
+			tile = loadTile(layer, index);
+		}
+		return tile;
+	}
+	Tile * loadTile(int layer, int index);
+	bool readTile(int layer, int index, uint8_t * pixels);
+	void requestTile(int layer, int tx, int ty);
+	void evict();
+	void freeTiles();
+	void getFunctionPlanes(std::vector<uint8_t> & checkpoint, std::vector<uint8_t> & road);
+
+	TileMap(const TileMap &);
+	TileMap & operator=(const TileMap &);
+};
+
+#endif // TILEMAP_H_AC4A3E60_3D1B_11E4_5C21_10FEED04CD1C
@@ -0,0 +1,188 @@
+#include "TrackCache.h"
+#include "SdlUtils.h"
+#include "Common.h"
+
+#include <cstdio>
+#include <cstring>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+TrackData::TrackData(int id) :
+	miId(id),
+	miRefCount(0),
+	miBytes(0)
+{
+}
+
+TrackData::~TrackData() {
+}
+
+TrackCache::TrackCache(const TrackCatalog & catalog, size_t max_bytes, size_t max_streamed_bytes) :
+	mxCatalog(catalog),
+	miUsedBytes(0),
+	miMaxBytes(max_bytes),
+	miMaxStreamedBytes(max_streamed_bytes)
+{
+}
+
+TrackCache::~TrackCache() {
+	for (LruList::iterator it = mLru.begin(); it != mLru.end(); ++it) {
+		if ((*it)->miRefCount != 0) {
+			printWarningLog("Track %d still in use when destroying the cache", (*it)->miId);
+		}
+		delete *it;
+	}
+	mLru.clear();
+	mIndex.clear();
+}
+
+TrackData * TrackCache::acquire(int id) {
+	Mutex::MutexHolder lock(&mMutex);
+
+	LruIndex::iterator found = mIndex.find(id);
+	if (found != mIndex.end()) { // hit: move it to the front of the list
+		mLru.splice(mLru.begin(), mLru, found->second);
+		TrackData * track = mLru.front();
+		++track->miRefCount;
+		return track;
+	}
+
+	TrackData * track = load(id);
+	if (NULL == track) {
+		return NULL;
+	}
+	++track->miRefCount;
+	mLru.push_front(track);
+	mIndex[id] = mLru.begin();
+	miUsedBytes += track->miBytes;
+
+	evict(miMaxBytes);
+	return track;
+}
+
+void TrackCache::release(TrackData * track) {
+	if (NULL == track) {
+		return;
+	}
+	Mutex::MutexHolder lock(&mMutex);
+	if (track->miRefCount > 0) {
+		--track->miRefCount;
+	}
+	evict(miMaxBytes);
+}
+
+void TrackCache::trim() {
+	Mutex::MutexHolder lock(&mMutex);
+	evict(miMaxBytes);
+}
+
+void TrackCache::clear() {
+	Mutex::MutexHolder lock(&mMutex);
+	evict(0);
+}
+
+// NOTE: mMutex must be held by the caller
+void TrackCache::evict(size_t limit) {
+	LruList::iterator it = mLru.end();
+	while (miUsedBytes > limit && it != mLru.begin()) {
+		--it;
+		TrackData * track = *it;
+		if (track->miRefCount != 0) {
+			continue;
+		}
+		miUsedBytes -= track->miBytes;
+		mIndex.erase(track->miId);
+		it = mLru.erase(it);
+		delete track;
+	}
+}
+
+// copy a surface into a layer of the map, which must be at least as big as the surface
+static bool copySurfaceToLayer(SDL_Surface * surface, TileMap & map, TileMap::Layer layer) {
+	SDL_Surface * rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA_BYTES, 0);
+	if (NULL == rgba) {
+		return false;
+	}
+	int tile_size = map.getTileSize();
+	size_t row_bytes = (size_t)tile_size * TileMap::BYTES_PER_PIXEL;
+	for (int ty = 0; ty < map.getTilesY(); ++ty) {
+		for (int tx = 0; tx < map.getTilesX(); ++tx) {
+			uint8_t * pixels = map.getTilePixels(layer, tx, ty);
+			int x0 = tx * tile_size;
+			int y0 = ty * tile_size;
+			int w = (rgba->w - x0 < tile_size ? rgba->w - x0 : tile_size);
+			int h = (rgba->h - y0 < tile_size ? rgba->h - y0 : tile_size);
+			if (w <= 0 || h <= 0) {
+				continue;
+			}
+			for (int y = 0; y < h; ++y) {
+				memcpy(
+					pixels + y * row_bytes,
+					(Uint8 *)rgba->pixels + (y0 + y) * rgba->pitch + x0 * TileMap::BYTES_PER_PIXEL,
+					w * TileMap::BYTES_PER_PIXEL
+				);
+			}
+		}
+	}
+	SDL_FreeSurface(rgba);
+	return true;
+}
+
+bool TrackCache::loadImages(const std::string & basename, TileMap & map) {
+	std::string circname = basename + ".png";
+	std::string funcname = basename + "_function.png";
+
+	SDL_Surface * circuit = IMG_Load(circname.c_str());
+	SDL_Surface * function = IMG_Load(funcname.c_str());
+
+	bool ok = (NULL != circuit && NULL != function);
+	if (!ok) {
+		printErrorLog("Unable to load track %s: %s", basename.c_str(), SDL_GetError());
+	} else {
+		ok =
+			map.create(function->w, function->h) &&
+			copySurfaceToLayer(function, map, TileMap::LAYER_FUNCTION) &&
+			copySurfaceToLayer(circuit, map, TileMap::LAYER_DISPLAY);
+	}
+
+	if (NULL != circuit) {
+		SDL_FreeSurface(circuit);
+	}
+	if (NULL != function) {
+		SDL_FreeSurface(function);
+	}
+	if (!ok) {
+		map.close();
+		return false;
+	}
+
+	map.highlightHeightBorders();
+	map.computeDistanceField();
+	map.computeCheckpoints();
+	if (!map.computeProgressField()) {
+		printWarningLog("Track %s has no start line, so no progress along it", basename.c_str());
+	}
+	return true;
+}
+
+// NOTE: mMutex must be held by the caller
+TrackData * TrackCache::load(int id) {
+	if (id < 0 || id >= mxCatalog.size()) {
+		printErrorLog("Unknown track %d", id);
+		return NULL;
+	}
+	const Track & info = mxCatalog.get(id);
+	std::string basename = "tracks/" + info.filename;
+
+	TrackData * track = new TrackData(id);
+
+	if (track->map.open((basename + ".tiles").c_str(), miMaxStreamedBytes)) {
+		track->miBytes = miMaxStreamedBytes;
+	} else if (loadImages(basename, track->map)) {
+		track->miBytes = track->map.getResidentBytes();
+	} else {
+		delete track;
+		return NULL;
+	}
+	return track;
+}
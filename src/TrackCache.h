@@ -0,0 +1,88 @@
+#ifndef TRACKCACHE_H_475C9C0B_8656_11E4_A342_10FEED04CD1C
+#define TRACKCACHE_H_475C9C0B_8656_11E4_A342_10FEED04CD1C
+
+#include "TrackCatalog.h"
+#include "TileMap.h"
+#include "Threads.h"
+
+#include <stddef.h>
+#include <string>
+#include <list>
+#include <map>
+
+// A track after loading and preprocessing. It is owned by the TrackCache, and
+// stays alive for as long as somebody holds a reference to it.
+class TrackData {
+public:
+	int getId() const {
+		return miId;
+	}
+	size_t getBytes() const {
+		return miBytes;
+	}
+
+	TileMap map; // function map and display image, with the function map borders drawn on it
+
+private:
+	friend class TrackCache;
+
+	TrackData(int id);
+	~TrackData();
+
+	int miId;
+	int miRefCount;
+	size_t miBytes;
+
+	TrackData(const TrackData &);
+	TrackData & operator=(const TrackData &);
+};
+
+// Memory-bounded LRU cache of preprocessed tracks. Tracks that are in use are
+// never evicted, so the budget can be exceeded temporarily while they are held.
+//
+// A track is streamed from tracks/<filename>.tiles when that file exists (see
+// TileMap), using at most max_streamed_bytes for its tiles. Otherwise the whole
+// track is built in memory from tracks/<filename>.png and tracks/<filename>_function.png
+class TrackCache {
+public:
+	TrackCache(const TrackCatalog & catalog, size_t max_bytes, size_t max_streamed_bytes);
+	~TrackCache();
+
+	// build a resident map from the track images; also used by the track tiler
+	static bool loadImages(const std::string & basename, TileMap & map);
+
+	TrackData * acquire(int id); // returns NULL if the track can't be loaded
+	void release(TrackData * track);
+
+	void trim(); // evict unused tracks until we are within budget
+	void clear(); // evict every unused track
+
+	size_t getUsedBytes() const {
+		return miUsedBytes;
+	}
+	size_t getMaxBytes() const {
+		return miMaxBytes;
+	}
+
+private:
+	typedef std::list<TrackData *> LruList; // most recently used first
+	typedef std::map<int, LruList::iterator> LruIndex;
+
+	const TrackCatalog & mxCatalog;
+
+	LruList mLru;
+	LruIndex mIndex;
+	size_t miUsedBytes;
+	size_t miMaxBytes;
+	size_t miMaxStreamedBytes;
+
+	Mutex mMutex;
+
+	TrackData * load(int id);
+	void evict(size_t limit);
+
+	TrackCache(const TrackCache &);
+	TrackCache & operator=(const TrackCache &);
+};
+
+#endif // TRACKCACHE_H_475C9C0B_8656_11E4_A342_10FEED04CD1C
@@ -0,0 +1,98 @@
+#include "TrackCatalog.h"
+#include "Common.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+TrackCatalog::TrackCatalog() {
+}
+
+TrackCatalog::~TrackCatalog() {
+}
+
+void TrackCatalog::clear() {
+	mTracks.clear();
+}
+
+static std::string trim(const char * begin, const char * end) {
+	while (begin < end && isspace(*begin)) {
+		++begin;
+	}
+	while (end > begin && isspace(*(end - 1))) {
+		--end;
+	}
+	return std::string(begin, end);
+}
+
+bool TrackCatalog::parseLine(const char * line, Track & track) {
+	std::string fields[6];
+	int n = 0;
+	const char * begin = line;
+	for (const char * p = line; n < 6; ++p) {
+		if ('|' == *p || '\0' == *p || '\n' == *p || '\r' == *p) {
+			fields[n++] = trim(begin, p);
+			if ('|' != *p) {
+				break;
+			}
+			begin = p + 1;
+		}
+	}
+	if (n < 4 || fields[0].empty()) {
+		return false;
+	}
+
+	char * end;
+	track.filename = fields[0];
+	track.start_x = strtol(fields[1].c_str(), &end, 10);
+	if (*end != '\0' || fields[1].empty()) return false;
+	track.start_y = strtol(fields[2].c_str(), &end, 10);
+	if (*end != '\0' || fields[2].empty()) return false;
+	track.start_a = strtol(fields[3].c_str(), &end, 10);
+	if (*end != '\0' || fields[3].empty()) return false;
+	track.name   = (n > 4 ? fields[4] : track.filename);
+	track.author = (n > 5 ? fields[5] : std::string());
+	return true;
+}
+
+bool TrackCatalog::load(const char * manifest) {
+	FILE * f = fopen(manifest, "r");
+	if (NULL == f) {
+		printErrorLog("Unable to open track manifest %s", manifest);
+		return false;
+	}
+
+	std::vector<Track> tracks;
+	char line[512];
+	int line_number = 0;
+	while (NULL != fgets(line, sizeof(line), f)) {
+		++line_number;
+		const char * p = line;
+		while (isspace(*p)) {
+			++p;
+		}
+		if ('\0' == *p || '#' == *p) { // empty line or comment
+			continue;
+		}
+		Track track;
+		if (parseLine(p, track)) {
+			tracks.push_back(track);
+		} else {
+			printWarningLog("%s:%d: invalid track entry", manifest, line_number);
+		}
+	}
+	fclose(f);
+
+	mTracks.swap(tracks);
+	return !mTracks.empty();
+}
+
+int TrackCatalog::find(const char * filename) const {
+	for (size_t i = 0; i < mTracks.size(); ++i) {
+		if (mTracks[i].filename == filename) {
+			return i;
+		}
+	}
+	return -1;
+}
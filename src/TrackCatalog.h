@@ -0,0 +1,44 @@
+#ifndef TRACKCATALOG_H_811042E7_5F56_11E4_2A50_10FEED04CD1C
+#define TRACKCATALOG_H_811042E7_5F56_11E4_2A50_10FEED04CD1C
+
+#include <string>
+#include <vector>
+
+struct Track {
+	std::string filename;
+	int start_x;
+	int start_y;
+	int start_a;
+	std::string name;
+	std::string author;
+};
+
+// List of the available tracks, read from a manifest file. Each non-empty line
+// that doesn't start with '#' describes one track, with the fields separated by '|':
+//
+//   filename | start_x | start_y | start_angle | name | author
+//
+// The images are expected at tracks/<filename>.png and tracks/<filename>_function.png
+class TrackCatalog {
+public:
+	TrackCatalog();
+	~TrackCatalog();
+
+	bool load(const char * manifest);
+	void clear();
+
+	int size() const {
+		return mTracks.size();
+	}
+	const Track & get(int id) const {
+		return mTracks[id];
+	}
+	int find(const char * filename) const;
+
+private:
+	std::vector<Track> mTracks;
+
+	static bool parseLine(const char * line, Track & track);
+};
+
+#endif // TRACKCATALOG_H_811042E7_5F56_11E4_2A50_10FEED04CD1C
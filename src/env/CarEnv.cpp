@@ -0,0 +1,177 @@
+#include "CarEnv.h"
+#include "../Simulation.h"
+#include "../Observation.h"
+#include "../TrackCatalog.h"
+#include "../TrackCache.h"
+#include "../Common.h"
+
+#include <vector>
+
+static const size_t TRACK_CACHE_BYTES = 64 * 1024 * 1024;
+static const size_t STREAMED_TRACK_BYTES = 32 * 1024 * 1024;
+
+struct CarEnv {
+	TrackCatalog catalog;
+	TrackCache cache;
+	TrackData * track;
+	Simulation simulation;
+	ThreadPool * pool;
+
+	int envs;
+	int ticks_per_step;
+	int max_steps;
+	int laps;
+
+	std::vector<int> steps;             // since the last reset
+	std::vector<float> distance;        // race distance at the end of the last step, in pixels
+	std::vector<unsigned char> done;
+	std::vector<Car> frozen;            // cars that are done, as they were before the step
+
+	CarEnv() :
+		cache(catalog, TRACK_CACHE_BYTES, STREAMED_TRACK_BYTES),
+		track(NULL),
+		pool(&ThreadPool::getDefault()),
+		envs(0),
+		ticks_per_step(1),
+		max_steps(0),
+		laps(1)
+	{
+	}
+
+	~CarEnv() {
+		if (NULL != track) {
+			cache.release(track);
+		}
+	}
+};
+
+static void writeObservations(CarEnv * env, float * observations) {
+	Simulation & simulation = env->simulation;
+	const float * lidar = simulation.scanLidar(env->pool);
+	int rays = simulation.getLidarRays();
+	for (int i = 0; i < env->envs; ++i) {
+		observeCar(simulation, i, (NULL == lidar ? NULL : lidar + (size_t)i * rays),
+			observations + (size_t)i * CAR_ENV_OBSERVATION_SIZE);
+	}
+}
+
+CarEnv * car_env_create(const char * manifest, int track, int envs, int ticks_per_step) {
+	if (envs <= 0 || ticks_per_step <= 0) {
+		return NULL;
+	}
+	CarEnv * env = new CarEnv;
+	if (!env->catalog.load(manifest) || track < 0 || track >= env->catalog.size()) {
+		printErrorLog("Track %d not found in %s", track, manifest);
+		delete env;
+		return NULL;
+	}
+	env->track = env->cache.acquire(track);
+	if (NULL == env->track) {
+		delete env;
+		return NULL;
+	}
+
+	env->envs = envs;
+	env->ticks_per_step = ticks_per_step;
+	env->steps.assign(envs, 0);
+	env->distance.assign(envs, 0);
+	env->done.assign(envs, 0);
+	env->frozen.resize(envs);
+
+	const Track & start = env->catalog.get(track);
+	Simulation & simulation = env->simulation;
+	simulation.setIndependentCars(true);
+	simulation.setMap(&env->track->map);
+	simulation.placeCars(envs, start.start_x, start.start_y, start.start_a);
+	if (CAR_ENV_LIDAR_RAYS != simulation.getLidarRays()) {
+		printErrorLog("The lidar has %d rays instead of %d", simulation.getLidarRays(), CAR_ENV_LIDAR_RAYS);
+		delete env;
+		return NULL;
+	}
+	return env;
+}
+
+void car_env_destroy(CarEnv * env) {
+	delete env;
+}
+
+int car_env_get_size(const CarEnv * env) {
+	return env->envs;
+}
+
+void car_env_set_episode(CarEnv * env, int max_steps, int laps) {
+	env->max_steps = (max_steps > 0 ? max_steps : 0);
+	env->laps = (laps > 0 ? laps : 1);
+}
+
+void car_env_reset(CarEnv * env, const unsigned char * mask, float * observations) {
+	Simulation & simulation = env->simulation;
+	for (int i = 0; i < env->envs; ++i) {
+		if (NULL != mask && 0 == mask[i]) {
+			continue;
+		}
+		simulation.resetCar(i);
+		env->steps[i] = 0;
+		env->distance[i] = simulation.getRaceDistance(simulation.getCar(i));
+		env->done[i] = 0;
+	}
+	writeObservations(env, observations);
+}
+
+void car_env_step(CarEnv * env, const float * actions, float * observations, float * rewards, unsigned char * dones) {
+	Simulation & simulation = env->simulation;
+	for (int i = 0; i < env->envs; ++i) {
+		CarInput & input = simulation.getInput(i);
+		if (env->done[i]) {
+			env->frozen[i] = simulation.getCar(i);
+			input.up_down = 0;
+			input.left_right = 0;
+		} else {
+			input.up_down = actions[i * CAR_ENV_ACTION_SIZE + CAR_ENV_ACTION_UP_DOWN];
+			input.left_right = actions[i * CAR_ENV_ACTION_SIZE + CAR_ENV_ACTION_LEFT_RIGHT];
+		}
+	}
+
+	for (int t = 0; t < env->ticks_per_step; ++t) {
+		simulation.tick(env->pool);
+	}
+
+	for (int i = 0; i < env->envs; ++i) {
+		Car & car = simulation.getCar(i);
+		if (env->done[i]) {
+			car = env->frozen[i];
+			rewards[i] = 0;
+			dones[i] = 1;
+			continue;
+		}
+		car.lapflag = 0;
+		++env->steps[i];
+
+		float distance = simulation.getRaceDistance(car);
+		rewards[i] = (distance - env->distance[i]) * Simulation::XY_UNIT_TO_M;
+		env->distance[i] = distance;
+		env->done[i] = (car.lap >= env->laps || (env->max_steps > 0 && env->steps[i] >= env->max_steps));
+		dones[i] = env->done[i];
+	}
+	writeObservations(env, observations);
+}
+
+int car_env_set_crop(CarEnv * env, int size, float scale) {
+	env->simulation.setCrop(size, scale / Simulation::XY_UNIT_TO_M);
+	return env->simulation.getCrop().getSize();
+}
+
+int car_env_get_crops(CarEnv * env, float * crops) {
+	if (!env->simulation.cropMap(crops, env->pool)) {
+		return 0;
+	}
+	const MapCrop & crop = env->simulation.getCrop();
+	size_t plane_size = (size_t)crop.getSize() * crop.getSize();
+	for (int i = 0; i < env->envs; ++i) {
+		float * distance = crops + i * crop.getValues() + MapCrop::PLANE_DISTANCE * plane_size;
+		for (size_t k = 0; k < plane_size; ++k) {
+			distance[k] *= Simulation::XY_UNIT_TO_M;
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,85 @@
+#ifndef CARENV_H_1EE2C6C6_72DD_11E4_553E_10FEED04CD1C
+#define CARENV_H_1EE2C6C6_72DD_11E4_553E_10FEED04CD1C
+
+/*
+ * Many independent cars on one track, stepped together, for reinforcement learning.
+ *
+ * Every call works on all the environments at once, with arrays owned by the caller
+ * that hold the values of one environment after another. Nothing is allocated after
+ * car_env_create(), and the cars are moved by all the processors.
+ *
+ * The cars don't see each other: each one races alone from the start line.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAR_ENV_LIDAR_RAYS 32
+#define CAR_ENV_CROP_PLANES 4
+
+typedef struct CarEnv CarEnv;
+
+/* the action of every environment, with the meaning of the joystick axes (-1 to 1) */
+enum {
+	CAR_ENV_ACTION_UP_DOWN,    /* < 0 accelerates, > 0 brakes */
+	CAR_ENV_ACTION_LEFT_RIGHT, /* < 0 turns left, > 0 right */
+	CAR_ENV_ACTION_SIZE
+};
+
+/* the observation of every environment, in metres, seconds and radians */
+enum {
+	CAR_ENV_OBS_POSITION_X,
+	CAR_ENV_OBS_POSITION_Y,
+	CAR_ENV_OBS_POSITION_Z,
+	CAR_ENV_OBS_SPEED_X,
+	CAR_ENV_OBS_SPEED_Y,
+	CAR_ENV_OBS_SPEED_Z,
+	CAR_ENV_OBS_YAW,
+	CAR_ENV_OBS_PITCH,
+	CAR_ENV_OBS_ROLL,
+	CAR_ENV_OBS_INERTIA,      /* along the heading, in metres per tick; < 0 in reverse */
+	CAR_ENV_OBS_CHECKPOINT,   /* last checkpoint validated */
+	CAR_ENV_OBS_LAP,          /* laps completed */
+	CAR_ENV_OBS_PROGRESS,     /* distance along the current lap */
+	CAR_ENV_OBS_LIDAR,        /* CAR_ENV_LIDAR_RAYS distances to the walls, clockwise from right
+	                             behind the car, or -1 if the track is streamed */
+	CAR_ENV_OBSERVATION_SIZE = CAR_ENV_OBS_LIDAR + CAR_ENV_LIDAR_RAYS
+};
+
+/* envs cars on the track at the given index of the manifest (usually tracks/tracks.cfg);
+   every step lasts ticks_per_step ticks of 8 ms. Returns NULL if the track can't be loaded. */
+CarEnv * car_env_create(const char * manifest, int track, int envs, int ticks_per_step);
+void car_env_destroy(CarEnv * env);
+
+int car_env_get_size(const CarEnv * env);
+
+/* an episode ends after max_steps steps (0 for no limit) or after the given number of laps */
+void car_env_set_episode(CarEnv * env, int max_steps, int laps);
+
+/* put the environments whose mask isn't 0 (all of them if mask is NULL) back on the start
+   line, and write the observations of every environment */
+void car_env_reset(CarEnv * env, const unsigned char * mask, float * observations);
+
+/* apply the actions (CAR_ENV_ACTION_SIZE values per environment) during one step, and write
+   the observations (CAR_ENV_OBSERVATION_SIZE values), the rewards and whether the episodes
+   are done (one value each). The reward is the distance gained along the track, in metres.
+   Environments that are done stay as they are until they are reset. */
+void car_env_step(CarEnv * env, const float * actions, float * observations, float * rewards, unsigned char * dones);
+
+/* the crops of the function map around the cars are size x size cells, scale metres apart
+   (64 cells 0.02 metres apart by default); the size is rounded up to a multiple of 4.
+   Returns the size. */
+int car_env_set_crop(CarEnv * env, int size, float scale);
+
+/* write the crop of every environment as crops[env][plane][row][column], turned so that the
+   car heads to row 0 and has column 0 on its left. The planes are the checkpoint number,
+   the grip (0 to 1), the height (0 to 1) and the distance to the walls in metres.
+   Returns 0 if the track is streamed, and there are no crops. */
+int car_env_get_crops(CarEnv * env, float * crops);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CARENV_H_1EE2C6C6_72DD_11E4_553E_10FEED04CD1C
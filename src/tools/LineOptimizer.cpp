@@ -0,0 +1,326 @@
+#include "../Common.h"
+#include "../TrackCatalog.h"
+#include "../TrackCache.h"
+#include "../Simulation.h"
+#include "../PursuitDriver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Search for a faster racing line of a track with a genetic algorithm, and write it
+// to tracks/<name>.line for the pure pursuit drivers of the game, with the lap of the
+// best line in tracks/<name>.ghost.
+//
+// A line is the default waypoints of the track (see PursuitDriver::findWaypoints())
+// moved sideways. Every candidate of a generation is one car of the same simulation,
+// driven along its own line, so they are all moved at once by the threads of the
+// pool, from a snapshot of the start. A candidate stops as soon as it falls too far
+// behind where the best line so far was at the same time.
+
+#define TRACK_MANIFEST "tracks/tracks.cfg"
+
+static const int DEFAULT_GENERATIONS = 50;
+static const int DEFAULT_POPULATION = 64;
+static const int MAX_TICKS = 10000;      // 80 seconds for a lap
+static const float BEHIND = 100;         // pixels behind the best line, to give up
+static const float MAX_OFFSET = 40;      // pixels to the side of the default waypoints
+static const float MUTATION = 6;         // pixels, standard deviation
+static const float MUTATION_RATE = 0.2;  // share of the waypoints moved by a mutation
+static const int ELITE = 4;              // best candidates kept as they are
+static const int TOURNAMENT = 3;
+
+typedef std::vector<float> Genome; // offset of every waypoint, in pixels to its right
+
+struct Candidate {
+	Genome genome;
+	float fitness;   // ticks for the lap, or more than MAX_TICKS if it didn't finish
+	bool finished;
+};
+
+static bool betterCandidate(const Candidate & a, const Candidate & b) {
+	return a.fitness < b.fitness;
+}
+
+// xorshift, so that the same seed always finds the same line
+static uint32_t random_state = 2463534242u;
+
+static float randomUniform() {
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return (random_state >> 8) / 16777216.0;
+}
+
+static float randomGaussian() {
+	float u = std::max(randomUniform(), 1e-7f);
+	return sqrt(-2 * log(u)) * cos(2 * M_PI * randomUniform());
+}
+
+class LineOptimizer {
+public:
+	LineOptimizer(TileMap & map, const Track & track, int population);
+
+	void run(int generations);
+	bool save(const std::string & basename);
+
+private:
+	TileMap & mxMap;
+	Simulation mSimulation;
+	Simulation::Snapshot mStart;
+	std::vector<PursuitDriver> mDrivers; // one per candidate
+
+	std::vector<float> mBaseX; // default waypoints
+	std::vector<float> mBaseY;
+	std::vector<float> mNormalX; // to the right of the line at every waypoint
+	std::vector<float> mNormalY;
+
+	std::vector<Candidate> mPopulation;
+	Candidate mBest;
+	std::vector<float> mBestTrace; // race distance of the best candidate at every tick
+	std::vector<float> mTraces;    // same for every candidate of the generation, MAX_TICKS each
+
+	void waypoints(const Genome & genome, std::vector<float> & x, std::vector<float> & y) const;
+	void evaluate();
+	const Candidate & select() const;
+	void breed();
+};
+
+LineOptimizer::LineOptimizer(TileMap & map, const Track & track, int population) :
+	mxMap(map)
+{
+	mSimulation.setIndependentCars(true);
+	mSimulation.setMap(&map);
+	mSimulation.placeCars(population, track.start_x, track.start_y, track.start_a);
+	mSimulation.save(mStart);
+	mDrivers.resize(population);
+
+	PursuitDriver::findWaypoints(map, mBaseX, mBaseY);
+	int count = mBaseX.size();
+	mNormalX.resize(count);
+	mNormalY.resize(count);
+	for (int k = 0; k < count; ++k) {
+		int previous = (k + count - 1) % count;
+		int next = (k + 1) % count;
+		float dx = mBaseX[next] - mBaseX[previous];
+		float dy = mBaseY[next] - mBaseY[previous];
+		float length = sqrt(dx * dx + dy * dy);
+		if (length > 0) { // the right of (dx, dy) with y going down
+			mNormalX[k] = -dy / length;
+			mNormalY[k] = dx / length;
+		} else {
+			mNormalX[k] = mNormalY[k] = 0;
+		}
+	}
+
+	// the default line and random ones around it
+	mPopulation.resize(population);
+	for (int i = 0; i < population; ++i) {
+		Genome & genome = mPopulation[i].genome;
+		genome.assign(count, 0);
+		for (int k = 0; i > 0 && k < count; ++k) {
+			genome[k] = std::min(std::max(randomGaussian() * MUTATION, -MAX_OFFSET), MAX_OFFSET);
+		}
+	}
+	mBest.fitness = 2 * MAX_TICKS;
+	mBest.finished = false;
+	mTraces.resize((size_t)population * MAX_TICKS);
+}
+
+void LineOptimizer::waypoints(const Genome & genome, std::vector<float> & x, std::vector<float> & y) const {
+	x.resize(genome.size());
+	y.resize(genome.size());
+	for (size_t k = 0; k < genome.size(); ++k) {
+		x[k] = mBaseX[k] + mNormalX[k] * genome[k];
+		y[k] = mBaseY[k] + mNormalY[k] * genome[k];
+	}
+}
+
+void LineOptimizer::evaluate() {
+	int population = mPopulation.size();
+	std::vector<float> x;
+	std::vector<float> y;
+	for (int i = 0; i < population; ++i) {
+		waypoints(mPopulation[i].genome, x, y);
+		mDrivers[i].setWaypoints(x, y);
+		mPopulation[i].finished = false;
+		mPopulation[i].fitness = 0;
+	}
+	mSimulation.restore(mStart);
+
+	std::vector<bool> active(population, true);
+	int remaining = population;
+	float lap_length = mxMap.getLapLength();
+	for (int t = 0; t < MAX_TICKS && remaining > 0; ++t) {
+		for (int i = 0; i < population; ++i) {
+			if (active[i]) {
+				mDrivers[i].drive(mSimulation, &i, 1);
+			}
+		}
+		mSimulation.tick(&ThreadPool::getDefault());
+
+		for (int i = 0; i < population; ++i) {
+			if (!active[i]) {
+				continue;
+			}
+			const Car & car = mSimulation.getCar(i);
+			float distance = mSimulation.getRaceDistance(car);
+			mTraces[(size_t)i * MAX_TICKS + t] = distance;
+			Candidate & candidate = mPopulation[i];
+			if (car.lap >= 1) {
+				candidate.finished = true;
+				candidate.fitness = t + 1;
+			} else if (t + 1 == MAX_TICKS || (t < (int)mBestTrace.size() && distance < mBestTrace[t] - BEHIND)) {
+				candidate.fitness = MAX_TICKS + (lap_length - distance);
+			} else {
+				continue;
+			}
+			// a stopped candidate doesn't move any more
+			active[i] = false;
+			--remaining;
+			CarInput no_input = { 0, 0 };
+			mSimulation.getInput(i) = no_input;
+		}
+	}
+
+	for (int i = 0; i < population; ++i) {
+		const Candidate & candidate = mPopulation[i];
+		if (candidate.finished && candidate.fitness < mBest.fitness) {
+			mBest = candidate;
+			const float * trace = &mTraces[(size_t)i * MAX_TICKS];
+			mBestTrace.assign(trace, trace + (int)candidate.fitness);
+		}
+	}
+}
+
+const Candidate & LineOptimizer::select() const {
+	const Candidate * best = &mPopulation[(int)(randomUniform() * mPopulation.size())];
+	for (int n = 1; n < TOURNAMENT; ++n) {
+		const Candidate * other = &mPopulation[(int)(randomUniform() * mPopulation.size())];
+		if (other->fitness < best->fitness) {
+			best = other;
+		}
+	}
+	return *best;
+}
+
+void LineOptimizer::breed() {
+	std::sort(mPopulation.begin(), mPopulation.end(), betterCandidate);
+	std::vector<Candidate> next(mPopulation.begin(), mPopulation.begin() + std::min(ELITE, (int)mPopulation.size()));
+	while (next.size() < mPopulation.size()) {
+		const Candidate & a = select();
+		const Candidate & b = select();
+		Candidate child;
+		child.genome.resize(a.genome.size());
+		for (size_t k = 0; k < child.genome.size(); ++k) {
+			float offset = (randomUniform() < 0.5 ? a.genome[k] : b.genome[k]);
+			if (randomUniform() < MUTATION_RATE) {
+				offset += randomGaussian() * MUTATION;
+			}
+			child.genome[k] = std::min(std::max(offset, -MAX_OFFSET), MAX_OFFSET);
+		}
+		next.push_back(child);
+	}
+	mPopulation.swap(next);
+}
+
+void LineOptimizer::run(int generations) {
+	for (int g = 0; g < generations; ++g) {
+		evaluate();
+		int finished = 0;
+		for (size_t i = 0; i < mPopulation.size(); ++i) {
+			finished += mPopulation[i].finished;
+		}
+		if (mBest.finished) {
+			printInfoLog("Generation %d: %d of %d finished, best lap %.2f s", g, finished,
+				(int)mPopulation.size(), mBest.fitness * Simulation::TICK_MS / 1000.0);
+		} else {
+			printInfoLog("Generation %d: no lap yet", g);
+		}
+		breed();
+	}
+}
+
+bool LineOptimizer::save(const std::string & basename) {
+	if (!mBest.finished) {
+		printErrorLog("No line finished a lap");
+		return false;
+	}
+	std::vector<float> x;
+	std::vector<float> y;
+	waypoints(mBest.genome, x, y);
+	std::string line = basename + ".line";
+	if (!PursuitDriver::saveWaypoints(line.c_str(), x, y)) {
+		printErrorLog("Can't write %s", line.c_str());
+		return false;
+	}
+
+	// drive the best line once more, to record it
+	std::string ghost = basename + ".ghost";
+	FILE * f = fopen(ghost.c_str(), "w");
+	if (NULL == f) {
+		printErrorLog("Can't write %s", ghost.c_str());
+		return false;
+	}
+	fprintf(f, "# one line every %d ms: x y (pixels) yaw (radians) up_down left_right\n", Simulation::TICK_MS);
+	mSimulation.restore(mStart);
+	PursuitDriver & driver = mDrivers[0];
+	driver.setWaypoints(x, y);
+	int car = 0;
+	for (int t = 0; t < MAX_TICKS && mSimulation.getCar(car).lap < 1; ++t) {
+		driver.drive(mSimulation, &car, 1);
+		const CarInput & input = mSimulation.getInput(car);
+		mSimulation.tick();
+		const Car & state = mSimulation.getCar(car);
+		fprintf(f, "%.2f %.2f %.4f %.3f %.3f\n", state.getPosX(), state.getPosY(), state.getYaw(),
+			input.up_down, input.left_right);
+	}
+	fclose(f);
+	printInfoLog("%s: %d waypoints, %s: lap of %.2f s", line.c_str(), (int)x.size(), ghost.c_str(),
+		mBest.fitness * Simulation::TICK_MS / 1000.0);
+	return true;
+}
+
+static void usage(const char * program) {
+	fprintf(stderr, "Usage: %s <track filename> [generations] [population] [seed]\n", program);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		usage(argv[0]);
+		return 1;
+	}
+	int generations = (argc > 2 ? atoi(argv[2]) : DEFAULT_GENERATIONS);
+	int population = (argc > 3 ? atoi(argv[3]) : DEFAULT_POPULATION);
+	if (argc > 4) {
+		random_state = std::max(1, atoi(argv[4]));
+	}
+	if (generations <= 0 || population <= ELITE) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	TrackCatalog catalog;
+	if (!catalog.load(TRACK_MANIFEST)) {
+		return 1;
+	}
+	int id = catalog.find(argv[1]);
+	if (id < 0) {
+		printErrorLog("Track %s not found in %s", argv[1], TRACK_MANIFEST);
+		return 1;
+	}
+	const Track & track = catalog.get(id);
+	std::string basename = "tracks/" + track.filename;
+
+	TileMap map;
+	if (!TrackCache::loadImages(basename, map)) {
+		return 1;
+	}
+
+	LineOptimizer optimizer(map, track, population);
+	optimizer.run(generations);
+	return (optimizer.save(basename) ? 0 : 1);
+}
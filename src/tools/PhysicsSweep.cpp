@@ -0,0 +1,506 @@
+#include "../Common.h"
+#include "../TrackCatalog.h"
+#include "../TrackCache.h"
+#include "../Simulation.h"
+#include "../PursuitDriver.h"
+#include "../Threads.h"
+#include "SweepProtocol.h"
+#include "ResultCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Race the pure pursuit drivers on many tracks with other constants of the physics,
+// and write the statistics of their lap times to one results file.
+//
+// The design is either the grid of every combination of the values of the parameters
+// (name=min:max:steps) or random points between their bounds (-r). Every point is
+// raced on every track with every seed, the seed moving the cars a little on the
+// grid; the races are spread over the threads of the pool, and every race keeps its
+// lap times on its own, so that they are only merged at the end.
+//
+// For longer campaigns, -w spreads the races over worker processes instead, in
+// shards given by a coordinator on a UNIX socket (see SweepProtocol.h), and the shard
+// of a worker that crashes is raced again by another one. More workers can join from
+// elsewhere with -W and the same arguments; the coordinator refuses those whose design
+// (getDesign()) is not the same, as their jobs would be other races.
+//
+// Races are deterministic, so the lap times of every race are kept in a cache file
+// (see ResultCache.h) by the hash of everything they depend on: the function map,
+// the waypoints of the drivers, the physics, the seed, the cars, the laps and the
+// tick. A sweep only runs the races that are not in it yet.
+
+#define TRACK_MANIFEST "tracks/tracks.cfg"
+
+static const int DEFAULT_CARS = 8;
+static const int DEFAULT_LAPS = 3;
+static const int LAP_TICKS = 60000 / Simulation::TICK_MS; // time limit of every lap
+static const float GRID_JITTER = 2;         // pixels
+static const float GRID_JITTER_YAW = 0.02;  // radians
+static const int SHARD_JOBS = 4;            // races given to a worker at a time
+static const int CACHE_VERSION = 1;         // of the physics and the drivers, for the result cache
+
+struct Parameter {
+	const char * name;
+	float Simulation::PhysicsParams::* field;
+	float min;
+	float max;
+	int steps;
+};
+
+static Parameter parameters[] = {
+	{ "inertia_decay", &Simulation::PhysicsParams::inertia_decay, 0, 0, 0 },
+	{ "grip_divisor",  &Simulation::PhysicsParams::grip_divisor,  0, 0, 0 },
+	{ "steering",      &Simulation::PhysicsParams::steering,      0, 0, 0 },
+};
+static const int NB_PARAMETERS = sizeof(parameters) / sizeof(parameters[0]);
+
+struct SweepTrack {
+	const Track * track;
+	TileMap map;
+	std::vector<float> waypoint_x;
+	std::vector<float> waypoint_y;
+	uint64_t hash; // of the function map and the waypoints, for the result cache
+};
+
+class Sweep : public ParallelTask, public SweepJobRunner, public SweepResultSink {
+public:
+	Sweep(const std::vector<Simulation::PhysicsParams> & points, std::vector<SweepTrack *> & tracks,
+		int seeds, int cars, int laps);
+
+	// take the races already in cache, and add the new ones to it
+	void useCache(ResultCache * cache);
+
+	virtual void run(int begin, int end); // of getPendingJobs()
+	virtual void runJob(int job, LapStats & result);
+	virtual void addResult(int job, const LapStats & result);
+
+	int getJobs() const {
+		return mxPoints.size() * mxTracks.size() * miSeeds;
+	}
+	const std::vector<int> & getPendingJobs() const {
+		return mPending;
+	}
+	const LapStats & getStats(int point, int track) const {
+		return mStats[point * mxTracks.size() + track];
+	}
+	void merge(); // the races done into getStats()
+
+	// hash of every job and what its lap times depend on, for the workers of a sweep
+	uint64_t getDesign() const;
+
+private:
+	const std::vector<Simulation::PhysicsParams> & mxPoints;
+	std::vector<SweepTrack *> & mxTracks;
+	int miSeeds;
+	int miCars;
+	int miLaps;
+	std::vector<LapStats> mResults; // of every job, so that the threads never share one
+	std::vector<char> mDone;
+	std::vector<int> mPending;
+	std::vector<LapStats> mStats;
+	ResultCache * mpCache;
+	Mutex mCacheMutex;
+
+	uint64_t getKey(int job) const;
+	void race(int point, int track, int seed, LapStats & result);
+};
+
+Sweep::Sweep(const std::vector<Simulation::PhysicsParams> & points, std::vector<SweepTrack *> & tracks,
+	int seeds, int cars, int laps) :
+	mxPoints(points),
+	mxTracks(tracks),
+	miSeeds(seeds),
+	miCars(cars),
+	miLaps(laps),
+	mpCache(NULL)
+{
+	mResults.resize(getJobs());
+	mDone.assign(getJobs(), 0);
+	for (int job = 0; job < getJobs(); ++job) {
+		mPending.push_back(job);
+	}
+}
+
+// everything the lap times of a job depend on
+uint64_t Sweep::getKey(int job) const {
+	int seed = job % miSeeds;
+	int track = (job / miSeeds) % mxTracks.size();
+	int point = job / miSeeds / mxTracks.size();
+	ResultKey key;
+	key.add(CACHE_VERSION);
+	key.add(mxTracks[track]->hash);
+	for (int p = 0; p < NB_PARAMETERS; ++p) {
+		key.add(mxPoints[point].*parameters[p].field);
+	}
+	key.add(seed);
+	key.add(miCars);
+	key.add(miLaps);
+	key.add(Simulation::TICK_MS);
+	key.add(LAP_TICKS);
+	key.add(GRID_JITTER);
+	key.add(GRID_JITTER_YAW);
+	return key.get();
+}
+
+uint64_t Sweep::getDesign() const {
+	ResultKey key;
+	key.add(getJobs());
+	for (int job = 0; job < getJobs(); ++job) {
+		key.add(getKey(job));
+	}
+	return key.get();
+}
+
+void Sweep::useCache(ResultCache * cache) {
+	mpCache = cache;
+	mPending.clear();
+	for (int job = 0; job < getJobs(); ++job) {
+		if (NULL != cache && cache->find(getKey(job), mResults[job])) {
+			mDone[job] = 1;
+		} else {
+			mPending.push_back(job);
+		}
+	}
+}
+
+void Sweep::run(int begin, int end) {
+	for (int i = begin; i < end; ++i) {
+		int job = mPending[i];
+		LapStats result;
+		runJob(job, result);
+		addResult(job, result);
+	}
+}
+
+void Sweep::addResult(int job, const LapStats & result) {
+	mResults[job] = result;
+	mDone[job] = 1;
+	if (NULL != mpCache) {
+		Mutex::MutexHolder holder(&mCacheMutex);
+		mpCache->add(getKey(job), result);
+	}
+}
+
+void Sweep::runJob(int job, LapStats & result) {
+	int seed = job % miSeeds;
+	int track = (job / miSeeds) % mxTracks.size();
+	int point = job / miSeeds / mxTracks.size();
+	race(point, track, seed, result);
+}
+
+void Sweep::race(int point, int track, int seed, LapStats & result) {
+	SweepTrack & sweep_track = *mxTracks[track];
+	Simulation simulation;
+	simulation.setPhysics(mxPoints[point]);
+	simulation.setMap(&sweep_track.map);
+	simulation.placeCars(miCars, sweep_track.track->start_x, sweep_track.track->start_y, sweep_track.track->start_a);
+
+	// the seed moves every car a little, so that the races don't all go the same way
+	unsigned int random = seed * 2654435761u + 1;
+	for (int i = 0; seed > 0 && i < miCars; ++i) {
+		Car & car = simulation.getCar(i);
+		random = random * 1103515245u + 12345u;
+		float dx = ((random >> 8) % 1001 / 500.0 - 1) * GRID_JITTER;
+		random = random * 1103515245u + 12345u;
+		float dy = ((random >> 8) % 1001 / 500.0 - 1) * GRID_JITTER;
+		random = random * 1103515245u + 12345u;
+		float dyaw = ((random >> 8) % 1001 / 500.0 - 1) * GRID_JITTER_YAW;
+		car.setPosition(car.getPosX() + dx, car.getPosY() + dy, car.getYaw() + dyaw);
+		car.backupPosition();
+	}
+
+	PursuitDriver driver;
+	driver.setWaypoints(sweep_track.waypoint_x, sweep_track.waypoint_y);
+	std::vector<int> cars(miCars);
+	std::vector<int> last_lap(miCars, 0); // tick of the start of the current lap
+	for (int i = 0; i < miCars; ++i) {
+		cars[i] = i;
+	}
+
+	int finished = 0;
+	for (int t = 1; t <= miLaps * LAP_TICKS && finished < miCars; ++t) {
+		driver.drive(simulation, &cars[0], miCars);
+		simulation.tick(); // already in a thread of the pool, or in a worker
+		for (int i = 0; i < miCars; ++i) {
+			Car & car = simulation.getCar(i);
+			if (1 == car.lapflag) {
+				car.lapflag = 0;
+				if (car.lap <= miLaps) {
+					result.add((t - last_lap[i]) * Simulation::TICK_MS / 1000.0);
+					finished += (car.lap == miLaps);
+				}
+				last_lap[i] = t;
+			} else if (2 == car.lapflag) {
+				car.lapflag = 0;
+			}
+		}
+	}
+	result.unfinished += miCars - finished;
+}
+
+void Sweep::merge() {
+	// a job is a seed of a track of a point; point * tracks + track is job / seeds
+	mStats.assign(mxPoints.size() * mxTracks.size(), LapStats());
+	for (int job = 0; job < getJobs(); ++job) {
+		if (mDone[job]) {
+			mStats[job / miSeeds].merge(mResults[job]);
+		}
+	}
+}
+
+static void usage(const char * program) {
+	fprintf(stderr,
+		"Usage: %s [-r points] [-s seeds] [-c cars] [-l laps] [-t track]... [-o results] [-k cache | -n]\n"
+		"       [-w workers [-S socket] | -W socket] [name=min:max[:steps]]...\n"
+		"  -r  random design of that many points, instead of the grid\n"
+		"  -s  seeds for every point and track (1)\n"
+		"  -c  cars in every race (%d)\n"
+		"  -l  laps of every race (%d)\n"
+		"  -t  only race on the given tracks (all of them)\n"
+		"  -o  results file (sweep.txt)\n"
+		"  -k  cache of the races already run (sweep.cache)\n"
+		"  -n  no cache, run every race\n"
+		"  -w  race in that many worker processes, instead of threads\n"
+		"  -S  socket of the workers (/tmp/physicssweep.<pid>)\n"
+		"  -W  only be a worker of the sweep with the same arguments listening at socket\n"
+		"  parameters:",
+		program, DEFAULT_CARS, DEFAULT_LAPS);
+	Simulation::PhysicsParams physics;
+	for (int p = 0; p < NB_PARAMETERS; ++p) {
+		fprintf(stderr, " %s (%g)", parameters[p].name, physics.*parameters[p].field);
+	}
+	fprintf(stderr, "\n");
+}
+
+static bool parseParameter(const char * arg) {
+	const char * equal = strchr(arg, '=');
+	if (NULL == equal) {
+		return false;
+	}
+	for (int p = 0; p < NB_PARAMETERS; ++p) {
+		Parameter & parameter = parameters[p];
+		if (strlen(parameter.name) != (size_t)(equal - arg) || strncmp(arg, parameter.name, equal - arg) != 0) {
+			continue;
+		}
+		parameter.steps = 1;
+		int fields = sscanf(equal + 1, "%f:%f:%d", &parameter.min, &parameter.max, &parameter.steps);
+		if (fields < 1 || parameter.steps < 1) {
+			return false;
+		}
+		if (1 == fields) {
+			parameter.max = parameter.min;
+		} else if (2 == fields) {
+			parameter.steps = 2;
+		}
+		return true;
+	}
+	return false;
+}
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static bool writeResults(const char * output, const std::vector<Simulation::PhysicsParams> & points,
+	const std::vector<SweepTrack *> & tracks, const Sweep & sweep)
+{
+	FILE * f = fopen(output, "w");
+	if (NULL == f) {
+		printErrorLog("Can't write %s", output);
+		return false;
+	}
+	fprintf(f, "# point");
+	for (int p = 0; p < NB_PARAMETERS; ++p) {
+		fprintf(f, " %s", parameters[p].name);
+	}
+	fprintf(f, " track laps mean_s stddev_s min_s max_s unfinished\n");
+	for (size_t point = 0; point < points.size(); ++point) {
+		for (size_t track = 0; track < tracks.size(); ++track) {
+			const LapStats & stats = sweep.getStats(point, track);
+			double mean = (stats.laps > 0 ? stats.sum / stats.laps : 0);
+			double variance = (stats.laps > 1 ? (stats.sum_sq - stats.sum * mean) / (stats.laps - 1) : 0);
+			fprintf(f, "%d", (int)point);
+			for (int p = 0; p < NB_PARAMETERS; ++p) {
+				fprintf(f, " %g", points[point].*parameters[p].field);
+			}
+			fprintf(f, " %s %d %.3f %.3f %.3f %.3f %d\n", tracks[track]->track->filename.c_str(), stats.laps,
+				mean, sqrt(std::max(variance, 0.0)), stats.min, stats.max, stats.unfinished);
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	int random_points = 0;
+	int seeds = 1;
+	int cars = DEFAULT_CARS;
+	int laps = DEFAULT_LAPS;
+	std::vector<std::string> track_names;
+	const char * output = "sweep.txt";
+	int workers = 0;
+	std::string socket_path;
+	const char * coordinator_path = NULL;
+	const char * cache_path = "sweep.cache";
+
+	int option;
+	while ((option = getopt(argc, argv, "r:s:c:l:t:o:k:nw:S:W:h")) != -1) {
+		switch (option) {
+			case 'r': random_points = atoi(optarg); break;
+			case 's': seeds = atoi(optarg); break;
+			case 'c': cars = atoi(optarg); break;
+			case 'l': laps = atoi(optarg); break;
+			case 't': track_names.push_back(optarg); break;
+			case 'o': output = optarg; break;
+			case 'k': cache_path = optarg; break;
+			case 'n': cache_path = NULL; break;
+			case 'w': workers = atoi(optarg); break;
+			case 'S': socket_path = optarg; break;
+			case 'W': coordinator_path = optarg; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	for (int i = optind; i < argc; ++i) {
+		if (!parseParameter(argv[i])) {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (seeds < 1 || cars < 1 || laps < 1 || random_points < 0 || workers < 0 || (workers > 0 && NULL != coordinator_path)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	// the design
+	std::vector<Simulation::PhysicsParams> points;
+	if (random_points > 0) {
+		unsigned int random = 12345;
+		for (int n = 0; n < random_points; ++n) {
+			Simulation::PhysicsParams physics;
+			for (int p = 0; p < NB_PARAMETERS; ++p) {
+				const Parameter & parameter = parameters[p];
+				random = random * 1103515245u + 12345u;
+				if (parameter.steps > 0) {
+					physics.*parameter.field = parameter.min + (parameter.max - parameter.min) * ((random >> 8) % 65536) / 65535.0;
+				}
+			}
+			points.push_back(physics);
+		}
+	} else {
+		points.push_back(Simulation::PhysicsParams());
+		for (int p = 0; p < NB_PARAMETERS; ++p) {
+			const Parameter & parameter = parameters[p];
+			if (0 == parameter.steps) {
+				continue;
+			}
+			std::vector<Simulation::PhysicsParams> grid;
+			for (size_t i = 0; i < points.size(); ++i) {
+				for (int s = 0; s < parameter.steps; ++s) {
+					Simulation::PhysicsParams physics = points[i];
+					physics.*parameter.field = (1 == parameter.steps ? parameter.min :
+						parameter.min + (parameter.max - parameter.min) * s / (parameter.steps - 1));
+					grid.push_back(physics);
+				}
+			}
+			points.swap(grid);
+		}
+	}
+
+	// the tracks, all of them in memory
+	TrackCatalog catalog;
+	if (!catalog.load(TRACK_MANIFEST)) {
+		return 1;
+	}
+	std::vector<SweepTrack *> tracks;
+	for (int id = 0; id < catalog.size(); ++id) {
+		const Track & track = catalog.get(id);
+		if (!track_names.empty() && std::find(track_names.begin(), track_names.end(), track.filename) == track_names.end()) {
+			continue;
+		}
+		SweepTrack * sweep_track = new SweepTrack;
+		sweep_track->track = &track;
+		if (!TrackCache::loadImages("tracks/" + track.filename, sweep_track->map)) {
+			delete sweep_track;
+			continue;
+		}
+		PursuitDriver::findWaypoints(sweep_track->map, sweep_track->waypoint_x, sweep_track->waypoint_y);
+		ResultKey key;
+		key.addFile(("tracks/" + track.filename + "_function.png").c_str());
+		key.add(&sweep_track->waypoint_x[0], sweep_track->waypoint_x.size() * sizeof(float));
+		key.add(&sweep_track->waypoint_y[0], sweep_track->waypoint_y.size() * sizeof(float));
+		sweep_track->hash = key.get();
+		tracks.push_back(sweep_track);
+	}
+	if (tracks.empty()) {
+		printErrorLog("No tracks to race on");
+		return 1;
+	}
+
+	Sweep sweep(points, tracks, seeds, cars, laps);
+	if (NULL != coordinator_path) {
+		int fd = connectSweepCoordinator(coordinator_path);
+		if (fd < 0) {
+			printErrorLog("Can't connect to %s", coordinator_path);
+			return 1;
+		}
+		bool stopped = runSweepWorker(fd, sweep, sweep.getDesign());
+		close(fd);
+		for (size_t track = 0; track < tracks.size(); ++track) {
+			delete tracks[track];
+		}
+		return (stopped ? 0 : 1);
+	}
+
+	ResultCache cache;
+	if (NULL != cache_path && !cache.open(cache_path)) {
+		return 1;
+	}
+	sweep.useCache(NULL != cache_path ? &cache : NULL);
+	const std::vector<int> & pending = sweep.getPendingJobs();
+	printInfoLog("%d points x %d tracks x %d seeds = %d races of %d cars, %d of them in cache",
+		(int)points.size(), (int)tracks.size(), seeds, sweep.getJobs(), cars, sweep.getJobs() - (int)pending.size());
+
+	bool complete = true;
+	double start = now();
+	if (pending.empty()) {
+		// nothing to race
+	} else if (workers > 0) {
+		// the workers are forked with the tracks already loaded; they race without
+		// the pool, whose threads are not in them
+		if (socket_path.empty()) {
+			char path[64];
+			snprintf(path, sizeof(path), "/tmp/physicssweep.%d", (int)getpid());
+			socket_path = path;
+		}
+		printInfoLog("Racing in %d workers at %s", workers, socket_path.c_str());
+		SweepCoordinator coordinator(pending, SHARD_JOBS, sweep.getDesign());
+		complete = coordinator.run(socket_path.c_str(), workers, sweep, sweep);
+		if (!complete) {
+			printWarningLog("Some races failed, their results are missing");
+		}
+	} else {
+		ThreadPool & pool = ThreadPool::getDefault();
+		printInfoLog("Racing on %d threads", pool.getNumberOfThreads());
+		pool.parallelFor(pending.size(), sweep, 1);
+	}
+	sweep.merge();
+	printInfoLog("Done in %.1f s", now() - start);
+	complete = writeResults(output, points, tracks, sweep) && complete;
+
+	for (size_t track = 0; track < tracks.size(); ++track) {
+		delete tracks[track];
+	}
+	return (complete ? 0 : 1);
+}
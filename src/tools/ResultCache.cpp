@@ -0,0 +1,160 @@
+#include "ResultCache.h"
+#include "../Common.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char ResultCache::MAGIC[8] = { 'C', 'A', 'R', 'R', 'E', 'S', '0', '1' };
+
+bool ResultKey::addFile(const char * filename) {
+	FILE * f = fopen(filename, "rb");
+	if (NULL == f) {
+		return false;
+	}
+	uint8_t buffer[65536];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+		add(buffer, n);
+	}
+	bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
+
+ResultCache::ResultCache() :
+	miFd(-1),
+	mpaMapping(NULL),
+	miMappedBytes(0)
+{
+}
+
+ResultCache::~ResultCache() {
+	close();
+}
+
+bool ResultCache::open(const char * filename) {
+	close();
+
+	miFd = ::open(filename, O_RDWR | O_CREAT | O_APPEND, 0644);
+	if (miFd < 0) {
+		printErrorLog("Can't open %s: %s", filename, strerror(errno));
+		return false;
+	}
+	flock(miFd, LOCK_EX); // against another sweep opening it at the same time
+
+	struct stat st;
+	fstat(miFd, &st);
+	size_t size = st.st_size;
+	Header header;
+	if (0 == size) {
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.record_size = sizeof(Record);
+		if (write(miFd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+			printErrorLog("Can't write %s: %s", filename, strerror(errno));
+			flock(miFd, LOCK_UN);
+			close();
+			return false;
+		}
+		size = sizeof(header);
+	} else if (
+		size < sizeof(header) ||
+		pread(miFd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+		memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+		header.record_size != sizeof(Record)
+	) {
+		printErrorLog("Invalid result cache %s", filename);
+		flock(miFd, LOCK_UN);
+		close();
+		return false;
+	}
+
+	// the end of a record that was being written when a sweep died
+	size_t records = (size - sizeof(header)) / sizeof(Record);
+	size_t valid = sizeof(header) + records * sizeof(Record);
+	if (valid != size) {
+		printWarningLog("Dropping a truncated record at the end of %s", filename);
+		if (ftruncate(miFd, valid) != 0) {
+			printWarningLog("Can't truncate %s: %s", filename, strerror(errno));
+		}
+	}
+	flock(miFd, LOCK_UN);
+
+	if (records > 0) {
+		void * mapping = mmap(NULL, valid, PROT_READ, MAP_SHARED, miFd, 0);
+		if (MAP_FAILED == mapping) {
+			printErrorLog("Can't map %s: %s", filename, strerror(errno));
+			close();
+			return false;
+		}
+		mpaMapping = (const uint8_t *)mapping;
+		miMappedBytes = valid;
+		const Record * record = (const Record *)(mpaMapping + sizeof(header));
+		for (size_t r = 0; r < records; ++r) {
+			mIndex[record[r].key] = &record[r];
+		}
+	}
+	printInfoLog("Result cache %s: %d races", filename, (int)records);
+	return true;
+}
+
+void ResultCache::close() {
+	if (NULL != mpaMapping) {
+		munmap((void *)mpaMapping, miMappedBytes);
+		mpaMapping = NULL;
+		miMappedBytes = 0;
+	}
+	if (miFd >= 0) {
+		::close(miFd);
+		miFd = -1;
+	}
+	mIndex.clear();
+	mAdded.clear();
+}
+
+bool ResultCache::find(uint64_t key, LapStats & stats) const {
+	std::map<uint64_t, const Record *>::const_iterator it = mIndex.find(key);
+	if (it != mIndex.end()) {
+		const Record & record = *it->second;
+		stats.laps = record.laps;
+		stats.unfinished = record.unfinished;
+		stats.min = record.min;
+		stats.max = record.max;
+		stats.sum = record.sum;
+		stats.sum_sq = record.sum_sq;
+		return true;
+	}
+	std::map<uint64_t, LapStats>::const_iterator added = mAdded.find(key);
+	if (added != mAdded.end()) {
+		stats = added->second;
+		return true;
+	}
+	return false;
+}
+
+bool ResultCache::add(uint64_t key, const LapStats & stats) {
+	if (miFd < 0) {
+		return false;
+	}
+	Record record;
+	memset(&record, 0, sizeof(record));
+	record.key = key;
+	record.laps = stats.laps;
+	record.unfinished = stats.unfinished;
+	record.min = stats.min;
+	record.max = stats.max;
+	record.sum = stats.sum;
+	record.sum_sq = stats.sum_sq;
+	if (write(miFd, &record, sizeof(record)) != (ssize_t)sizeof(record)) {
+		printErrorLog("Can't add to the result cache: %s", strerror(errno));
+		return false;
+	}
+	mAdded[key] = stats;
+	return true;
+}
@@ -0,0 +1,92 @@
+#ifndef RESULTCACHE_H_1E4860FA_F510_11E4_004C_10FEED04CD1C
+#define RESULTCACHE_H_1E4860FA_F510_11E4_004C_10FEED04CD1C
+
+#include "SweepProtocol.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+
+// 64 bits FNV-1a hash of everything a race depends on
+class ResultKey {
+public:
+	ResultKey() : mHash(14695981039346656037ull) {
+	}
+
+	void add(const void * data, size_t size) {
+		const uint8_t * bytes = (const uint8_t *)data;
+		for (size_t i = 0; i < size; ++i) {
+			mHash = (mHash ^ bytes[i]) * 1099511628211ull;
+		}
+	}
+	void add(int32_t value) {
+		add(&value, sizeof(value));
+	}
+	void add(uint64_t value) {
+		add(&value, sizeof(value));
+	}
+	void add(float value) {
+		add(&value, sizeof(value));
+	}
+	bool addFile(const char * filename); // its content, false if it can't be read
+
+	uint64_t get() const {
+		return mHash;
+	}
+
+private:
+	uint64_t mHash;
+};
+
+// Lap times of races already run, by the hash of their inputs, so that the same race
+// is never run twice. Races are deterministic, so a key always gives the same result.
+//
+// The file is a header followed by fixed size records, that are only ever appended,
+// one write() each, so that a crash can only lose the record being written, which is
+// dropped at the next open. The records already in the file are read from a mapping
+// of it, through an index of their keys.
+class ResultCache {
+public:
+	static const char MAGIC[8];
+
+	ResultCache();
+	~ResultCache();
+
+	bool open(const char * filename); // created if it doesn't exist
+	void close();
+
+	bool find(uint64_t key, LapStats & stats) const;
+	bool add(uint64_t key, const LapStats & stats);
+
+	int size() const {
+		return mIndex.size() + mAdded.size();
+	}
+
+private:
+	struct Record {
+		uint64_t key;
+		uint32_t laps;
+		uint32_t unfinished;
+		float min;
+		float max;
+		double sum;
+		double sum_sq;
+	};
+
+	struct Header {
+		char magic[8];
+		uint32_t record_size;
+		uint32_t reserved;
+	};
+
+	int miFd;
+	const uint8_t * mpaMapping;
+	size_t miMappedBytes;
+	std::map<uint64_t, const Record *> mIndex; // records of the mapping
+	std::map<uint64_t, LapStats> mAdded;       // records appended since the file was opened
+
+	ResultCache(const ResultCache &);
+	ResultCache & operator=(const ResultCache &);
+};
+
+#endif // RESULTCACHE_H_1E4860FA_F510_11E4_004C_10FEED04CD1C
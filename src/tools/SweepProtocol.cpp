@@ -0,0 +1,518 @@
+#include "SweepProtocol.h"
+#include "../Common.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static const int POLL_MS = 1000; // to notice the workers that die before connecting, and those that hang
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void putUint32(uint8_t * bytes, uint32_t value) {
+	for (int i = 0; i < 4; ++i) {
+		bytes[i] = value >> (8 * i);
+	}
+}
+
+static void putUint64(uint8_t * bytes, uint64_t value) {
+	for (int i = 0; i < 8; ++i) {
+		bytes[i] = value >> (8 * i);
+	}
+}
+
+static uint32_t getUint32(const uint8_t * bytes) {
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i) {
+		value |= (uint32_t)bytes[i] << (8 * i);
+	}
+	return value;
+}
+
+static uint64_t getUint64(const uint8_t * bytes) {
+	uint64_t value = 0;
+	for (int i = 0; i < 8; ++i) {
+		value |= (uint64_t)bytes[i] << (8 * i);
+	}
+	return value;
+}
+
+// the floats by their bits, in the same order as the integers
+static void encodeSweepMessage(const SweepMessage & message, uint8_t * bytes) {
+	uint32_t min, max;
+	uint64_t sum, sum_sq;
+	memcpy(&min, &message.min, sizeof(min));
+	memcpy(&max, &message.max, sizeof(max));
+	memcpy(&sum, &message.sum, sizeof(sum));
+	memcpy(&sum_sq, &message.sum_sq, sizeof(sum_sq));
+	putUint32(bytes + 0, message.type);
+	putUint32(bytes + 4, message.shard);
+	putUint32(bytes + 8, message.job);
+	putUint32(bytes + 12, message.count);
+	putUint32(bytes + 16, message.laps);
+	putUint32(bytes + 20, message.unfinished);
+	putUint32(bytes + 24, min);
+	putUint32(bytes + 28, max);
+	putUint64(bytes + 32, sum);
+	putUint64(bytes + 40, sum_sq);
+	putUint64(bytes + 48, message.design);
+}
+
+static void decodeSweepMessage(const uint8_t * bytes, SweepMessage & message) {
+	uint32_t min = getUint32(bytes + 24);
+	uint32_t max = getUint32(bytes + 28);
+	uint64_t sum = getUint64(bytes + 32);
+	uint64_t sum_sq = getUint64(bytes + 40);
+	message.type = getUint32(bytes + 0);
+	message.shard = getUint32(bytes + 4);
+	message.job = getUint32(bytes + 8);
+	message.count = getUint32(bytes + 12);
+	message.laps = getUint32(bytes + 16);
+	message.unfinished = getUint32(bytes + 20);
+	memcpy(&message.min, &min, sizeof(min));
+	memcpy(&message.max, &max, sizeof(max));
+	memcpy(&message.sum, &sum, sizeof(sum));
+	memcpy(&message.sum_sq, &sum_sq, sizeof(sum_sq));
+	message.design = getUint64(bytes + 48);
+}
+
+bool sendSweepMessage(int fd, const SweepMessage & message) {
+	uint8_t data[SWEEP_MESSAGE_BYTES];
+	encodeSweepMessage(message, data);
+	size_t done = 0;
+	while (done < sizeof(data)) {
+		ssize_t n = write(fd, data + done, sizeof(data) - done);
+		if (n < 0 && EINTR == errno) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}
+
+bool receiveSweepMessage(int fd, SweepMessage & message) {
+	uint8_t data[SWEEP_MESSAGE_BYTES];
+	size_t done = 0;
+	while (done < sizeof(data)) {
+		ssize_t n = read(fd, data + done, sizeof(data) - done);
+		if (n < 0 && EINTR == errno) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		done += n;
+	}
+	decodeSweepMessage(data, message);
+	return true;
+}
+
+static bool socketAddress(const char * path, struct sockaddr_un & address) {
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		printErrorLog("Socket path too long: %s", path);
+		return false;
+	}
+	strcpy(address.sun_path, path);
+	return true;
+}
+
+int connectSweepCoordinator(const char * path) {
+	struct sockaddr_un address;
+	if (!socketAddress(path, address)) {
+		return -1;
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+bool runSweepWorker(int fd, SweepJobRunner & runner, uint64_t design) {
+	SweepMessage message;
+	memset(&message, 0, sizeof(message));
+	while (true) {
+		message.type = SWEEP_READY;
+		message.design = design;
+		if (!sendSweepMessage(fd, message) || !receiveSweepMessage(fd, message)) {
+			return false;
+		}
+		if (SWEEP_STOP == message.type) {
+			return true;
+		}
+		if (SWEEP_REFUSED == message.type) {
+			printErrorLog("Refused by the coordinator, which doesn't run the same sweep");
+			return false;
+		}
+		if (SWEEP_SHARD != message.type) {
+			return false;
+		}
+
+		SweepMessage result = message;
+		result.type = SWEEP_RESULT;
+		for (uint32_t job = message.job; job < message.job + message.count; ++job) {
+			LapStats stats;
+			runner.runJob(job, stats);
+			result.job = job;
+			result.laps = stats.laps;
+			result.unfinished = stats.unfinished;
+			result.min = stats.min;
+			result.max = stats.max;
+			result.sum = stats.sum;
+			result.sum_sq = stats.sum_sq;
+			if (!sendSweepMessage(fd, result)) {
+				return false;
+			}
+		}
+		result.type = SWEEP_DONE;
+		if (!sendSweepMessage(fd, result)) {
+			return false;
+		}
+	}
+}
+
+SweepCoordinator::SweepCoordinator(const std::vector<int> & jobs, int shard_size, uint64_t design) :
+	miFinished(0),
+	miDesign(design),
+	miShardTimeout(DEFAULT_SHARD_TIMEOUT)
+{
+	// a shard never has more than shard_size jobs, and they follow one another
+	for (size_t j = 0; j < jobs.size(); ++j) {
+		if (j > 0 && jobs[j] == jobs[j - 1] + 1 && mShardCount.back() < shard_size) {
+			++mShardCount.back();
+		} else {
+			mShardJob.push_back(jobs[j]);
+			mShardCount.push_back(1);
+		}
+	}
+	int shards = mShardJob.size();
+	mShardState.assign(shards, SHARD_PENDING);
+	mShardRetries.assign(shards, 0);
+	for (int shard = shards - 1; shard >= 0; --shard) {
+		mPending.push_back(shard);
+	}
+}
+
+int SweepCoordinator::spawnWorker(int listener, const char * path, SweepJobRunner & runner) {
+	pid_t pid = fork();
+	if (0 == pid) { // the worker
+		close(listener);
+		signal(SIGPIPE, SIG_DFL);
+		int fd = connectSweepCoordinator(path);
+		if (fd < 0) {
+			_exit(1);
+		}
+		bool stopped = runSweepWorker(fd, runner, miDesign);
+		close(fd);
+		_exit(stopped ? 0 : 1);
+	}
+	if (pid < 0) {
+		printErrorLog("Unable to start a worker: %s", strerror(errno));
+	} else {
+		mWorkers.push_back(pid);
+	}
+	return pid;
+}
+
+bool SweepCoordinator::giveShard(Connection & connection) {
+	SweepMessage message;
+	memset(&message, 0, sizeof(message));
+	if (mPending.empty()) {
+		connection.idle = (miFinished < (int)mShardState.size());
+		if (connection.idle) {
+			return true; // later, if a shard has to be run again
+		}
+		message.type = SWEEP_STOP;
+		return sendSweepMessage(connection.fd, message);
+	}
+	int shard = mPending.back();
+	mPending.pop_back();
+	connection.shard = shard;
+	connection.idle = false;
+	connection.results.clear();
+	connection.received.assign(mShardCount[shard], false);
+	connection.deadline = now() + miShardTimeout;
+	mShardState[shard] = SHARD_RUNNING;
+	message.type = SWEEP_SHARD;
+	message.shard = shard;
+	message.job = mShardJob[shard];
+	message.count = mShardCount[shard];
+	return sendSweepMessage(connection.fd, message);
+}
+
+// the shard of a worker that is gone is run again, unless it has failed too often
+void SweepCoordinator::dropConnection(Connection & connection) {
+	close(connection.fd);
+	connection.fd = -1;
+	int shard = connection.shard;
+	if (shard < 0) {
+		return;
+	}
+	connection.shard = -1;
+	if (++mShardRetries[shard] > MAX_RETRIES) {
+		printErrorLog("Shard %d failed %d times, giving up", shard, mShardRetries[shard]);
+		mShardState[shard] = SHARD_FAILED;
+		++miFinished;
+	} else {
+		printWarningLog("Worker lost, shard %d runs again", shard);
+		mShardState[shard] = SHARD_PENDING;
+		mPending.push_back(shard);
+	}
+}
+
+// what the worker sent, without waiting for the rest of a message; false if it is
+// to be dropped
+bool SweepCoordinator::receive(Connection & connection, SweepResultSink & sink) {
+	while (true) {
+		ssize_t n = read(connection.fd, connection.in + connection.in_size, SWEEP_MESSAGE_BYTES - connection.in_size);
+		if (n < 0 && EINTR == errno) {
+			continue;
+		}
+		if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+			return true;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		connection.in_size += n;
+		if (SWEEP_MESSAGE_BYTES == connection.in_size) {
+			connection.in_size = 0;
+			SweepMessage message;
+			decodeSweepMessage(connection.in, message);
+			if (!handleMessage(connection, message, sink)) {
+				return false;
+			}
+		}
+	}
+}
+
+bool SweepCoordinator::handleMessage(Connection & connection, const SweepMessage & message, SweepResultSink & sink) {
+	if (SWEEP_READY == message.type && message.design != miDesign) {
+		printWarningLog("Worker refused, its sweep is not the same");
+		SweepMessage refused;
+		memset(&refused, 0, sizeof(refused));
+		refused.type = SWEEP_REFUSED;
+		sendSweepMessage(connection.fd, refused);
+		return false;
+	} else if (SWEEP_READY == message.type && connection.shard < 0) {
+		return giveShard(connection);
+	} else if (SWEEP_RESULT == message.type) {
+		return addResult(connection, message);
+	} else if (SWEEP_DONE == message.type && (int)message.shard == connection.shard) {
+		return finishShard(connection, sink);
+	}
+	printWarningLog("Unexpected message %u from a worker", message.type);
+	return false;
+}
+
+// a result is only kept if its job is one of the shard, and the first one for it
+bool SweepCoordinator::addResult(Connection & connection, const SweepMessage & message) {
+	int shard = connection.shard;
+	if (shard < 0 || (int)message.shard != shard) {
+		printWarningLog("Result from a worker for a shard it doesn't run");
+		return false;
+	}
+	uint32_t first = mShardJob[shard];
+	if (message.job < first || message.job - first >= (uint32_t)mShardCount[shard]) {
+		printWarningLog("Result from a worker for the job %u, not in the shard %d", message.job, shard);
+		return false;
+	}
+	if (connection.received[message.job - first]) {
+		printWarningLog("Result from a worker for the job %u twice", message.job);
+		return false;
+	}
+	connection.received[message.job - first] = true;
+	connection.results.push_back(message);
+	return true;
+}
+
+// the results only go to the sink when every job of the shard has exactly one
+bool SweepCoordinator::finishShard(Connection & connection, SweepResultSink & sink) {
+	int shard = connection.shard;
+	if (shard < 0 || (int)connection.results.size() != mShardCount[shard]) {
+		printWarningLog("Shard %d done by a worker with %u results of %d", shard,
+			(unsigned int)connection.results.size(), (shard < 0 ? 0 : mShardCount[shard]));
+		return false;
+	}
+	for (size_t r = 0; r < connection.results.size(); ++r) {
+		const SweepMessage & result = connection.results[r];
+		LapStats stats;
+		stats.laps = result.laps;
+		stats.unfinished = result.unfinished;
+		stats.min = result.min;
+		stats.max = result.max;
+		stats.sum = result.sum;
+		stats.sum_sq = result.sum_sq;
+		sink.addResult(result.job, stats);
+	}
+	connection.results.clear();
+	mShardState[shard] = SHARD_DONE;
+	connection.shard = -1;
+	++miFinished;
+	return true;
+}
+
+bool SweepCoordinator::run(const char * path, int workers, SweepJobRunner & runner, SweepResultSink & sink) {
+	struct sockaddr_un address;
+	if (!socketAddress(path, address)) {
+		return false;
+	}
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(path);
+	if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, workers + 4) != 0) {
+		printErrorLog("Unable to listen at %s: %s", path, strerror(errno));
+		if (listener >= 0) {
+			close(listener);
+		}
+		return false;
+	}
+	signal(SIGPIPE, SIG_IGN); // a worker that dies is noticed when reading from it
+
+	int alive = 0;
+	int spawned = 0;
+	int max_spawns = workers * (MAX_RETRIES + 1);
+	std::vector<Connection> connections;
+	std::vector<struct pollfd> fds;
+	while (miFinished < (int)mShardState.size()) {
+		// reap the workers that died, and start others while there is something to do
+		pid_t pid;
+		while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+			--alive;
+			mWorkers.erase(std::remove(mWorkers.begin(), mWorkers.end(), pid), mWorkers.end());
+		}
+		while (alive < workers && spawned < max_spawns && !mPending.empty()) {
+			if (spawnWorker(listener, path, runner) < 0) {
+				break;
+			}
+			++alive;
+			++spawned;
+		}
+		if (0 == alive && connections.empty() && spawned >= max_spawns) {
+			printErrorLog("The workers keep dying, giving up");
+			break;
+		}
+
+		fds.resize(1 + connections.size());
+		fds[0].fd = listener;
+		fds[0].events = POLLIN;
+		for (size_t i = 0; i < connections.size(); ++i) {
+			fds[i + 1].fd = connections[i].fd;
+			fds[i + 1].events = POLLIN;
+		}
+		if (poll(&fds[0], fds.size(), POLL_MS) < 0 && EINTR != errno) {
+			printErrorLog("poll: %s", strerror(errno));
+			break;
+		}
+
+		for (size_t i = 0; i < connections.size(); ++i) {
+			if (0 == fds[i + 1].revents) {
+				continue;
+			}
+			if (!receive(connections[i], sink)) {
+				dropConnection(connections[i]);
+			}
+		}
+
+		// a worker that hangs would keep its shard for ever
+		double time = now();
+		for (size_t i = 0; i < connections.size(); ++i) {
+			Connection & connection = connections[i];
+			if (connection.fd >= 0 && connection.shard >= 0 && time > connection.deadline) {
+				printWarningLog("Shard %d not done in %d s", connection.shard, miShardTimeout);
+				if (connection.pid > 0) {
+					kill(connection.pid, SIGKILL);
+				}
+				dropConnection(connection);
+			}
+		}
+
+		// shards to run again go to the workers waiting for one
+		for (size_t i = 0; i < connections.size(); ++i) {
+			Connection & connection = connections[i];
+			if (connection.fd >= 0 && connection.idle && (!mPending.empty() || miFinished == (int)mShardState.size())) {
+				if (!giveShard(connection)) {
+					dropConnection(connection);
+				}
+			}
+		}
+
+		size_t kept = 0;
+		for (size_t i = 0; i < connections.size(); ++i) {
+			if (connections[i].fd >= 0) {
+				connections[kept++] = connections[i];
+			}
+		}
+		connections.resize(kept);
+
+		if (fds[0].revents & POLLIN) {
+			int fd = accept(listener, NULL, NULL);
+			if (fd >= 0) {
+				// it never has more than a message to send to a worker, so that the
+				// writes don't block either
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+				Connection connection;
+				connection.fd = fd;
+				connection.pid = -1;
+				struct ucred credentials;
+				socklen_t size = sizeof(credentials);
+				if (
+					0 == getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) &&
+					std::find(mWorkers.begin(), mWorkers.end(), credentials.pid) != mWorkers.end()
+				) {
+					connection.pid = credentials.pid;
+				}
+				connection.shard = -1;
+				connection.deadline = 0;
+				connection.idle = false;
+				connection.in_size = 0;
+				connections.push_back(connection);
+			}
+		}
+	}
+
+	// the workers still connected are told to stop, and they all are waited for
+	SweepMessage stop;
+	memset(&stop, 0, sizeof(stop));
+	stop.type = SWEEP_STOP;
+	for (size_t i = 0; i < connections.size(); ++i) {
+		if (connections[i].idle) {
+			sendSweepMessage(connections[i].fd, stop);
+		}
+		close(connections[i].fd);
+	}
+	close(listener);
+	unlink(path);
+	while (alive > 0 && waitpid(-1, NULL, 0) > 0) {
+		--alive;
+	}
+
+	for (size_t shard = 0; shard < mShardState.size(); ++shard) {
+		if (SHARD_DONE != mShardState[shard]) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,167 @@
+#ifndef SWEEPPROTOCOL_H_93277C4D_95DA_11E4_D612_10FEED04CD1C
+#define SWEEPPROTOCOL_H_93277C4D_95DA_11E4_D612_10FEED04CD1C
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <vector>
+
+// Batches of races shared between worker processes over a stream socket.
+//
+// The jobs to run (numbered from 0) are cut in shards of consecutive jobs. A worker asks
+// for a shard, runs its jobs and sends back the lap times of each of them, then
+// says it is done and asks for another one. The results of a shard only count once
+// it is done, so the shard of a worker that dies, or that is not done with it in
+// time, is given again to another one, up to MAX_RETRIES times.
+//
+// The messages are all one SweepMessage of SWEEP_MESSAGE_BYTES, in little endian
+// whatever the machine, so that nothing is ever half understood. The coordinator
+// listens on a UNIX socket, but nothing in the protocol depends on it.
+//
+// A worker sends the hash of the design it would run (the jobs and everything their
+// results depend on) in its SWEEP_READY, and the coordinator refuses it if it is not
+// its own, since its results would be those of other races.
+
+// lap times, of one race or of many added together
+struct LapStats {
+	int laps;
+	double sum;    // seconds
+	double sum_sq;
+	float min;
+	float max;
+	int unfinished; // cars that didn't do all their laps in time
+
+	LapStats() : laps(0), sum(0), sum_sq(0), min(0), max(0), unfinished(0) {
+	}
+
+	void add(float time) {
+		if (0 == laps || time < min) min = time;
+		if (0 == laps || time > max) max = time;
+		++laps;
+		sum += time;
+		sum_sq += (double)time * time;
+	}
+
+	void merge(const LapStats & other) {
+		if (other.laps > 0) {
+			if (0 == laps || other.min < min) min = other.min;
+			if (0 == laps || other.max > max) max = other.max;
+		}
+		laps += other.laps;
+		sum += other.sum;
+		sum_sq += other.sum_sq;
+		unfinished += other.unfinished;
+	}
+};
+
+enum SweepMessageType {
+	SWEEP_READY = 1, // worker: give me a shard
+	SWEEP_SHARD,     // coordinator: run count jobs from job
+	SWEEP_STOP,      // coordinator: there is nothing left, exit
+	SWEEP_RESULT,    // worker: the lap times of a job
+	SWEEP_DONE,      // worker: every job of the shard has its result
+	SWEEP_REFUSED    // coordinator: not the same design, exit
+};
+
+struct SweepMessage {
+	uint32_t type;
+	uint32_t shard;
+	uint32_t job;   // first job of a shard, or job of a result
+	uint32_t count; // jobs of a shard
+	uint32_t laps;
+	uint32_t unfinished;
+	float min;
+	float max;
+	double sum;
+	double sum_sq;
+	uint64_t design; // of the worker, in SWEEP_READY
+};
+
+static const int SWEEP_MESSAGE_BYTES = 8 * 4 + 3 * 8;
+
+// what the workers do with a job
+class SweepJobRunner {
+public:
+	virtual ~SweepJobRunner() {
+	}
+
+	virtual void runJob(int job, LapStats & result) = 0;
+};
+
+// what the coordinator does with the results of a shard when it is done
+class SweepResultSink {
+public:
+	virtual ~SweepResultSink() {
+	}
+
+	virtual void addResult(int job, const LapStats & result) = 0;
+};
+
+bool sendSweepMessage(int fd, const SweepMessage & message);
+bool receiveSweepMessage(int fd, SweepMessage & message);
+
+// the loop of a worker connected to the coordinator on fd, until it is told to stop
+// or the connection is lost; returns whether it was told to stop
+bool runSweepWorker(int fd, SweepJobRunner & runner, uint64_t design);
+
+// connect to the coordinator listening on the UNIX socket at path, -1 on error
+int connectSweepCoordinator(const char * path);
+
+class SweepCoordinator {
+public:
+	static const int MAX_RETRIES = 3;
+	static const int DEFAULT_SHARD_TIMEOUT = 600; // s, for a worker to be done with a shard
+
+	// jobs: to run, in increasing order; design: the hash the workers must send
+	SweepCoordinator(const std::vector<int> & jobs, int shard_size, uint64_t design);
+
+	// listen at path and fork workers processes that run the jobs with runner, and
+	// start new ones when they die, until every shard is done or has failed too many
+	// times. Other workers can connect to path too. The results of the jobs go to
+	// sink as their shards are done; returns false if some shards failed.
+	bool run(const char * path, int workers, SweepJobRunner & runner, SweepResultSink & sink);
+
+	// a worker that hangs is dropped after that, and killed if it was forked by run()
+	void setShardTimeout(int seconds) {
+		miShardTimeout = seconds;
+	}
+
+private:
+	enum ShardState {
+		SHARD_PENDING,
+		SHARD_RUNNING,
+		SHARD_DONE,
+		SHARD_FAILED
+	};
+
+	struct Connection {
+		int fd;      // non blocking
+		pid_t pid;   // of the worker if run() forked it, else -1
+		int shard;   // being run, -1 if none
+		double deadline; // of the shard
+		bool idle;   // asked for a shard when there was none to give
+		uint8_t in[SWEEP_MESSAGE_BYTES]; // a message being received
+		size_t in_size;
+		std::vector<SweepMessage> results; // of the shard, until it is done
+		std::vector<bool> received;        // for every job of the shard
+	};
+
+	std::vector<int> mShardJob;   // first job of every shard
+	std::vector<int> mShardCount; // jobs of every shard
+	std::vector<int> mShardState;
+	std::vector<int> mShardRetries;
+	std::vector<int> mPending; // shards to give, the last one first
+	int miFinished; // shards done or failed
+	uint64_t miDesign;
+	int miShardTimeout;
+	std::vector<pid_t> mWorkers; // forked and not reaped yet
+
+	int spawnWorker(int listener, const char * path, SweepJobRunner & runner);
+	bool giveShard(Connection & connection);
+	void dropConnection(Connection & connection);
+	bool receive(Connection & connection, SweepResultSink & sink);
+	bool handleMessage(Connection & connection, const SweepMessage & message, SweepResultSink & sink);
+	bool addResult(Connection & connection, const SweepMessage & message);
+	bool finishShard(Connection & connection, SweepResultSink & sink);
+};
+
+#endif // SWEEPPROTOCOL_H_93277C4D_95DA_11E4_D612_10FEED04CD1C
@@ -0,0 +1,144 @@
+#include "../TelemetryStream.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Stands in for a dashboard: follows the telemetry streamed by the game, prints the
+// car of the player now and then, and how much it took to get there.
+
+static const int PRINT_EVERY = 125; // frames
+
+static void usage(const char * program) {
+	fprintf(stderr, "Usage: %s [-s socket | -t host:port] [-n frames] [-d read_delay_ms]\n", program);
+}
+
+static int connectUnix(const char * path) {
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		return -1;
+	}
+	strcpy(address.sun_path, path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd >= 0 && connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+		close(fd);
+		fd = -1;
+	}
+	return fd;
+}
+
+static int connectTcp(const std::string & host_port) {
+	size_t colon = host_port.rfind(':');
+	if (std::string::npos == colon) {
+		return -1;
+	}
+	std::string host = host_port.substr(0, colon);
+	std::string port = host_port.substr(colon + 1);
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo * addresses;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+		return -1;
+	}
+	int fd = -1;
+	for (struct addrinfo * a = addresses; NULL != a && fd < 0; a = a->ai_next) {
+		fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(addresses);
+	return fd;
+}
+
+int main(int argc, char *argv[]) {
+	const char * path = TELEMETRY_SOCKET;
+	const char * host_port = NULL;
+	long max_frames = -1;
+	int delay_ms = 0;
+	int opt;
+	while ((opt = getopt(argc, argv, "s:t:n:d:")) != -1) {
+		switch (opt) {
+			case 's':
+				path = optarg;
+				break;
+			case 't':
+				host_port = optarg;
+				break;
+			case 'n':
+				max_frames = atol(optarg);
+				break;
+			case 'd':
+				delay_ms = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	int fd = (NULL != host_port ? connectTcp(host_port) : connectUnix(path));
+	if (fd < 0) {
+		fprintf(stderr, "Can't connect to %s, is the game running?\n", (NULL != host_port ? host_port : path));
+		return 1;
+	}
+
+	TelemetryStreamDecoder decoder;
+	TelemetryFrame * frame = new TelemetryFrame;
+	uint8_t buffer[65536];
+	unsigned long long bytes = 0;
+	long frames = 0;
+	long keyframes = 0;
+	long missed = 0; // ticks that were not received
+	long last_tick = -1;
+	bool ok = true;
+	while (ok && (max_frames < 0 || frames < max_frames)) {
+		ssize_t n = read(fd, buffer, sizeof(buffer));
+		if (n <= 0) {
+			break;
+		}
+		bytes += n;
+		decoder.feed(buffer, n);
+		int type;
+		int result;
+		while ((result = decoder.next(*frame, &type)) > 0) {
+			++frames;
+			keyframes += (TELEMETRY_KEYFRAME == type ? 1 : 0);
+			if (last_tick >= 0 && (long)frame->tick > last_tick + 1) {
+				missed += frame->tick - last_tick - 1;
+			}
+			last_tick = frame->tick;
+			if (0 == frames % PRINT_EVERY && frame->player >= 0 && frame->player < frame->car_count) {
+				const CarTelemetry & car = frame->cars[frame->player];
+				printf("tick %u  lap %d  checkpoint %d  position %d/%d  speed %5.2f  (%.1f bytes/frame)\n",
+					frame->tick, car.lap, car.current_checkpoint, car.standing + 1, frame->car_count,
+					hypot(car.speed[0], car.speed[1]), (double)bytes / frames);
+				fflush(stdout);
+			}
+		}
+		if (result < 0) {
+			fprintf(stderr, "Invalid telemetry stream\n");
+			ok = false;
+		}
+		if (delay_ms > 0) {
+			usleep(delay_ms * 1000);
+		}
+	}
+	close(fd);
+
+	printf("%ld frames (%ld keyframes, %ld ticks missed), %llu bytes, %.1f bytes/frame\n",
+		frames, keyframes, missed, bytes, (frames > 0 ? (double)bytes / frames : 0.0));
+	delete frame;
+	return (ok ? 0 : 1);
+}
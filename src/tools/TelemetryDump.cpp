@@ -0,0 +1,111 @@
+#include "../TelemetryLog.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+// Summary of a telemetry recording of the game, or some of its channels as CSV, one
+// line per tick and car, the lengths in metres.
+
+static void usage(const char * program) {
+	fprintf(stderr, "Usage: %s [-c car] <file.ctl> [<channel>...]\n", program);
+}
+
+static void printSummary(const char * filename, const TelemetryLog & log) {
+	printf("%s: track %d, %d cars, %llu ticks of %d ms in %d blocks\n", filename,
+		log.getTrack(), log.getCars(), (unsigned long long)log.getTicks(), log.getTickMs(), log.getBlocks());
+	for (int channel = 0; channel < log.getChannels(); ++channel) {
+		size_t stored = 0;
+		int raw = 0;
+		for (int block = 0; block < log.getBlocks(); ++block) {
+			stored += log.getStoredBytes(block, channel);
+			raw += (log.isRaw(block, channel) ? 1 : 0);
+		}
+		double plain = (double)log.getTicks() * log.getCars() * sizeof(uint32_t);
+		printf("  %-16.16s %-5s %10zu bytes, %5.1f%%, %d raw blocks\n",
+			log.getChannel(channel).name,
+			(CHANNEL_FLOAT == log.getChannel(channel).type ? "float" : "int"),
+			stored, (plain > 0 ? 100.0 * stored / plain : 0.0), raw);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	int only_car = -1;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:")) != -1) {
+		switch (opt) {
+			case 'c':
+				only_car = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind >= argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	const char * filename = argv[optind];
+	TelemetryLog log;
+	if (!log.open(filename)) {
+		return 1;
+	}
+	if (optind + 1 == argc) {
+		printSummary(filename, log);
+		return 0;
+	}
+
+	std::vector<int> channels;
+	for (int i = optind + 1; i < argc; ++i) {
+		int channel = log.findChannel(argv[i]);
+		if (channel < 0) {
+			fprintf(stderr, "No channel %s in %s\n", argv[i], filename);
+			return 1;
+		}
+		channels.push_back(channel);
+	}
+	printf("tick,car");
+	for (int i = optind + 1; i < argc; ++i) {
+		printf(",%s", argv[i]);
+	}
+	printf("\n");
+
+	std::vector<std::vector<uint32_t> > scratch(channels.size());
+	std::vector<const uint32_t *> columns(channels.size());
+	int cars = log.getCars();
+	for (int block = 0; block < log.getBlocks(); ++block) {
+		for (size_t i = 0; i < channels.size(); ++i) {
+			columns[i] = log.getColumn(block, channels[i], scratch[i]);
+			if (NULL == columns[i]) {
+				fprintf(stderr, "Block %d of %s is damaged\n", block, filename);
+				return 1;
+			}
+		}
+		uint32_t first_tick = log.getBlockFirstTick(block);
+		for (int tick = 0; tick < log.getBlockTicks(block); ++tick) {
+			for (int car = 0; car < cars; ++car) {
+				if (only_car >= 0 && car != only_car) {
+					continue;
+				}
+				printf("%u,%d", first_tick + tick, car);
+				for (size_t i = 0; i < channels.size(); ++i) {
+					const TelemetryLogChannel & channel = log.getChannel(channels[i]);
+					uint32_t bits = columns[i][tick * cars + car];
+					if (CHANNEL_FLOAT == channel.type) {
+						float value;
+						memcpy(&value, &bits, sizeof(value));
+						printf(",%g", value * channel.scale);
+					} else {
+						printf(",%d", (int32_t)bits);
+					}
+				}
+				printf("\n");
+			}
+		}
+	}
+	return 0;
+}
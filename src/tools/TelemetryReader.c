@@ -0,0 +1,137 @@
+/*
+ * Follows a running game through the shared memory segment of its telemetry, see
+ * TelemetryShm.h, and prints a line about the car of the player every interval. It is
+ * also an example of how to read the segment from other programs.
+ */
+
+#define _DEFAULT_SOURCE
+#include "../TelemetryShm.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_READ_ATTEMPTS 1000
+
+static void usage(const char * program) {
+	fprintf(stderr, "Usage: %s [-i interval_ms] [-n lines]\n", program);
+}
+
+/* the last frame; 0 if there is none yet, or if the game kept overwriting it */
+static int readLastFrame(const TelemetryShmHeader * header, const TelemetryShmSlot * slots,
+	TelemetryFrame * frame, uint64_t * number)
+{
+	int attempt;
+	for (attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt) {
+		uint64_t frames = __atomic_load_n(&header->frames, __ATOMIC_ACQUIRE);
+		if (0 == frames) {
+			return 0;
+		}
+		uint64_t n = frames - 1;
+		const TelemetryShmSlot * slot = &slots[n % header->slots];
+		uint32_t before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+		if (before != (uint32_t)(2 * n + 2)) { /* being written, or already the next round */
+			sched_yield();
+			continue;
+		}
+		/* only the cars that are used */
+		memcpy(frame, &slot->frame, offsetof(TelemetryFrame, cars));
+		int count = frame->car_count;
+		if (count < 0 || count > TELEMETRY_MAX_CARS) {
+			count = 0;
+		}
+		memcpy(frame->cars, slot->frame.cars, count * sizeof(CarTelemetry));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == before) {
+			frame->car_count = count;
+			*number = n;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char * argv[]) {
+	int interval_ms = 100;
+	long lines = -1;
+	int opt;
+	while ((opt = getopt(argc, argv, "i:n:")) != -1) {
+		switch (opt) {
+			case 'i':
+				interval_ms = atoi(optarg);
+				break;
+			case 'n':
+				lines = atol(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	int fd = shm_open(TELEMETRY_SHM_NAME, O_RDONLY, 0);
+	if (fd < 0) {
+		fprintf(stderr, "No telemetry in " TELEMETRY_SHM_NAME ", is the game running?\n");
+		return 1;
+	}
+	struct stat st;
+	fstat(fd, &st);
+	void * mapping = (st.st_size >= (off_t)sizeof(TelemetryShmHeader) ?
+		mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED);
+	close(fd);
+	if (MAP_FAILED == mapping) {
+		fprintf(stderr, "Can't map " TELEMETRY_SHM_NAME "\n");
+		return 1;
+	}
+
+	const TelemetryShmHeader * header = (const TelemetryShmHeader *)mapping;
+	if (
+		memcmp(header->magic, TELEMETRY_SHM_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != TELEMETRY_SHM_VERSION ||
+		header->slot_size != sizeof(TelemetryShmSlot) ||
+		0 == header->slots ||
+		header->header_size + (uint64_t)header->slots * header->slot_size > (uint64_t)st.st_size
+	) {
+		fprintf(stderr, "Unknown telemetry layout in " TELEMETRY_SHM_NAME "\n");
+		return 1;
+	}
+	const TelemetryShmSlot * slots = (const TelemetryShmSlot *)((const char *)mapping + header->header_size);
+
+	TelemetryFrame * frame = (TelemetryFrame *)malloc(sizeof(TelemetryFrame));
+	uint64_t last = (uint64_t)-1;
+	while (0 != lines) {
+		if (0 == __atomic_load_n(&header->writer_pid, __ATOMIC_ACQUIRE)) {
+			printf("The game has ended\n");
+			break;
+		}
+		uint64_t n;
+		if (readLastFrame(header, slots, frame, &n) && n != last) {
+			if (frame->player >= 0 && frame->player < frame->car_count) {
+				const CarTelemetry * car = &frame->cars[frame->player];
+				printf("tick %u  %6.2f s  lap %d  checkpoint %d  position %d/%d  speed %5.2f  gap %.2f s\n",
+					frame->tick, frame->race_time_ms / 1000.0, car->lap, car->current_checkpoint,
+					car->standing + 1, frame->car_count,
+					hypot(car->speed[0], car->speed[1]), car->gap);
+			} else {
+				printf("tick %u  %6.2f s  %d cars\n", frame->tick, frame->race_time_ms / 1000.0, frame->car_count);
+			}
+			fflush(stdout);
+			last = n;
+			if (lines > 0) {
+				--lines;
+			}
+		}
+		usleep(interval_ms * 1000);
+	}
+
+	free(frame);
+	munmap(mapping, st.st_size);
+	return 0;
+}
@@ -0,0 +1,14 @@
+#include "../Common.h"
+
+#include <cstdio>
+#include <cstdarg>
+
+// printLog for the command line tools, which don't have the GTK log window
+void printLog(LogType type, const char* fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	FILE * out = (LOG_INFO == type ? stdout : stderr);
+	vfprintf(out, fmt, args);
+	fputc('\n', out);
+	va_end(args);
+}
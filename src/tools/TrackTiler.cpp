@@ -0,0 +1,44 @@
+#include "../TileMap.h"
+#include "../TrackCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Convert tracks/<name>.png and tracks/<name>_function.png into tracks/<name>.tiles,
+// which the game streams instead of loading the whole images.
+
+static void usage(const char * program) {
+	fprintf(stderr, "Usage: %s tracks/<name> [<name>...]\n", program);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	int errors = 0;
+	for (int i = 1; i < argc; ++i) {
+		std::string basename = argv[i];
+		if (basename.size() > 4 && basename.compare(basename.size() - 4, 4, ".png") == 0) {
+			basename.erase(basename.size() - 4);
+		}
+
+		TileMap map;
+		if (!TrackCache::loadImages(basename, map)) {
+			++errors;
+			continue;
+		}
+
+		std::string filename = basename + ".tiles";
+		if (!map.save(filename.c_str())) {
+			++errors;
+			continue;
+		}
+		printf("%s: %dx%d, %dx%d tiles of %d pixels\n", filename.c_str(),
+			map.getWidth(), map.getHeight(), map.getTilesX(), map.getTilesY(), map.getTileSize());
+	}
+
+	return (errors != 0 ? 1 : 0);
+}